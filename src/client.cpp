@@ -1,52 +1,204 @@
+#include <poll.h>
+#include <map>
 #include "log.h"
 #include "client.h"
+#include "io_uring.h"
 
 namespace pipetrick
 {
 
+namespace
+{
+
+//The operations submitted by 'sendDelayToServerUring', used as user data of each submission.
+const uint64_t URING_CONNECT = 0;
+const uint64_t URING_WRITE = 1;
+const uint64_t URING_READ = 2;
+const uint64_t URING_TIMEOUT = 3;
+const uint64_t URING_PIPE = 4;
+const uint64_t URING_CANCEL = 5;
+
+//The indexes of the registered buffers.
+const unsigned URING_MESSAGE_BUFFER = 0;
+const unsigned URING_RESPONSE_BUFFER = 1;
+
+const unsigned URING_ENTRIES = 16;
+
+const size_t MIN_HEDGING_SAMPLES = 20; //The number of latencies recorded before the hedging delay is taken from their percentile.
+
+}
+
+/**
+ * An io_uring instance with two registered buffers: one for the message to send and one for the message to receive.
+ */
+struct Client::UringContext
+{
+    IoUring ring;
+    char buffers[2][BUFFER_SIZE];
+};
+
+/**
+ * A connection shared by all the requests to a server in multiplex mode. The socket is blocking, and is only read by 'reader'.
+ */
+struct Client::MuxConnection
+{
+    /**
+     * The outcome of writing a batch, shared by all its requests.
+     */
+    struct BatchResult
+    {
+        bool done; //Raised once the first request of the batch tried to write it.
+        bool written;
+    };
+
+    int socketDescriptor;
+    std::thread reader; //Runs 'Client::readMuxResponses'.
+    std::mutex writeMutex; //So the messages of concurrent requests are not interleaved.
+    std::string batch; //The messages waiting to be written together, in batching mode. Protected by 'writeMutex'.
+    size_t batchRequests; //The number of requests of 'batch'. Protected by 'writeMutex'.
+    std::shared_ptr<BatchResult> batchResult; //The outcome of writing 'batch'. Protected by 'writeMutex'.
+    std::condition_variable batchCV; //Notified when 'batch' is full, and when it is written.
+    uint32_t nextRequestId; //Protected by 'Client::mutex_'.
+    std::map<uint32_t, MuxRequest*> pendingRequests; //The requests waiting for a response, by id. Protected by 'Client::mutex_'.
+    bool broken; //Raised once the connection cannot be used anymore. Protected by 'Client::mutex_'.
+
+    /**
+     * Shuts the socket down, so the reader thread finishes, and closes it.
+     */
+    ~MuxConnection()
+    {
+        shutdown(socketDescriptor, SHUT_RDWR);
+        if (reader.joinable())
+        {
+            reader.join();
+        }
+        close(socketDescriptor);
+    }
+};
+
+/**
+ * A request waiting for its response on a multiplexed connection.
+ */
+struct Client::MuxRequest
+{
+    long delay; //The increased delay of the response.
+    bool answered;
+};
+
+/**
+ * A request shared by the concurrent callers of 'sendCoalescedDelayToServer' with the same server and delay. Protected by 'flightsMutex_'.
+ */
+struct Client::Flight
+{
+    bool done; //Raised once the response is known.
+    AsyncResponse response;
+    uint64_t generation; //The value of 'stopGeneration_' when the request was sent.
+};
+
+/**
+ * A request sent to several servers at once by 'sendDelayToServers', or hedged by 'sendHedgedDelayToServer'. It is only accessed by the
+ * thread of the scheduler until 'done' is set.
+ */
+struct Client::FanOut
+{
+    FanOut(const std::vector<Endpoint>& fanOutEndpoints, const std::chrono::milliseconds& fanOutDelay, size_t fanOutQuorum)
+    : endpoints(fanOutEndpoints)
+    , serverDelay(fanOutDelay)
+    , responses(fanOutEndpoints.size(), AsyncResponse{false, fanOutDelay})
+    , quorum(fanOutQuorum)
+    , started(0)
+    , successes(0)
+    , finished(0)
+    , completed(false)
+    , group(Scheduler::NO_GROUP)
+    , latencies(nullptr)
+    {
+    }
+
+    std::vector<Endpoint> endpoints;
+    std::chrono::milliseconds serverDelay;
+    std::vector<AsyncResponse> responses; //One per endpoint.
+    size_t quorum; //The number of responses to wait for.
+    size_t started; //The number of requests started, to the first endpoints.
+    size_t successes; //The number of servers that answered back.
+    size_t finished; //The number of requests finished, answered or not.
+    bool completed; //Raised once the quorum is reached, or once it cannot be reached anymore.
+    Scheduler::Group group; //The group of the requests, to cancel the stragglers.
+    LatencyWindow* latencies; //Where the latencies of the successful requests, beyond 'serverDelay', are recorded, or nullptr.
+    std::promise<bool> done; //Set once 'completed' is raised, with whether the quorum was reached.
+};
+
 const char *Client::DEFAULT_IP = "127.0.0.1";
 const std::chrono::milliseconds Client::MAXIMUM_WAITING_TIME_FOR_FLAG = std::chrono::milliseconds(2000);
 const std::chrono::microseconds Client::DEFAULT_TIMEOUT = std::chrono::microseconds(5 * 1000 * 1000);
 
-Client::Client(const std::chrono::microseconds& timeOut) 
+Client::Client(const std::chrono::microseconds& timeOut, const ClientOptions& options)
 : timeOut_(timeOut)
+, options_(options)
 , numConnections_(0)
+, pool_(options.pool)
+, stopGeneration_(0)
+, retryAfter_(0)
+, asyncQuit_(false)
+, flightsGeneration_(0)
+, hedgingLatencies_(options.hedging.window)
+, reactorGroup_(Scheduler::NO_GROUP)
 {
-    pipeDescriptors_[0] = -1;
-    pipeDescriptors_[1] = -1;
-    if (pipe2(pipeDescriptors_, O_NONBLOCK) == -1)
+    //The connections of the io_uring engine and the shared reactor are not created by 'connectToServer'.
+    if (options_.fastOpen && (options_.reactor || (options_.engine == ClientEngine::IO_URING && !options_.multiplex)))
     {
-        int errorNumber = errno;
-        Log::logError("Client::Client - Could not create the pipe file descriptors", errorNumber);
+        Log::logError("Client::Client - TCP Fast Open is not supported by the io_uring engine nor the shared reactor, so the regular handshake is used.");
+        options_.fastOpen = false;
     }
+
+    if (options_.reactor)
+    {
+        reactorGroup_ = options_.reactor->registerClient();
+        return;
+    }
+    wakeup_.init(options_.wakeup, "Client:");
 }
 
-Client::~Client()
+Client::Client(const std::vector<Endpoint>& endpoints, const std::chrono::microseconds& timeOut, const ClientOptions& options)
+: Client(timeOut, options)
 {
-    close(pipeDescriptors_[0]);
-    close(pipeDescriptors_[1]);
+    balancer_.reset(new LoadBalancer(endpoints, options.balancing));
 }
 
 void Client::stop()
 {
-    writeToPipeAndWait();
-    Common::consumePipe(pipeDescriptors_[0], "Client:");
+    pool_.cancel();
+    {
+        std::scoped_lock lock(flightsMutex_);
+        flightsGeneration_++;
+    }
+    flightsCV_.notify_all();
+    notifyAndWait();
+    if (!options_.reactor)
+    {
+        wakeup_.consume();
+    }
 }
 
-void Client::writeToPipeAndWait()
+void Client::notifyAndWait()
 {
     std::unique_lock < std::mutex > lock(mutex_);
     if (numConnections_ == 0)
     {
-        Log::logVerbose("Client::writeToPipeAndWait - Client does not have any pending connection.");
+        Log::logVerbose("Client::notifyAndWait - Client does not have any pending connection.");
         return;
     }
 
-    if (write(pipeDescriptors_[1], "0", 1) == -1)
+    if (options_.reactor)
     {
-        int errorNumber = errno;
-        Log::logError("Client::writeToPipeAndWait - Error writing to the pipe.", errorNumber);
+        options_.reactor->cancel(reactorGroup_);
+    }
+    else if (!wakeup_.notify())
+    {
+        Log::logError("Client::notifyAndWait - Error notifying the pending connections.");
     }
+    stopGeneration_++;
+    responsesCV_.notify_all();
     auto quitPredicate = [this]()
     {
         return numConnections_ == 0;
@@ -59,14 +211,41 @@ void Client::writeToPipeAndWait()
     }
 }
 
-void Client::closeAndNotify(int socketDescriptor)
+Client::~Client()
+{
+    if (options_.reactor)
+    {
+        notifyAndWait(); //The coroutines of the reactor must not outlive this client.
+    }
+    muxConnections_.clear();
+
+    if (asyncThread_.joinable())
+    {
+        {
+            std::scoped_lock lock(asyncMutex_);
+            asyncQuit_ = true;
+        }
+        asyncWakeup_.notify();
+        asyncThread_.join();
+    }
+}
+
+void Client::releaseAndNotify(int socketDescriptor, const std::string& connectionKey)
+{
+    pool_.checkin(connectionKey, socketDescriptor, options_.keepAlive);
+    std::scoped_lock lock(mutex_);
+    numConnections_--;
+    quitCV_.notify_all();
+}
+
+void Client::closeAndNotify(int socketDescriptor, const std::string& connectionKey)
 {
+    pool_.checkin(connectionKey, socketDescriptor, false);
     std::scoped_lock lock(mutex_);
     if (numConnections_ == 0)
     {
         Log::logVerbose("Client::closeAndNotify - Client does not have any pending connection.");
     }
-    close(socketDescriptor);
     numConnections_--;
     quitCV_.notify_all();
 }
@@ -78,6 +257,14 @@ bool Client::connectToServer(int socketDescriptor, const std::string& serverIP,
     serverAddress.sin_family = AF_INET;
     serverAddress.sin_port = htons(serverPort);
 
+    //The connect call then returns right away, and the SYN is only sent along with the first write.
+    int fastOpen = 1;
+    if (options_.fastOpen && setsockopt(socketDescriptor, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &fastOpen, sizeof(fastOpen)) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError("Client::connectToServer - Could not enable TCP Fast Open, so the regular handshake is used", errorNumber);
+    }
+
     if (connect(socketDescriptor, (struct sockaddr*) &serverAddress, sizeof(serverAddress)) == -1)
     {
         int errorNumber = errno;
@@ -91,110 +278,1218 @@ bool Client::connectToServer(int socketDescriptor, const std::string& serverIP,
     return true;
 }
 
-bool Client::checkPipeDescriptorsAndRun()
+bool Client::writeFastOpenFrame(int socketDescriptor, const char* message, size_t messageSize)
 {
-    std::scoped_lock lock(mutex_);
-    if (pipeDescriptors_[0] == -1 || pipeDescriptors_[1] == -1)
+    ssize_t bytesSent = send(socketDescriptor, message, messageSize, MSG_NOSIGNAL);
+    if (bytesSent == -1 && errno == EINPROGRESS)
+    {
+        Log::logVerbose("Client::writeFastOpenFrame - No TCP Fast Open cookie of the server, waiting for the handshake.");
+        fd_set writeFds;
+        fd_set readFds;
+        FD_ZERO(&readFds);
+        FD_SET(wakeup_.getDescriptor(), &readFds);
+        FD_ZERO(&writeFds);
+        FD_SET(socketDescriptor, &writeFds);
+        if (Common::doSelect((wakeup_.getDescriptor() > socketDescriptor ? wakeup_.getDescriptor() : socketDescriptor) + 1, &readFds, &writeFds, &timeOut_, "Client:") != SelectResult::OK
+            || FD_ISSET(wakeup_.getDescriptor(), &readFds))
+        {
+            return false;
+        }
+        bytesSent = 0;
+    }
+    else if (bytesSent == -1)
     {
         int errorNumber = errno;
-        Log::logError("Client::Client - Could not create the pipe file descriptors", errorNumber);
+        Log::logError("Client::writeFastOpenFrame - Could not send the message to the server", errorNumber);
+        return false;
+    }
+
+    return Common::writeFrame(socketDescriptor, message + bytesSent, messageSize - bytesSent, "Client:");
+}
+
+bool Client::checkWakeupAndRun()
+{
+    std::scoped_lock lock(mutex_);
+    if (!options_.reactor && wakeup_.getDescriptor() == -1)
+    {
+        Log::logError("Client::Client - Could not create the wakeup file descriptors");
         return false;
     }
 
     return true;
 }
 
+bool Client::sendDelayToServer(std::chrono::milliseconds& serverDelay)
+{
+    if (!balancer_)
+    {
+        return sendDelayToServer(serverDelay, DEFAULT_IP, DEFAULT_PORT);
+    }
+
+    size_t server = balancer_->pick();
+    const Endpoint& endpoint = balancer_->getEndpoint(server);
+    std::chrono::milliseconds originalDelay = serverDelay;
+    uint64_t generation = getStopGeneration();
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool success = sendDelayToServer(serverDelay, endpoint.ip, endpoint.port);
+    finishBalancedRequest(server, success, originalDelay, begin, generation);
+    return success;
+}
+
 bool Client::sendDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort)
 {
+    if (options_.coalesce)
+    {
+        return sendCoalescedDelayToServer(serverDelay, serverIP, serverPort);
+    }
+    return sendSingleDelayToServer(serverDelay, serverIP, serverPort);
+}
+
+bool Client::sendCoalescedDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort)
+{
+    std::string key = serverIP + ":" + std::to_string(serverPort) + ":" + std::to_string(serverDelay.count());
+    while (true)
+    {
+        uint64_t generation = getStopGeneration();
+        std::unique_lock<std::mutex> lock(flightsMutex_);
+        std::shared_ptr<Flight> flight;
+        auto existingFlight = flights_.find(key);
+        if (existingFlight == flights_.end())
+        {
+            flight.reset(new Flight{false, AsyncResponse{false, serverDelay}, generation});
+            flights_[key] = flight;
+            lock.unlock();
+
+            std::chrono::milliseconds responseDelay = serverDelay;
+            bool success = sendSingleDelayToServer(responseDelay, serverIP, serverPort);
+
+            lock.lock();
+            flight->done = true;
+            flight->response = AsyncResponse{success, responseDelay};
+            flights_.erase(key);
+            flightsCV_.notify_all();
+        }
+        else
+        {
+            flight = existingFlight->second;
+            Log::logVerbose("Client::sendCoalescedDelayToServer - Waiting for the same request in flight to " + key);
+
+            //The caller counts as a connection, so 'stop' waits for it too.
+            uint64_t flightsGeneration = flightsGeneration_;
+            {
+                std::scoped_lock connectionsLock(mutex_);
+                numConnections_++;
+            }
+            flightsCV_.wait_for(lock, timeOut_, [this, &flight, flightsGeneration]()
+            {
+                return flight->done || flightsGeneration_ != flightsGeneration;
+            });
+            {
+                std::scoped_lock connectionsLock(mutex_);
+                numConnections_--;
+                quitCV_.notify_all();
+            }
+
+            if (!flight->done)
+            {
+                Log::logVerbose("Client::sendCoalescedDelayToServer - The time out expired or the client was stopped while waiting for " + key);
+                return false;
+            }
+        }
+
+        //A request cancelled by a call to 'stop' that happened before this caller joined it does not cancel this caller.
+        if (!flight->response.success && flight->generation != generation)
+        {
+            continue;
+        }
+
+        if (flight->response.success)
+        {
+            serverDelay = flight->response.serverDelay;
+        }
+        return flight->response.success;
+    }
+}
+
+bool Client::sendSingleDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort)
+{
+    if (options_.hedging.endpoint.port != 0)
+    {
+        return sendHedgedDelayToServer(serverDelay, serverIP, serverPort);
+    }
+
+    if (options_.reactor)
+    {
+        AsyncResponse response = sendDelayToServerAsync(serverDelay, serverIP, serverPort).get();
+        if (!response.success)
+        {
+            return false;
+        }
+        serverDelay = response.serverDelay;
+        return true;
+    }
+
+    if (options_.multiplex)
+    {
+        std::vector<std::chrono::milliseconds> serverDelays(1, serverDelay);
+        if (!sendDelaysToServer(serverDelays, serverIP, serverPort))
+        {
+            return false;
+        }
+        serverDelay = serverDelays[0];
+        return true;
+    }
+
+    UringContext* context = options_.engine == ClientEngine::IO_URING ? getUringContext() : nullptr;
+    std::string connectionKey = (context ? "uring:" : "select:") + serverIP + ":" + std::to_string(serverPort);
+
     int socketDescriptor;
+    while (true)
+    {
+        if (!pool_.checkout(connectionKey, socketDescriptor, timeOut_))
+        {
+            return false;
+        }
+
+        if (socketDescriptor == -1)
+        {
+            break;
+        }
+
+        ExchangeResult result = context ? sendDelayToServerUring(*context, socketDescriptor, serverDelay, serverIP, serverPort, connectionKey)
+                                        : sendDelayOnSocket(socketDescriptor, true, serverDelay, connectionKey);
+        if (result != ExchangeResult::STALE_CONNECTION)
+        {
+            return result == ExchangeResult::SUCCESS;
+        }
+        Log::logVerbose("Client::sendDelayToServer - The server closed the idle connection. Retrying on another connection.");
+    }
+
+    if (context)
+    {
+        return sendDelayToServerUring(*context, -1, serverDelay, serverIP, serverPort, connectionKey) == ExchangeResult::SUCCESS;
+    }
+
     if (!Common::createSocket(socketDescriptor, SOCK_NONBLOCK, "Client:"))
     {
+        pool_.checkin(connectionKey, -1, false);
         return false;
     }
-    
-    if (!connectToServer(socketDescriptor, serverIP, serverPort) || !checkPipeDescriptorsAndRun())
+
+    if (!connectToServer(socketDescriptor, serverIP, serverPort))
     {
-        close(socketDescriptor);
+        pool_.checkin(connectionKey, socketDescriptor, false);
         return false;
     }
 
-    mutex_.lock();
-    numConnections_++;
-    mutex_.unlock();
+    return sendDelayOnSocket(socketDescriptor, false, serverDelay, connectionKey) == ExchangeResult::SUCCESS;
+}
 
-    fd_set writeFds;
-    fd_set readFds;
-    FD_ZERO(&readFds);
-    FD_SET(pipeDescriptors_[0], &readFds);
-    FD_ZERO(&writeFds);
-    FD_SET(socketDescriptor, &writeFds);
+bool Client::sendDelaysToServer(std::vector<std::chrono::milliseconds>& serverDelays, const std::string& serverIP, int serverPort)
+{
+    if (options_.reactor)
+    {
+        std::vector<std::future<AsyncResponse> > responses;
+        for (const std::chrono::milliseconds& serverDelay : serverDelays)
+        {
+            responses.push_back(sendDelayToServerAsync(serverDelay, serverIP, serverPort));
+        }
+
+        bool success = true;
+        for (size_t i = 0; i < responses.size(); i++)
+        {
+            AsyncResponse response = responses[i].get();
+            if (response.success)
+            {
+                serverDelays[i] = response.serverDelay;
+            }
+            success = success && response.success;
+        }
+        return success;
+    }
 
-    if (Common::doSelect((pipeDescriptors_[0] > socketDescriptor ? pipeDescriptors_[0] : socketDescriptor) + 1, &readFds, &writeFds, &timeOut_, "Client:") != SelectResult::OK)
+    if (!checkWakeupAndRun())
     {
-        closeAndNotify(socketDescriptor);
         return false;
     }
 
-    if (FD_ISSET(pipeDescriptors_[0], &readFds)) //Another thread wrote to the 'write' end of the pipe.
+    std::unique_lock<std::mutex> lock(mutex_);
+    numConnections_++;
+    uint64_t generation = stopGeneration_;
+    auto notify = [this]()
     {
-        Log::logVerbose("Client::sendDelayToServer - Quit client in the connect operation by the self pipe trick");
-        closeAndNotify(socketDescriptor);
+        numConnections_--;
+        quitCV_.notify_all();
+    };
+    lock.unlock();
+
+    std::shared_ptr<MuxConnection> connection = getMuxConnection(serverIP, serverPort);
+    lock.lock();
+    if (!connection)
+    {
+        notify();
         return false;
     }
 
-    if (!FD_ISSET(socketDescriptor, &writeFds))
+    std::vector<MuxRequest> requests(serverDelays.size(), MuxRequest{0, false});
+    std::vector<uint32_t> requestIds;
+    for (MuxRequest& request : requests)
     {
-        Log::logError("Client::sendDelayToServer - Expected a file descriptor ready to write operations.");
-        closeAndNotify(socketDescriptor);
-        return false;
+        uint32_t requestId = connection->nextRequestId++;
+        if (requestId == NO_REQUEST_ID)
+        {
+            requestId = connection->nextRequestId++;
+        }
+        connection->pendingRequests[requestId] = &request;
+        requestIds.push_back(requestId);
     }
+    lock.unlock();
 
+    //All the messages are written at once.
+    std::string messages;
     char message[BUFFER_SIZE];
-    memset(message, 0, sizeof(message));
-    strcpy(message, std::to_string(serverDelay.count()).c_str());
-    if (!Common::writeMessage(socketDescriptor, message, "Client:"))
+    for (size_t i = 0; i < requestIds.size(); i++)
     {
-        Log::logError("Client::sendDelayToServer - Could not send the delay to the server.");
-        closeAndNotify(socketDescriptor);
-        return false;
+        size_t messageSize = Common::encodeFrame(message, options_.frameFormat, serverDelays[i].count(), requestIds[i], options_.priority, options_.deadline);
+        messages.append(message, messageSize);
     }
+    bool written = writeMuxMessages(*connection, messages, requestIds.size());
 
-    FD_ZERO(&readFds);
-    FD_SET(socketDescriptor, &readFds);
-    FD_SET(pipeDescriptors_[0], &readFds);
+    lock.lock();
+    auto answered = [&requests]()
+    {
+        for (const MuxRequest& request : requests)
+        {
+            if (!request.answered)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
 
-    if (Common::doSelect((pipeDescriptors_[0] > socketDescriptor ? pipeDescriptors_[0] : socketDescriptor) + 1, &readFds, nullptr, &timeOut_, "Client:") != SelectResult::OK)
+    if (written)
     {
-        closeAndNotify(socketDescriptor);
-        return false;
+        responsesCV_.wait_for(lock, timeOut_, [&]()
+        {
+            return connection->broken || generation != stopGeneration_ || answered();
+        });
+    }
+    else
+    {
+        Log::logError("Client::sendDelaysToServer - Could not send the delays to the server.");
+        connection->broken = true;
+        responsesCV_.notify_all(); //The requests already waiting on the connection give up as well.
     }
 
-    if (FD_ISSET(pipeDescriptors_[0], &readFds)) //Another thread wrote to the 'write' end of the pipe.
+    bool success = answered();
+    for (uint32_t requestId : requestIds)
     {
-        Log::logVerbose("Client::sendDelayToServer - Quit client in the read operation by the self pipe trick");
-        closeAndNotify(socketDescriptor);
-        return false;
+        connection->pendingRequests.erase(requestId);
     }
+    notify();
+    lock.unlock();
 
-    if (!FD_ISSET(socketDescriptor, &readFds))
+    if (!success)
     {
-        Log::logError("Client::sendDelayToServer - Expected a file descriptor ready to read operations.");
-        closeAndNotify(socketDescriptor);
+        Log::logVerbose("Client::sendDelaysToServer - The multiplexed requests were not answered.");
         return false;
     }
 
-    memset(message, 0, sizeof(message));
-    if (!Common::readMessage(socketDescriptor, message, "Client:"))
+    for (size_t i = 0; i < requests.size(); i++)
     {
-        Log::logError("Client::sendDelayToServer - Could not get the increased delay from the server.");
-        closeAndNotify(socketDescriptor);
-        return false;
+        serverDelays[i] = std::chrono::milliseconds(requests[i].delay);
+    }
+    return true;
+}
+
+bool Client::writeMuxMessages(MuxConnection& connection, const std::string& messages, size_t numRequests)
+{
+    std::unique_lock<std::mutex> writeLock(connection.writeMutex);
+    if (options_.batching.window.count() <= 0)
+    {
+        return Common::writeFrame(connection.socketDescriptor, messages.data(), messages.size(), "Client:");
+    }
+
+    bool leader = connection.batch.empty();
+    if (leader)
+    {
+        connection.batchResult.reset(new MuxConnection::BatchResult{false, false});
+    }
+    std::shared_ptr<MuxConnection::BatchResult> result = connection.batchResult;
+    connection.batch += messages;
+    connection.batchRequests += numRequests;
+    if (!leader)
+    {
+        //The first request of the batch writes it, and hands the outcome to the others.
+        if (connection.batchRequests >= options_.batching.maxRequests)
+        {
+            connection.batchCV.notify_all();
+        }
+        connection.batchCV.wait(writeLock, [&result]()
+        {
+            return result->done;
+        });
+        return result->written;
     }
 
-    serverDelay = std::chrono::milliseconds(atoi(message));
+    connection.batchCV.wait_for(writeLock, options_.batching.window, [this, &connection]()
+    {
+        return connection.batchRequests >= options_.batching.maxRequests;
+    });
 
-    closeAndNotify(socketDescriptor);
-    return true;
+    //'writeMutex' is kept while writing, so the next batch is not written before this one.
+    std::string batch;
+    batch.swap(connection.batch);
+    connection.batchRequests = 0;
+    result->written = Common::writeFrame(connection.socketDescriptor, batch.data(), batch.size(), "Client:");
+    result->done = true;
+    connection.batchCV.notify_all();
+    return result->written;
+}
+
+std::shared_ptr<Client::MuxConnection> Client::getMuxConnection(const std::string& serverIP, int serverPort)
+{
+    std::string connectionKey = serverIP + ":" + std::to_string(serverPort);
+    std::shared_ptr<MuxConnection> brokenConnection; //Released without holding 'mutex_', since its reader thread might need it to finish.
+    {
+        std::scoped_lock lock(mutex_);
+        auto connection = muxConnections_.find(connectionKey);
+        if (connection != muxConnections_.end())
+        {
+            if (!connection->second->broken)
+            {
+                return connection->second;
+            }
+            brokenConnection = std::move(connection->second);
+            muxConnections_.erase(connection);
+        }
+    }
+    brokenConnection.reset();
+
+    int socketDescriptor;
+    if (!Common::createSocket(socketDescriptor, SOCK_NONBLOCK, "Client:"))
+    {
+        return nullptr;
+    }
+
+    if (!connectToServer(socketDescriptor, serverIP, serverPort))
+    {
+        close(socketDescriptor);
+        return nullptr;
+    }
+
+    fd_set writeFds;
+    fd_set readFds;
+    FD_ZERO(&readFds);
+    FD_SET(wakeup_.getDescriptor(), &readFds);
+    FD_ZERO(&writeFds);
+    FD_SET(socketDescriptor, &writeFds);
+
+    int socketError = 0;
+    socklen_t socketErrorSize = sizeof(socketError);
+    if (Common::doSelect((wakeup_.getDescriptor() > socketDescriptor ? wakeup_.getDescriptor() : socketDescriptor) + 1, &readFds, &writeFds, &timeOut_, "Client:") != SelectResult::OK
+        || FD_ISSET(wakeup_.getDescriptor(), &readFds)
+        || getsockopt(socketDescriptor, SOL_SOCKET, SO_ERROR, &socketError, &socketErrorSize) == -1 || socketError != 0)
+    {
+        Log::logError("Client::getMuxConnection - Could not connect to the server", socketError);
+        close(socketDescriptor);
+        return nullptr;
+    }
+
+    //The reader thread blocks on the socket, and the writes are bounded by the time out.
+    struct timeval sendTimeOut;
+    sendTimeOut.tv_sec = timeOut_.count() / 1000000;
+    sendTimeOut.tv_usec = timeOut_.count() % 1000000;
+    fcntl(socketDescriptor, F_SETFL, fcntl(socketDescriptor, F_GETFL) & ~O_NONBLOCK);
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_SNDTIMEO, &sendTimeOut, sizeof(sendTimeOut));
+    Common::setNoDelay(socketDescriptor, "Client:");
+
+    std::shared_ptr<MuxConnection> newConnection(new MuxConnection());
+    newConnection->socketDescriptor = socketDescriptor;
+    newConnection->nextRequestId = NO_REQUEST_ID + 1;
+    newConnection->batchRequests = 0;
+    newConnection->broken = false;
+    newConnection->reader = std::thread(&Client::readMuxResponses, this, newConnection.get());
+
+    std::shared_ptr<MuxConnection> connection;
+    {
+        std::scoped_lock lock(mutex_);
+        std::shared_ptr<MuxConnection>& current = muxConnections_[connectionKey];
+        if (!current || current->broken)
+        {
+            //Another thread might have replaced the connection in the meantime. Then, the new one is not needed.
+            std::swap(current, newConnection);
+        }
+        connection = current;
+    }
+    return connection;
+}
+
+void Client::readMuxResponses(MuxConnection* connection)
+{
+    char message[BUFFER_SIZE];
+    long delay;
+    uint32_t requestId;
+    while (Common::readFrame(connection->socketDescriptor, message, "Client:"))
+    {
+        //A busy answer means the server rejected the connection, so the requests waiting on it fail and 'getRetryAfter' is updated.
+        if (isBusyAnswer(message) || !Common::decodeFrame(message, delay, requestId))
+        {
+            break;
+        }
+
+        std::scoped_lock lock(mutex_);
+        auto request = requestId == NO_REQUEST_ID ? connection->pendingRequests.begin() : connection->pendingRequests.find(requestId);
+        if (request == connection->pendingRequests.end())
+        {
+            Log::logVerbose("Client::readMuxResponses - Discarding the response of a request that is not waiting anymore.");
+            continue;
+        }
+        request->second->delay = delay;
+        request->second->answered = true;
+        connection->pendingRequests.erase(request);
+        responsesCV_.notify_all();
+    }
+
+    std::scoped_lock lock(mutex_);
+    connection->broken = true;
+    responsesCV_.notify_all();
+}
+
+void Client::sendDelayToServerAsync(const std::chrono::milliseconds& serverDelay, AsyncCallback callback, const std::string& serverIP, int serverPort)
+{
+    if (!checkWakeupAndRun())
+    {
+        callback(AsyncResponse{false, serverDelay});
+        return;
+    }
+
+    mutex_.lock();
+    numConnections_++;
+    mutex_.unlock();
+
+    Scheduler::Group group = reactorGroup_;
+    if (!postAsync([this, serverDelay, callback, serverIP, serverPort, group](Scheduler& scheduler)
+    {
+        scheduler.spawn(exchangeAsync(scheduler, serverDelay, serverIP, serverPort), [this, callback](const AsyncResponse& response)
+        {
+            finishAsyncRequest(callback, response);
+        }, group);
+    }))
+    {
+        finishAsyncRequest(callback, AsyncResponse{false, serverDelay});
+    }
+}
+
+void Client::sendDelayToServerAsync(const std::chrono::milliseconds& serverDelay, AsyncCallback callback)
+{
+    if (!balancer_)
+    {
+        sendDelayToServerAsync(serverDelay, std::move(callback), DEFAULT_IP, DEFAULT_PORT);
+        return;
+    }
+
+    size_t server = balancer_->pick();
+    const Endpoint& endpoint = balancer_->getEndpoint(server);
+    uint64_t generation = getStopGeneration();
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    sendDelayToServerAsync(serverDelay, [this, server, serverDelay, begin, generation, callback](const AsyncResponse& response)
+    {
+        finishBalancedRequest(server, response.success, serverDelay, begin, generation);
+        callback(response);
+    }, endpoint.ip, endpoint.port);
+}
+
+std::future<AsyncResponse> Client::sendDelayToServerAsync(const std::chrono::milliseconds& serverDelay)
+{
+    std::shared_ptr<std::promise<AsyncResponse> > promise(new std::promise<AsyncResponse>());
+    std::future<AsyncResponse> future = promise->get_future();
+    sendDelayToServerAsync(serverDelay, [promise](const AsyncResponse& response)
+    {
+        promise->set_value(response);
+    });
+    return future;
+}
+
+std::future<AsyncResponse> Client::sendDelayToServerAsync(const std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort)
+{
+    std::shared_ptr<std::promise<AsyncResponse> > promise(new std::promise<AsyncResponse>());
+    std::future<AsyncResponse> future = promise->get_future();
+    sendDelayToServerAsync(serverDelay, [promise](const AsyncResponse& response)
+    {
+        promise->set_value(response);
+    }, serverIP, serverPort);
+    return future;
+}
+
+bool Client::sendDelayToServers(const std::chrono::milliseconds& serverDelay, const std::vector<Endpoint>& endpoints, size_t quorum, std::vector<AsyncResponse>& responses)
+{
+    responses.assign(endpoints.size(), AsyncResponse{false, serverDelay});
+    if (quorum == 0 || quorum > endpoints.size())
+    {
+        Log::logError("Client::sendDelayToServers - The quorum must be between one and the number of endpoints.");
+        return false;
+    }
+
+    if (!checkWakeupAndRun())
+    {
+        return false;
+    }
+
+    mutex_.lock();
+    numConnections_++;
+    mutex_.unlock();
+
+    std::shared_ptr<FanOut> fanOut(new FanOut(endpoints, serverDelay, quorum));
+    std::future<bool> done = fanOut->done.get_future();
+    Scheduler::Group parent = reactorGroup_;
+    bool posted = postAsync([this, fanOut, parent](Scheduler& scheduler)
+    {
+        //The requests of the fan out are cancelled together once it completes, without cancelling the rest of requests of this client.
+        fanOut->group = scheduler.createGroup(parent);
+        while (!fanOut->completed && fanOut->started < fanOut->endpoints.size())
+        {
+            startFanOutRequest(scheduler, fanOut);
+        }
+    });
+
+    bool success = posted && done.get();
+    if (posted)
+    {
+        responses = fanOut->responses;
+    }
+
+    std::scoped_lock lock(mutex_);
+    numConnections_--;
+    quitCV_.notify_all();
+    return success;
+}
+
+void Client::finishBalancedRequest(size_t server, bool success, const std::chrono::milliseconds& serverDelay, const std::chrono::steady_clock::time_point& begin, uint64_t generation)
+{
+    if (!success && generation != getStopGeneration())
+    {
+        balancer_->abandon(server);
+        return;
+    }
+
+    std::chrono::steady_clock::duration latency = std::chrono::steady_clock::now() - begin - serverDelay;
+    balancer_->release(server, success, std::max(std::chrono::microseconds(0), std::chrono::duration_cast<std::chrono::microseconds>(latency)));
+}
+
+uint64_t Client::getStopGeneration()
+{
+    std::scoped_lock lock(mutex_);
+    return stopGeneration_;
+}
+
+bool Client::sendHedgedDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort)
+{
+    if (!checkWakeupAndRun())
+    {
+        return false;
+    }
+
+    mutex_.lock();
+    numConnections_++;
+    mutex_.unlock();
+
+    std::shared_ptr<FanOut> hedge(new FanOut({{serverIP, serverPort}, options_.hedging.endpoint}, serverDelay, 1));
+    hedge->latencies = &hedgingLatencies_;
+    std::future<bool> done = hedge->done.get_future();
+    Scheduler::Group parent = reactorGroup_;
+    bool posted = postAsync([this, hedge, parent](Scheduler& scheduler)
+    {
+        hedge->group = scheduler.createGroup(parent);
+        startFanOutRequest(scheduler, hedge);
+        if (hedge->completed)
+        {
+            return;
+        }
+
+        std::chrono::milliseconds hedgingDelay = hedge->serverDelay + getHedgingDelay();
+        scheduler.spawn(waitForHedgingDelay(scheduler, hedgingDelay), [this, &scheduler, hedge](IoResult result)
+        {
+            if (result == IoResult::OK && !hedge->completed && hedge->started < hedge->endpoints.size())
+            {
+                Log::logVerbose("Client::sendHedgedDelayToServer - Hedging the request to " + hedge->endpoints[1].ip + ":" + std::to_string(hedge->endpoints[1].port));
+                startFanOutRequest(scheduler, hedge);
+            }
+        }, hedge->group);
+    });
+
+    bool success = posted && done.get();
+    for (size_t i = 0; success && i < hedge->responses.size(); i++)
+    {
+        if (hedge->responses[i].success)
+        {
+            serverDelay = hedge->responses[i].serverDelay;
+            break;
+        }
+    }
+
+    std::scoped_lock lock(mutex_);
+    numConnections_--;
+    quitCV_.notify_all();
+    return success;
+}
+
+std::chrono::milliseconds Client::getHedgingDelay() const
+{
+    if (hedgingLatencies_.getNumberOfSamples() < MIN_HEDGING_SAMPLES)
+    {
+        return options_.hedging.initialDelay;
+    }
+
+    //Rounded up, so a request is never hedged before the percentile.
+    std::chrono::microseconds percentile = hedgingLatencies_.getPercentile(options_.hedging.percentile);
+    return std::chrono::ceil<std::chrono::milliseconds>(percentile);
+}
+
+Task<IoResult> Client::waitForHedgingDelay(Scheduler& scheduler, std::chrono::milliseconds delay)
+{
+    co_return co_await scheduler.sleep(delay);
+}
+
+void Client::startFanOutRequest(Scheduler& scheduler, const std::shared_ptr<FanOut>& fanOut)
+{
+    size_t endpoint = fanOut->started++;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    const Endpoint& address = fanOut->endpoints[endpoint];
+    scheduler.spawn(exchangeAsync(scheduler, fanOut->serverDelay, address.ip, address.port), [this, &scheduler, fanOut, endpoint, begin](const AsyncResponse& response)
+    {
+        if (response.success && fanOut->latencies)
+        {
+            std::chrono::steady_clock::duration latency = std::chrono::steady_clock::now() - begin - fanOut->serverDelay;
+            fanOut->latencies->record(std::max(std::chrono::microseconds(0), std::chrono::duration_cast<std::chrono::microseconds>(latency)));
+        }
+
+        onFanOutResponse(scheduler, *fanOut, endpoint, response);
+
+        //A failed request does not wait for the next endpoint to be started, as when hedging.
+        if (!fanOut->completed && !response.success && fanOut->started < fanOut->endpoints.size())
+        {
+            startFanOutRequest(scheduler, fanOut);
+        }
+    }, fanOut->group);
+}
+
+void Client::onFanOutResponse(Scheduler& scheduler, FanOut& fanOut, size_t endpoint, const AsyncResponse& response)
+{
+    fanOut.finished++;
+    if (fanOut.completed)
+    {
+        return; //A straggler cancelled once the fan out completed.
+    }
+
+    fanOut.responses[endpoint] = response;
+    fanOut.successes += response.success ? 1 : 0;
+    bool quorumReached = fanOut.successes >= fanOut.quorum;
+    if (!quorumReached && fanOut.finished - fanOut.successes <= fanOut.responses.size() - fanOut.quorum)
+    {
+        return;
+    }
+
+    fanOut.completed = true;
+    scheduler.cancel(fanOut.group);
+    scheduler.releaseGroup(fanOut.group);
+    fanOut.done.set_value(quorumReached);
+}
+
+bool Client::postAsync(ClientReactor::Work work)
+{
+    if (options_.reactor)
+    {
+        return options_.reactor->post(reactorGroup_, std::move(work));
+    }
+
+    if (!startAsyncLoop())
+    {
+        return false;
+    }
+
+    bool notify;
+    {
+        std::scoped_lock lock(asyncMutex_);
+        notify = submittedWork_.empty(); //Otherwise, the loop was already notified and has not executed the previous work yet.
+        submittedWork_.push_back(std::move(work));
+    }
+
+    if (notify)
+    {
+        asyncWakeup_.notify();
+    }
+    return true;
+}
+
+bool Client::startAsyncLoop()
+{
+    std::scoped_lock lock(asyncMutex_);
+    if (asyncThread_.joinable())
+    {
+        return true;
+    }
+
+    //'stop' notifies 'wakeup_', and the scheduler cancels all the started requests.
+    bool initialised = asyncWakeup_.init(WakeupType::EVENTFD, "Client:") && asyncScheduler_.init(wakeup_.getDescriptor(), "Client:");
+    initialised = initialised && asyncScheduler_.getLoop().add(asyncWakeup_.getDescriptor(), EPOLLIN, [this](uint32_t)
+    {
+        asyncWakeup_.consume();
+        runSubmittedWork();
+    });
+
+    if (!initialised)
+    {
+        Log::logError("Client::startAsyncLoop - Could not initialise the scheduler of the asynchronous requests.");
+        return false;
+    }
+
+    if (options_.fastOpen)
+    {
+        Log::logError("Client::startAsyncLoop - TCP Fast Open is not supported by the asynchronous requests, so they use the regular handshake.");
+    }
+
+    asyncThread_ = std::thread(&Client::runAsyncLoop, this);
+    return true;
+}
+
+void Client::runAsyncLoop()
+{
+    //The signal of a SIGNALFD wakeup must reach the signalfd, not this thread.
+    Wakeup::blockSignals();
+    asyncScheduler_.run();
+}
+
+void Client::runSubmittedWork()
+{
+    std::vector<ClientReactor::Work> work;
+    bool quit;
+    {
+        std::scoped_lock lock(asyncMutex_);
+        work.swap(submittedWork_);
+        quit = asyncQuit_;
+    }
+
+    for (ClientReactor::Work& item : work)
+    {
+        item(asyncScheduler_);
+    }
+
+    if (quit)
+    {
+        asyncScheduler_.cancel();
+        asyncScheduler_.quit();
+    }
+}
+
+Task<AsyncResponse> Client::exchangeAsync(Scheduler& scheduler, std::chrono::milliseconds serverDelay, std::string serverIP, int serverPort)
+{
+    int socketDescriptor;
+    if (!Common::createSocket(socketDescriptor, SOCK_NONBLOCK, "Client:"))
+    {
+        co_return AsyncResponse{false, serverDelay};
+    }
+
+    std::chrono::milliseconds timeOut = std::chrono::ceil<std::chrono::milliseconds>(timeOut_);
+    std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+    size_t messageSize = Common::encodeFrame(buffer.get(), options_.frameFormat, serverDelay.count(), NO_REQUEST_ID, options_.priority, options_.deadline);
+
+    IoResult result = co_await scheduler.connect(socketDescriptor, serverIP, serverPort, timeOut);
+    if (result == IoResult::OK)
+    {
+        result = co_await scheduler.write(socketDescriptor, buffer.get(), messageSize, timeOut);
+    }
+
+    if (result == IoResult::OK)
+    {
+        result = co_await scheduler.readFrame(socketDescriptor, buffer.get(), timeOut);
+    }
+    close(socketDescriptor);
+
+    long increasedDelay;
+    uint32_t requestId;
+    if (result == IoResult::OK && Common::decodeFrame(buffer.get(), increasedDelay, requestId))
+    {
+        co_return AsyncResponse{true, std::chrono::milliseconds(increasedDelay)};
+    }
+
+    if (result == IoResult::CANCELLED)
+    {
+        Log::logVerbose("Client::exchangeAsync - Quit the asynchronous request by the self pipe trick");
+    }
+    else if (result == IoResult::TIMED_OUT)
+    {
+        Log::logVerbose("Client::exchangeAsync - Time out expired");
+    }
+    else if (!isBusyAnswer(buffer.get()))
+    {
+        Log::logError("Client::exchangeAsync - Could not get the increased delay from the server.");
+    }
+    co_return AsyncResponse{false, serverDelay};
+}
+
+bool Client::isBusyAnswer(const char* message)
+{
+    std::chrono::milliseconds retryAfter;
+    if (!Common::decodeBusyFrame(message, retryAfter))
+    {
+        return false;
+    }
+
+    Log::logVerbose("Client::isBusyAnswer - The server is busy. Retry after " + std::to_string(retryAfter.count()) + " ms.");
+    retryAfter_ = retryAfter.count();
+    return true;
+}
+
+std::chrono::milliseconds Client::getRetryAfter() const
+{
+    return std::chrono::milliseconds(retryAfter_);
+}
+
+void Client::finishAsyncRequest(const AsyncCallback& callback, const AsyncResponse& response)
+{
+    callback(response);
+
+    std::scoped_lock lock(mutex_);
+    numConnections_--;
+    quitCV_.notify_all();
+}
+
+Client::ExchangeResult Client::sendDelayOnSocket(int socketDescriptor, bool reused, std::chrono::milliseconds& serverDelay, const std::string& connectionKey)
+{
+    if (!checkWakeupAndRun())
+    {
+        pool_.checkin(connectionKey, socketDescriptor, false);
+        return ExchangeResult::FAILURE;
+    }
+
+    mutex_.lock();
+    numConnections_++;
+    mutex_.unlock();
+
+    fd_set writeFds;
+    fd_set readFds;
+    FD_ZERO(&readFds);
+    FD_SET(wakeup_.getDescriptor(), &readFds);
+    FD_ZERO(&writeFds);
+    FD_SET(socketDescriptor, &writeFds);
+
+    if (Common::doSelect((wakeup_.getDescriptor() > socketDescriptor ? wakeup_.getDescriptor() : socketDescriptor) + 1, &readFds, &writeFds, &timeOut_, "Client:") != SelectResult::OK)
+    {
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+
+    if (FD_ISSET(wakeup_.getDescriptor(), &readFds)) //Another thread notified 'wakeup_'.
+    {
+        Log::logVerbose("Client::sendDelayToServer - Quit client in the connect operation by the self pipe trick");
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+
+    if (!FD_ISSET(socketDescriptor, &writeFds))
+    {
+        Log::logError("Client::sendDelayToServer - Expected a file descriptor ready to write operations.");
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+
+    char message[BUFFER_SIZE];
+    size_t messageSize = Common::encodeFrame(message, options_.frameFormat, serverDelay.count(), NO_REQUEST_ID, options_.priority, options_.deadline);
+    bool written = options_.fastOpen && !reused ? writeFastOpenFrame(socketDescriptor, message, messageSize)
+                                                : Common::writeFrame(socketDescriptor, message, messageSize, "Client:");
+    if (!written)
+    {
+        Log::logError("Client::sendDelayToServer - Could not send the delay to the server.");
+        closeAndNotify(socketDescriptor, connectionKey);
+        return reused ? ExchangeResult::STALE_CONNECTION : ExchangeResult::FAILURE;
+    }
+
+    FD_ZERO(&readFds);
+    FD_SET(socketDescriptor, &readFds);
+    FD_SET(wakeup_.getDescriptor(), &readFds);
+
+    if (Common::doSelect((wakeup_.getDescriptor() > socketDescriptor ? wakeup_.getDescriptor() : socketDescriptor) + 1, &readFds, nullptr, &timeOut_, "Client:") != SelectResult::OK)
+    {
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+
+    if (FD_ISSET(wakeup_.getDescriptor(), &readFds)) //Another thread notified 'wakeup_'.
+    {
+        Log::logVerbose("Client::sendDelayToServer - Quit client in the read operation by the self pipe trick");
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+
+    if (!FD_ISSET(socketDescriptor, &readFds))
+    {
+        Log::logError("Client::sendDelayToServer - Expected a file descriptor ready to read operations.");
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+
+    if (!Common::readFrame(socketDescriptor, message, "Client:"))
+    {
+        Log::logError("Client::sendDelayToServer - Could not get the increased delay from the server.");
+        closeAndNotify(socketDescriptor, connectionKey);
+        return reused ? ExchangeResult::STALE_CONNECTION : ExchangeResult::FAILURE;
+    }
+
+    long increasedDelay;
+    uint32_t requestId;
+    if (isBusyAnswer(message))
+    {
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+
+    if (!Common::decodeFrame(message, increasedDelay, requestId))
+    {
+        Log::logError("Client::sendDelayToServer - Malformed response from the server.");
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+    serverDelay = std::chrono::milliseconds(increasedDelay);
+
+    releaseAndNotify(socketDescriptor, connectionKey);
+    return ExchangeResult::SUCCESS;
+}
+
+Client::UringContext* Client::getUringContext()
+{
+    thread_local std::unique_ptr<UringContext> context;
+    thread_local bool unavailable = false;
+    if (context || unavailable)
+    {
+        return context.get();
+    }
+
+    std::unique_ptr<UringContext> newContext(new UringContext());
+    if (!newContext->ring.init(URING_ENTRIES, "Client:"))
+    {
+        Log::logError("Client::getUringContext - io_uring is not available. Falling back to select.");
+        unavailable = true;
+        return nullptr;
+    }
+
+    struct iovec buffers[2];
+    for (size_t i = 0; i < 2; i++)
+    {
+        buffers[i].iov_base = newContext->buffers[i];
+        buffers[i].iov_len = BUFFER_SIZE;
+    }
+
+    if (!newContext->ring.registerBuffers(buffers, 2))
+    {
+        unavailable = true;
+        return nullptr;
+    }
+
+    context = std::move(newContext);
+    return context.get();
+}
+
+Client::ExchangeResult Client::sendDelayToServerUring(UringContext& context, int socketDescriptor, std::chrono::milliseconds& serverDelay, const std::string& serverIP,
+                                                      int serverPort, const std::string& connectionKey)
+{
+    bool reused = socketDescriptor != -1;
+    if (!reused && !Common::createSocket(socketDescriptor, 0, "Client:"))
+    {
+        pool_.checkin(connectionKey, -1, false);
+        return ExchangeResult::FAILURE;
+    }
+
+    if (!checkWakeupAndRun())
+    {
+        pool_.checkin(connectionKey, socketDescriptor, false);
+        return ExchangeResult::FAILURE;
+    }
+
+    mutex_.lock();
+    numConnections_++;
+    mutex_.unlock();
+
+    struct sockaddr_in serverAddress;
+    serverAddress.sin_addr.s_addr = inet_addr(serverIP.c_str());
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_port = htons(serverPort);
+
+    char* message = context.buffers[URING_MESSAGE_BUFFER];
+    char* response = context.buffers[URING_RESPONSE_BUFFER];
+    size_t messageSize = Common::encodeFrame(message, options_.frameFormat, serverDelay.count(), NO_REQUEST_ID, options_.priority, options_.deadline);
+
+    struct __kernel_timespec timeOut;
+    timeOut.tv_sec = timeOut_.count() / 1000000;
+    timeOut.tv_nsec = (timeOut_.count() % 1000000) * 1000;
+
+    //A reused keep-alive connection starts the chain with the write.
+    uint64_t firstOperation = reused ? URING_WRITE : URING_CONNECT;
+    struct io_uring_sqe* sqes[URING_CANCEL];
+    for (uint64_t operation = firstOperation; operation < URING_CANCEL; operation++)
+    {
+        sqes[operation] = context.ring.getSqe();
+    }
+
+    if (!reused)
+    {
+        sqes[URING_CONNECT]->opcode = IORING_OP_CONNECT;
+        sqes[URING_CONNECT]->fd = socketDescriptor;
+        sqes[URING_CONNECT]->addr = reinterpret_cast<uint64_t>(&serverAddress);
+        sqes[URING_CONNECT]->off = sizeof(serverAddress);
+        sqes[URING_CONNECT]->flags = IOSQE_IO_LINK;
+    }
+
+    sqes[URING_WRITE]->opcode = IORING_OP_WRITE_FIXED;
+    sqes[URING_WRITE]->fd = socketDescriptor;
+    sqes[URING_WRITE]->addr = reinterpret_cast<uint64_t>(message);
+    sqes[URING_WRITE]->len = messageSize;
+    sqes[URING_WRITE]->buf_index = URING_MESSAGE_BUFFER;
+    sqes[URING_WRITE]->flags = IOSQE_IO_LINK;
+
+    sqes[URING_READ]->opcode = IORING_OP_READ_FIXED;
+    sqes[URING_READ]->fd = socketDescriptor;
+    sqes[URING_READ]->addr = reinterpret_cast<uint64_t>(response);
+    sqes[URING_READ]->len = BUFFER_SIZE;
+    sqes[URING_READ]->buf_index = URING_RESPONSE_BUFFER;
+
+    sqes[URING_TIMEOUT]->opcode = IORING_OP_TIMEOUT;
+    sqes[URING_TIMEOUT]->fd = -1;
+    sqes[URING_TIMEOUT]->addr = reinterpret_cast<uint64_t>(&timeOut);
+    sqes[URING_TIMEOUT]->len = 1;
+
+    sqes[URING_PIPE]->opcode = IORING_OP_POLL_ADD;
+    sqes[URING_PIPE]->fd = wakeup_.getDescriptor();
+    sqes[URING_PIPE]->poll32_events = POLLIN;
+
+    for (uint64_t operation = firstOperation; operation < URING_CANCEL; operation++)
+    {
+        sqes[operation]->user_data = operation;
+    }
+
+    //All the completions, including the ones of the cancellations, are consumed before returning, so the next call on this thread
+    //starts with an empty ring.
+    unsigned pendingOperations = ((1 << URING_CANCEL) - 1) & ~((1 << firstOperation) - 1);
+    unsigned pendingCancellations = 0;
+    size_t bytesRead = 0;
+    bool finished = false;
+    bool success = false;
+    bool peerClosed = false; //Whether the write or the read failed because the server closed the connection.
+
+    while (pendingOperations || pendingCancellations)
+    {
+        if (!context.ring.submit(1))
+        {
+            break;
+        }
+
+        struct io_uring_cqe cqe;
+        while (context.ring.popCqe(cqe))
+        {
+            if (cqe.user_data == URING_CANCEL)
+            {
+                pendingCancellations--;
+                continue;
+            }
+
+            pendingOperations &= ~(1 << cqe.user_data);
+            if (finished)
+            {
+                continue;
+            }
+
+            switch (cqe.user_data)
+            {
+                case URING_CONNECT:
+                case URING_WRITE:
+                    if (cqe.res < 0)
+                    {
+                        if (cqe.res != -ECANCELED)
+                        {
+                            Log::logError("Client::sendDelayToServerUring - Could not send the delay to the server", -cqe.res);
+                            peerClosed = cqe.user_data == URING_WRITE;
+                        }
+                        finished = true;
+                    }
+                    break;
+                case URING_READ:
+                    if (cqe.res <= 0)
+                    {
+                        if (cqe.res != -ECANCELED)
+                        {
+                            Log::logError("Client::sendDelayToServerUring - Could not get the increased delay from the server.");
+                            peerClosed = true;
+                        }
+                        finished = true;
+                        break;
+                    }
+
+                    bytesRead += cqe.res;
+                    {
+                        size_t frameSize = Common::getFrameSize(response, bytesRead);
+                        if (frameSize != 0 && bytesRead >= frameSize)
+                        {
+                            success = true;
+                            finished = true;
+                            break;
+                        }
+
+                        struct io_uring_sqe* sqe = context.ring.getSqe();
+                        sqe->opcode = IORING_OP_READ_FIXED;
+                        sqe->fd = socketDescriptor;
+                        sqe->addr = reinterpret_cast<uint64_t>(response + bytesRead);
+                        sqe->len = BUFFER_SIZE - bytesRead;
+                        sqe->buf_index = URING_RESPONSE_BUFFER;
+                        sqe->user_data = URING_READ;
+                        pendingOperations |= 1 << URING_READ;
+                    }
+                    break;
+                case URING_TIMEOUT:
+                    Log::logVerbose("Client::sendDelayToServerUring - Time out expired");
+                    finished = true;
+                    break;
+                case URING_PIPE:
+                    Log::logVerbose("Client::sendDelayToServerUring - Quit client by the self pipe trick");
+                    finished = true;
+                    break;
+            }
+
+            if (finished)
+            {
+                for (uint64_t operation = URING_CONNECT; operation < URING_CANCEL; operation++)
+                {
+                    if (pendingOperations & (1 << operation))
+                    {
+                        struct io_uring_sqe* sqe = context.ring.getSqe();
+                        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                        sqe->fd = -1;
+                        sqe->addr = operation;
+                        sqe->user_data = URING_CANCEL;
+                        pendingCancellations++;
+                    }
+                }
+            }
+        }
+    }
+
+    long increasedDelay;
+    uint32_t requestId;
+    if (success && isBusyAnswer(response))
+    {
+        closeAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::FAILURE;
+    }
+
+    if (success && Common::decodeFrame(response, increasedDelay, requestId))
+    {
+        serverDelay = std::chrono::milliseconds(increasedDelay);
+        releaseAndNotify(socketDescriptor, connectionKey);
+        return ExchangeResult::SUCCESS;
+    }
+
+    closeAndNotify(socketDescriptor, connectionKey);
+    return reused && peerClosed ? ExchangeResult::STALE_CONNECTION : ExchangeResult::FAILURE;
 }
 
 }
@@ -5,14 +5,92 @@
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+#include <future>
+#include <thread>
 #include "common.h"
+#include "wakeup.h"
+#include "connection_pool.h"
+#include "coroutine.h"
+#include "client_reactor.h"
+#include "latency_window.h"
+#include "load_balancer.h"
 
 namespace pipetrick
 {
+
+/**
+ * The ways a client can perform the socket operations of 'sendDelayToServer'.
+ */
+enum class ClientEngine
+{
+    SELECT, //Non blocking socket operations, waiting for each one of them in a select call.
+    IO_URING //The connect, write and read operations are submitted together to an io_uring instance of the calling thread. Falls back to SELECT if io_uring is not available.
+};
+
+/**
+ * The hedging policy of 'Client::sendDelayToServer'. If the first server has not answered back once the delay sent to it plus a percentile
+ * of the recent latencies expires, the same request is sent to 'endpoint' too. The first response wins and the other request is cancelled.
+ * Hedged requests are coroutines of the scheduler of the client, so the engine, keep-alive and multiplex options are not used for them.
+ */
+struct HedgingOptions
+{
+    Endpoint endpoint = {"", 0}; //The server that receives the hedged requests. Hedging is disabled while its port is zero.
+    double percentile = 0.99; //The percentile of the recent latencies, beyond the delay sent to the server, after which a request is hedged.
+    std::chrono::milliseconds initialDelay = std::chrono::milliseconds(20); //The latency after which a request is hedged until enough latencies are recorded.
+    size_t window = 1000; //The number of recent latencies kept.
+};
+
+/**
+ * The batching of the requests on the multiplexed connections, to amortise the write calls of high rate callers. The messages of the requests
+ * issued within 'window', or of up to 'maxRequests' requests, are written to the server at once. The server answers each one of them on its own.
+ */
+struct BatchingOptions
+{
+    std::chrono::microseconds window = std::chrono::microseconds(0); //The time the first request of a batch waits for more requests. Zero disables batching.
+    size_t maxRequests = 64; //The number of requests that makes a batch be written before its window expires.
+};
+
+/**
+ * Optional settings of a client.
+ */
+struct ClientOptions
+{
+    ClientEngine engine = ClientEngine::SELECT;
+    WakeupType wakeup = WakeupType::PIPE; //The implementation of the 'Self pipe trick'.
+    bool keepAlive = false; //Whether the connections are kept open after each request, to be reused by the next requests to the same server.
+    ConnectionPoolOptions pool; //The limits of the connections to each server. 'ConnectionPoolOptions::maxTotal' also applies without keep-alive.
+    Common::FrameFormat frameFormat = Common::FrameFormat::TEXT; //The format of the messages sent to the server, which answers in the same format.
+    bool multiplex = false; //Whether all the requests to the same server share one connection, tagged with request ids, so they are answered as soon as each one of them finishes.
+    bool fastOpen = false; //Whether the new connections use TCP Fast Open, so the first message goes in the SYN once the server gave a cookie. Refused by the io_uring engine and 'reactor', and not used by the asynchronous requests.
+    BatchingOptions batching; //Only used by the requests on the multiplexed connections.
+    HedgingOptions hedging;
+    LoadBalancerOptions balancing; //How the requests are routed when the client is built from a list of endpoints.
+    Common::Priority priority = Common::Priority::NORMAL; //The priority class carried by the requests, which servers with 'AdmissionPolicy::QUEUE' serve first.
+    std::chrono::milliseconds deadline = std::chrono::milliseconds(0); //The time the requests are willing to wait in the queue of the server. Zero means there is no deadline.
+    bool coalesce = false; //Whether the concurrent calls to 'Client::sendDelayToServer' with the same server and delay share one request and its response.
+    ClientReactor* reactor = nullptr; //When set, every request is a coroutine of this reactor, shared with other clients, so the client owns no wakeup descriptors nor threads. The engine, keep-alive and multiplex options are not used then.
+};
+
+/**
+ * The result of a request sent by 'Client::sendDelayToServerAsync'.
+ */
+struct AsyncResponse
+{
+    bool success; //Whether the server answered back.
+    std::chrono::milliseconds serverDelay; //The delay increased by one by the server, or the original delay if the request failed.
+};
+
 class Client
 {
 public:
     using SelectResult = Common::SelectResult;
+    using FrameFormat = Common::FrameFormat;
+    using AsyncCallback = std::function<void(const AsyncResponse& response)>;
 
     static const char* DEFAULT_IP;
     static const std::chrono::milliseconds MAXIMUM_WAITING_TIME_FOR_FLAG; //The maximum waiting time for the flag 'isRunning_' to be cleared.
@@ -20,18 +98,40 @@ public:
 
     /**
      * Constructor.
-     * Creates the pipe file descriptors for 'pipeDescriptors_'.
+     * Creates the file descriptors of 'wakeup_', or registers the client in 'ClientOptions::reactor'.
+     *
+     * @param[in] timeOut The time out to wait for socket operations.
+     * @param[in] options
+     */
+    Client(const std::chrono::microseconds& timeOut = DEFAULT_TIMEOUT, const ClientOptions& options = ClientOptions());
+
+    /**
+     * Constructor of a client whose requests without server are routed among 'endpoints' by the policy of 'ClientOptions::balancing'.
      *
+     * @param[in] endpoints
      * @param[in] timeOut The time out to wait for socket operations.
+     * @param[in] options
      */
-    Client(const std::chrono::microseconds& timeOut = DEFAULT_TIMEOUT);
+    Client(const std::vector<Endpoint>& endpoints, const std::chrono::microseconds& timeOut = DEFAULT_TIMEOUT, const ClientOptions& options = ClientOptions());
 
+    /**
+     * Closes the multiplexed connections and quits the thread of the asynchronous requests, whose pending requests fail. The idle
+     * keep-alive connections are closed by 'pool_'. With a shared reactor, the pending requests of this client are cancelled and waited for.
+     */
     ~Client();
 
     /**
      * Sends a delay 'serverDelay' to the server, so the server will sleep 'serverDelay' milliseconds before answering back.
+     * In keep-alive mode, an idle connection to the same server is reused if there is one. If the server closed it in the meantime,
+     * the request is sent again on another connection. If the server already has 'ConnectionPoolOptions::maxTotal' connections,
+     * this call waits for one of them to be released first. In multiplex mode, the request is sent on the multiplexed connection to the server
+     * (see 'sendDelaysToServer'), regardless of the engine. With a shared reactor, the request is a coroutine of the reactor, and the calling
+     * thread waits for its response. With 'ClientOptions::hedging', a slow request is also sent to the hedging endpoint, and the first response wins.
+     * With 'ClientOptions::coalesce', a call that finds the same request (same server and delay) already in flight waits for its response instead
+     * of sending its own.
      * This call blocks until :
      * - The server answers back.
+     * - The server rejects the request because it is full (see 'getRetryAfter').
      * - The time out 'timeOut_' expires.
      * - A call to 'stop' is performed.
      *
@@ -41,16 +141,332 @@ public:
      * @param[in] serverPort The port where the remote server is listening to connections.
      * @return true if this client had a response from the server, false if the time out expired, a call to 'stop' was performed while waiting or an error occurred.
      */
-    bool sendDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP = DEFAULT_IP, int serverPort = DEFAULT_PORT);
+    bool sendDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort = DEFAULT_PORT);
+
+    /**
+     * Same as the previous method, to the server picked by the load balancer if the client was built from a list of endpoints, or to
+     * the default server otherwise. The servers whose requests fail are ejected for a while.
+     *
+     * @param[in/out] serverDelay
+     * @return true if this client had a response from the server, false otherwise.
+     */
+    bool sendDelayToServer(std::chrono::milliseconds& serverDelay);
+
+    /**
+     * Sends all the delays of 'serverDelays' back to back on the multiplexed connection to the server, each one of them with its own
+     * request id, without waiting for any response in between. The multiplexed connection is shared by all the threads sending requests
+     * to the same server, and a reader thread hands each response to its request, in the order the server answers them. With a shared reactor,
+     * the delays are sent at once as concurrent requests of the reactor, each one on its own connection.
+     * This call blocks until :
+     * - The server answers back all the requests.
+     * - The time out 'timeOut_' expires.
+     * - A call to 'stop' is performed.
+     * - The server closes the connection.
+     *
+     * @param[in/out] serverDelays The amount of time that the server will sleep before answering back each request. If the call is successful,
+     *                             this method will modify every delay by increasing its value by one.
+     * @param[in] serverIP The IP address of the remote server.
+     * @param[in] serverPort The port where the remote server is listening to connections.
+     * @return true if this client had a response to every request, false otherwise.
+     */
+    bool sendDelaysToServer(std::vector<std::chrono::milliseconds>& serverDelays, const std::string& serverIP = DEFAULT_IP, int serverPort = DEFAULT_PORT);
+
+    /**
+     * Sends a delay 'serverDelay' to the server without blocking. The request is a coroutine of an internal scheduler, run by a thread
+     * created on the first asynchronous request, on its own connection. 'callback' is called by that thread once:
+     * - The server answers back.
+     * - The time out 'timeOut_' expires.
+     * - A call to 'stop' is performed.
+     * - An error occurs.
+     * If the event loop could not be started, 'callback' is called right away by the calling thread.
+     *
+     * @param[in] serverDelay The amount of time that the server will sleep before answering back to this client.
+     * @param[in] callback
+     * @param[in] serverIP The IP address of the remote server.
+     * @param[in] serverPort The port where the remote server is listening to connections.
+     */
+    void sendDelayToServerAsync(const std::chrono::milliseconds& serverDelay, AsyncCallback callback, const std::string& serverIP, int serverPort = DEFAULT_PORT);
+
+    /**
+     * Same as the previous method, to the server picked by the load balancer if the client was built from a list of endpoints, or to
+     * the default server otherwise.
+     *
+     * @param[in] serverDelay
+     * @param[in] callback
+     */
+    void sendDelayToServerAsync(const std::chrono::milliseconds& serverDelay, AsyncCallback callback);
+
+    /**
+     * Same as the previous method, but the response is delivered through the returned future.
+     *
+     * @param[in] serverDelay
+     * @param[in] serverIP
+     * @param[in] serverPort
+     * @return The future response.
+     */
+    std::future<AsyncResponse> sendDelayToServerAsync(const std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort = DEFAULT_PORT);
+
+    /**
+     * Same as the previous method, to the server picked by the load balancer if the client was built from a list of endpoints, or to
+     * the default server otherwise.
+     *
+     * @param[in] serverDelay
+     * @return The future response.
+     */
+    std::future<AsyncResponse> sendDelayToServerAsync(const std::chrono::milliseconds& serverDelay);
+
+    /**
+     * Sends the delay 'serverDelay' to every server of 'endpoints' at once, as asynchronous requests, and waits until 'quorum' of them
+     * answer back. The rest of requests (the stragglers) are cancelled right away, so this call does not wait for the slowest servers.
+     * It also returns as soon as so many requests failed that the quorum cannot be reached anymore.
+     * This call blocks until :
+     * - 'quorum' servers answer back.
+     * - The quorum cannot be reached, because the time out 'timeOut_' expired, the connection failed or the server closed it.
+     * - A call to 'stop' is performed.
+     *
+     * @param[in] serverDelay The amount of time that every server will sleep before answering back to this client.
+     * @param[in] endpoints
+     * @param[in] quorum The number of responses to wait for, from one to the number of endpoints.
+     * @param[out] responses One per endpoint, in the same order. The requests failed or cancelled are not successful.
+     * @return true if at least 'quorum' servers answered back, false otherwise.
+     */
+    bool sendDelayToServers(const std::chrono::milliseconds& serverDelay, const std::vector<Endpoint>& endpoints, size_t quorum, std::vector<AsyncResponse>& responses);
+
+    /**
+     * @return The time to retry after sent by the last server that rejected a request of this client because it was full, or zero.
+     */
+    std::chrono::milliseconds getRetryAfter() const;
 
     /**
-     * Quits any pending connection by a previous call to 'sendDelayToServer' by using the self pipe trick.
+     * Quits any pending connection by a previous call to 'sendDelayToServer' by using the self pipe trick. The calls waiting for a
+     * connection under the limit of the pool give up, and the idle connections are closed. The pending asynchronous requests fail,
+     * and their callbacks are called before this call returns.
      * This call blocks waiting until a maximum time of MAXIMUM_WAITING_TIME_FOR_FLAG for the flag 'isRunning_' to be cleared.
      */
     void stop();
 
 private:
 
+    /**
+     * The results of a request sent on a connection.
+     */
+    enum class ExchangeResult
+    {
+        SUCCESS, //The server answered back.
+        FAILURE, //The time out expired, 'stop' was called or an error occurred.
+        STALE_CONNECTION //The server closed a reused keep-alive connection before answering back, so the request can be sent again on a new one.
+    };
+
+    struct UringContext;
+    struct MuxConnection;
+    struct MuxRequest;
+    struct FanOut;
+    struct Flight;
+
+    /**
+     * Creates the thread of the asynchronous requests, if it was not created yet.
+     *
+     * @return true if the thread is running, false if its event loop could not be initialised.
+     */
+    bool startAsyncLoop();
+
+    /**
+     * The method executed by the thread of the asynchronous requests. It runs 'asyncScheduler_' until the destructor is called.
+     */
+    void runAsyncLoop();
+
+    /**
+     * Executes 'work' in the thread of the scheduler of this client: 'asyncScheduler_', started if needed, or the thread of 'ClientOptions::reactor'.
+     *
+     * @param[in] work
+     * @return true if 'work' was queued, false if the scheduler could not be started.
+     */
+    bool postAsync(ClientReactor::Work work);
+
+    /**
+     * Executes the work posted to 'asyncScheduler_', or quits it if the destructor was called.
+     */
+    void runSubmittedWork();
+
+    /**
+     * Sends the delay 'serverDelay' to 'serverIP':'serverPort', unless the same request is already in flight, in which case its response is shared.
+     * If the shared request was cancelled by a call to 'stop' performed before this call joined it, the request is sent again. A caller
+     * waiting for a shared request gives up once the time out expires or 'stop' is called.
+     *
+     * @param[in,out] serverDelay
+     * @param[in] serverIP
+     * @param[in] serverPort
+     * @return true if this client had a response from the server, false otherwise.
+     */
+    bool sendCoalescedDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort);
+
+    /**
+     * Sends the delay 'serverDelay' to 'serverIP':'serverPort' on a request of its own, as described in 'sendDelayToServer'.
+     *
+     * @param[in,out] serverDelay
+     * @param[in] serverIP
+     * @param[in] serverPort
+     * @return true if this client had a response from the server, false otherwise.
+     */
+    bool sendSingleDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort);
+
+    /**
+     * Gives back to 'balancer_' the server of a finished request. The requests failed because of a call to 'stop' do not count towards
+     * the ejection of the server.
+     *
+     * @param[in] server
+     * @param[in] success
+     * @param[in] serverDelay The delay sent to the server, which is not part of its latency.
+     * @param[in] begin The time the request was sent.
+     * @param[in] generation The value of 'stopGeneration_' when the request was sent.
+     */
+    void finishBalancedRequest(size_t server, bool success, const std::chrono::milliseconds& serverDelay, const std::chrono::steady_clock::time_point& begin, uint64_t generation);
+
+    /**
+     * @return The current value of 'stopGeneration_'.
+     */
+    uint64_t getStopGeneration();
+
+    /**
+     * Sends the delay 'serverDelay' to 'serverIP':'serverPort', and also to 'HedgingOptions::endpoint' if the first server has not answered
+     * back in time or failed. The first successful response wins, and the other request is cancelled.
+     *
+     * @param[in,out] serverDelay
+     * @param[in] serverIP
+     * @param[in] serverPort
+     * @return true if one of the servers answered back, false otherwise.
+     */
+    bool sendHedgedDelayToServer(std::chrono::milliseconds& serverDelay, const std::string& serverIP, int serverPort);
+
+    /**
+     * @return The time to wait for a request before hedging it, beyond the delay sent to the server.
+     */
+    std::chrono::milliseconds getHedgingDelay() const;
+
+    /**
+     * @param[in] scheduler
+     * @param[in] delay
+     * @return A task resulting in 'IoResult::OK' once 'delay' expires, or in 'IoResult::CANCELLED' if its group is cancelled before.
+     */
+    static Task<IoResult> waitForHedgingDelay(Scheduler& scheduler, std::chrono::milliseconds delay);
+
+    /**
+     * Starts the request of 'fanOut' to its next endpoint in the scheduler of this client.
+     *
+     * @param[in] scheduler
+     * @param[in] fanOut
+     */
+    void startFanOutRequest(Scheduler& scheduler, const std::shared_ptr<FanOut>& fanOut);
+
+    /**
+     * Records the response of the request of 'fanOut' to the endpoint 'endpoint'. Once the fan out completes, its stragglers are cancelled
+     * and the waiting thread is released.
+     *
+     * @param[in] scheduler
+     * @param[in] fanOut
+     * @param[in] endpoint The index of the endpoint.
+     * @param[in] response
+     */
+    static void onFanOutResponse(Scheduler& scheduler, FanOut& fanOut, size_t endpoint, const AsyncResponse& response);
+
+    /**
+     * The coroutine equivalent to 'sendDelayOnSocket' on a new connection: connects, writes the delay and reads the response, suspending
+     * instead of blocking. A call to 'stop' resumes it with 'IoResult::CANCELLED'.
+     *
+     * @param[in] scheduler 'asyncScheduler_', or the scheduler of the shared reactor.
+     * @param[in] serverDelay
+     * @param[in] serverIP
+     * @param[in] serverPort
+     * @return The response of the server.
+     */
+    Task<AsyncResponse> exchangeAsync(Scheduler& scheduler, std::chrono::milliseconds serverDelay, std::string serverIP, int serverPort);
+
+    /**
+     * Records the time to retry after if 'message' is the answer of a server that rejected the request because it was full.
+     *
+     * @param[in] message A whole message read from the server.
+     * @return true if 'message' is a busy answer, false otherwise.
+     */
+    bool isBusyAnswer(const char* message);
+
+    /**
+     * Calls 'callback' and decreases 'numConnections_' to notify all threads.
+     *
+     * @param[in] callback
+     * @param[in] response
+     */
+    void finishAsyncRequest(const AsyncCallback& callback, const AsyncResponse& response);
+
+    /**
+     * Gets the multiplexed connection to the server, replacing it if the server closed it. A new connection starts its reader thread.
+     *
+     * @param[in] serverIP
+     * @param[in] serverPort
+     * @return The connection, or nullptr if it could not be established.
+     */
+    std::shared_ptr<MuxConnection> getMuxConnection(const std::string& serverIP, int serverPort);
+
+    /**
+     * Writes the messages of 'numRequests' requests to 'connection'. In batching mode, they are appended to the batch of the connection,
+     * and the first request of the batch writes it once the window expires or the batch is full, while the others wait for the outcome.
+     *
+     * @param[in] connection
+     * @param[in] messages
+     * @param[in] numRequests
+     * @return true if the messages were written, false if the write failed.
+     */
+    bool writeMuxMessages(MuxConnection& connection, const std::string& messages, size_t numRequests);
+
+    /**
+     * The method executed by the reader thread of a multiplexed connection. It reads the responses and hands each one of them to the
+     * pending request with the same id until the connection is closed. A response without id goes to the oldest pending request,
+     * which is the only one a server without request ids answers.
+     *
+     * @param[in] connection
+     */
+    void readMuxResponses(MuxConnection* connection);
+
+    /**
+     * @return The io_uring instance of the calling thread, created on the first call, or nullptr if io_uring is not available.
+     */
+    static UringContext* getUringContext();
+
+    /**
+     * Implementation of 'sendDelayToServer' for 'ClientEngine::IO_URING'. The connect, write and read operations are submitted as
+     * a linked chain, together with a timeout and a poll on 'wakeup_'. Once one of them ends the request, the rest
+     * are cancelled with IORING_OP_ASYNC_CANCEL.
+     *
+     * @param[in] context The io_uring instance of the calling thread.
+     * @param[in] socketDescriptor A keep-alive connection to reuse, or -1 to create a new one.
+     * @param[in/out] serverDelay
+     * @param[in] serverIP
+     * @param[in] serverPort
+     * @param[in] connectionKey The key of the server in 'pool_'.
+     * @return The result of the request.
+     */
+    ExchangeResult sendDelayToServerUring(UringContext& context, int socketDescriptor, std::chrono::milliseconds& serverDelay, const std::string& serverIP,
+                                          int serverPort, const std::string& connectionKey);
+
+    /**
+     * Implementation of 'sendDelayToServer' for 'ClientEngine::SELECT', once the connection operation was started.
+     *
+     * @param[in] socketDescriptor The socket descriptor of the connection.
+     * @param[in] reused Whether 'socketDescriptor' is a keep-alive connection used by a previous request.
+     * @param[in/out] serverDelay
+     * @param[in] connectionKey The key of the server in 'pool_'.
+     * @return The result of the request.
+     */
+    ExchangeResult sendDelayOnSocket(int socketDescriptor, bool reused, std::chrono::milliseconds& serverDelay, const std::string& connectionKey);
+
+    /**
+     * Checks the socket descriptor 'socketDescriptor' in to 'pool_', to be reused in keep-alive mode (or closed otherwise), and
+     * decreases 'numConnections_' to notify all threads.
+     *
+     * @param[in] socketDescriptor
+     * @param[in] connectionKey The key of the server.
+     */
+    void releaseAndNotify(int socketDescriptor, const std::string& connectionKey);
+
     /**
      * Performs a connection operation to 'serverIP_' on port 'serverPort_'.
      *
@@ -62,29 +478,60 @@ private:
     bool connectToServer(int socketDescriptor, const std::string& serverIP, int serverPort);
 
     /**
-     * Closes the socket descriptor 'socketDescriptor' and clears the flag 'isRunning_' to notify all threads.
+     * Writes the first message of a new connection with TCP Fast Open. If there was no cookie of the server, the kernel only sent the SYN,
+     * so this call waits for the handshake to finish before writing the message, as on a regular connection.
+     *
+     * @param[in] socketDescriptor
+     * @param[in] message
+     * @param[in] messageSize
+     * @return true if the message was written, false if the handshake or the write failed, the time out expired or 'stop' was called.
+     */
+    bool writeFastOpenFrame(int socketDescriptor, const char* message, size_t messageSize);
+
+    /**
+     * Closes the socket descriptor 'socketDescriptor' through 'pool_' and decreases 'numConnections_' to notify all threads.
      *
      * @param socketDescriptor The socket descriptor of this client.
+     * @param[in] connectionKey The key of the server.
      */
-    void closeAndNotify(int socketDescriptor);
+    void closeAndNotify(int socketDescriptor, const std::string& connectionKey);
 
     /**
-     * Writes to the end 'write' of the pipe and waits until 'isRunning_' is cleared.
+     * Notifies 'wakeup_' and waits until there are no pending connections.
      */
-    void writeToPipeAndWait();
+    void notifyAndWait();
 
     /**
-     * Check for valid pipe descriptors 'pipeDescriptors_' and, if the descriptors are valid, raises the flag 'isRunning_'.
+     * Checks that the file descriptors of 'wakeup_' were created successfully.
      *
-     * @return true if the pipe descriptors are initialised successfully and the 'isRunning_' flag is raised, false otherwise.
+     * @return true if 'wakeup_' is initialised successfully, false otherwise.
      */
-    bool checkPipeDescriptorsAndRun();
+    bool checkWakeupAndRun();
 
     std::chrono::microseconds timeOut_; //The maximum time to wait for socket operations to complete.
-    int pipeDescriptors_[2]; //The file descriptors involved in the 'Self pipe trick'
+    ClientOptions options_;
+    Wakeup wakeup_; //The file descriptor involved in the 'Self pipe trick'
     std::mutex mutex_;
     size_t numConnections_; //The number of current connections of this client.
     std::condition_variable quitCV_; //To notify to the main that there are no pending connections.
+    ConnectionPool pool_; //The connections of each server and engine.
+    std::unordered_map<std::string, std::shared_ptr<MuxConnection> > muxConnections_; //The multiplexed connection of each server.
+    std::condition_variable responsesCV_; //To notify the requests waiting on a multiplexed connection.
+    uint64_t stopGeneration_; //Increased by 'stop', so the requests waiting on a multiplexed connection give up.
+    std::atomic<long> retryAfter_; //The time to retry after of the last busy answer, in milliseconds.
+    Scheduler asyncScheduler_; //Runs the coroutines of the asynchronous requests. Only accessed by 'asyncThread_' once it is started.
+    std::thread asyncThread_; //Runs 'asyncScheduler_'.
+    Wakeup asyncWakeup_; //Notified when work is posted, or when 'asyncThread_' has to quit.
+    std::mutex asyncMutex_;
+    std::vector<ClientReactor::Work> submittedWork_; //The work posted to 'asyncScheduler_' and not executed yet. Protected by 'asyncMutex_'.
+    bool asyncQuit_; //Raised by the destructor to quit 'asyncThread_'. Protected by 'asyncMutex_'.
+    std::mutex flightsMutex_;
+    std::condition_variable flightsCV_; //To notify the callers waiting for a shared request.
+    uint64_t flightsGeneration_; //Increased by 'stop', so the callers waiting for a shared request give up. Protected by 'flightsMutex_'.
+    std::unordered_map<std::string, std::shared_ptr<Flight> > flights_; //The shared requests in flight, by server and delay.
+    std::unique_ptr<LoadBalancer> balancer_; //Routes the requests without server when the client is built from a list of endpoints.
+    LatencyWindow hedgingLatencies_; //The latencies of the hedged requests, beyond their delays. Only accessed by the thread of the scheduler.
+    Scheduler::Group reactorGroup_; //The group of the coroutines of this client in 'ClientOptions::reactor', or NO_GROUP in 'asyncScheduler_'.
 };
 }
 
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include "client_reactor.h"
+#include "log.h"
+
+namespace pipetrick
+{
+
+ClientReactor::ClientReactor(size_t numThreads)
+: started_(false)
+, nextGroup_(Scheduler::NO_GROUP + 1)
+{
+    for (size_t i = 0; i < std::max<size_t>(1, numThreads); i++)
+    {
+        loops_.emplace_back(new Loop());
+        loops_.back()->quit = false;
+    }
+}
+
+ClientReactor::~ClientReactor()
+{
+    for (auto& loop : loops_)
+    {
+        if (loop->thread.joinable())
+        {
+            {
+                std::scoped_lock lock(loop->mutex);
+                loop->quit = true;
+            }
+            loop->wakeup.notify();
+            loop->thread.join();
+        }
+    }
+}
+
+ClientReactor& ClientReactor::getShared()
+{
+    static ClientReactor sharedReactor;
+    sharedReactor.start();
+    return sharedReactor;
+}
+
+bool ClientReactor::start()
+{
+    std::scoped_lock lock(mutex_);
+    if (started_)
+    {
+        return true;
+    }
+
+    for (auto& loop : loops_)
+    {
+        Loop* loopPtr = loop.get();
+        if (!loop->wakeup.init(WakeupType::EVENTFD, "ClientReactor:") || !loop->scheduler.init(-1, "ClientReactor:")
+            || !loop->scheduler.getLoop().add(loop->wakeup.getDescriptor(), EPOLLIN, [this, loopPtr](uint32_t)
+            {
+                loopPtr->wakeup.consume();
+                runPostedWork(*loopPtr);
+            }))
+        {
+            Log::logError("ClientReactor::start - Could not initialise the scheduler of a thread.");
+            return false;
+        }
+    }
+
+    for (auto& loop : loops_)
+    {
+        Loop* loopPtr = loop.get();
+        loop->thread = std::thread([loopPtr]()
+        {
+            Wakeup::blockSignals();
+            loopPtr->scheduler.run();
+        });
+    }
+    started_ = true;
+    return true;
+}
+
+Scheduler::Group ClientReactor::registerClient()
+{
+    std::scoped_lock lock(mutex_);
+    return nextGroup_++;
+}
+
+bool ClientReactor::post(Scheduler::Group group, Work work)
+{
+    if (!start())
+    {
+        return false;
+    }
+
+    Loop& loop = *loops_[group % loops_.size()];
+    bool notify;
+    {
+        std::scoped_lock lock(loop.mutex);
+        notify = loop.work.empty(); //Otherwise, the thread was already notified and has not executed the previous work yet.
+        loop.work.push_back(std::move(work));
+    }
+
+    if (notify)
+    {
+        loop.wakeup.notify();
+    }
+    return true;
+}
+
+void ClientReactor::cancel(Scheduler::Group group)
+{
+    post(group, [group](Scheduler& scheduler)
+    {
+        scheduler.cancel(group);
+    });
+}
+
+void ClientReactor::runPostedWork(Loop& loop)
+{
+    std::vector<Work> work;
+    bool quit;
+    {
+        std::scoped_lock lock(loop.mutex);
+        work.swap(loop.work);
+        quit = loop.quit;
+    }
+
+    for (Work& item : work)
+    {
+        item(loop.scheduler);
+    }
+
+    if (quit)
+    {
+        loop.scheduler.cancel();
+        loop.scheduler.quit();
+    }
+}
+
+size_t ClientReactor::getNumberOfThreads() const
+{
+    return loops_.size();
+}
+
+size_t ClientReactor::getNumberOfDescriptors() const
+{
+    return loops_.size() * (1 + Wakeup::getNumberOfDescriptors(WakeupType::EVENTFD));
+}
+
+}
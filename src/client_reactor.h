@@ -0,0 +1,113 @@
+#ifndef PT_CLIENT_REACTOR_H
+#define PT_CLIENT_REACTOR_H
+
+#include <stddef.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include "coroutine.h"
+#include "wakeup.h"
+
+namespace pipetrick
+{
+
+/**
+ * A small set of scheduler threads shared by many clients, so each client does not need its own wakeup descriptors, select calls or
+ * threads. Each registered client gets a group of one of the threads, which runs all its coroutines and cancels them on request.
+ */
+class ClientReactor
+{
+public:
+
+    using Work = std::function<void(Scheduler& scheduler)>;
+
+    /**
+     * @param[in] numThreads The number of scheduler threads. Clients are spread among them on registration.
+     */
+    explicit ClientReactor(size_t numThreads = 1);
+
+    /**
+     * Quits the threads. The coroutines still suspended are cancelled.
+     */
+    ~ClientReactor();
+
+    ClientReactor(const ClientReactor&) = delete;
+    ClientReactor& operator=(const ClientReactor&) = delete;
+
+    /**
+     * @return The reactor shared by the whole process, with one thread. Its thread is started on the first call.
+     */
+    static ClientReactor& getShared();
+
+    /**
+     * Creates the schedulers and starts their threads, if they were not started yet.
+     *
+     * @return true if the threads are running, false if a scheduler could not be initialised.
+     */
+    bool start();
+
+    /**
+     * @return A new group, bound to one of the threads, for the coroutines of one client.
+     */
+    Scheduler::Group registerClient();
+
+    /**
+     * Executes 'work' in the thread of 'group'. The coroutines spawned by 'work' have to be spawned in 'group' to be cancelled by 'cancel'.
+     *
+     * @param[in] group
+     * @param[in] work
+     * @return true if 'work' was queued, false if the reactor could not be started.
+     */
+    bool post(Scheduler::Group group, Work work);
+
+    /**
+     * Cancels the suspended coroutines of 'group', and the ones spawned by the work posted before this call.
+     *
+     * @param[in] group
+     */
+    void cancel(Scheduler::Group group);
+
+    /**
+     * @return The number of scheduler threads.
+     */
+    size_t getNumberOfThreads() const;
+
+    /**
+     * @return The number of file descriptors owned by the reactor: one epoll and one eventfd per thread.
+     */
+    size_t getNumberOfDescriptors() const;
+
+private:
+
+    /**
+     * A scheduler thread, along with the work posted to it.
+     */
+    struct Loop
+    {
+        Scheduler scheduler;
+        Wakeup wakeup; //Notified when work is posted, or when the thread has to quit.
+        std::thread thread; //Runs 'scheduler'.
+        std::mutex mutex;
+        std::vector<Work> work; //The work posted and not executed yet. Protected by 'mutex'.
+        bool quit; //Raised by the destructor. Protected by 'mutex'.
+    };
+
+    /**
+     * Executes the work posted to 'loop', or quits it if the destructor was called.
+     *
+     * @param[in] loop
+     */
+    void runPostedWork(Loop& loop);
+
+    std::vector<std::unique_ptr<Loop> > loops_;
+    std::mutex mutex_; //Protects 'started_' and 'nextGroup_'.
+    bool started_;
+    Scheduler::Group nextGroup_; //The group of the next registered client.
+};
+
+}
+
+#endif
@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
 #include "common.h"
 #include "log.h"
 
@@ -56,7 +59,8 @@ bool Common::readMessage(int socketDescriptor, char buffer[BUFFER_SIZE], const s
 
     while (true)
     {
-        ssize_t bytes = read(socketDescriptor, buffer + bufferPosition, BUFFER_SIZE);
+        //Never read beyond this message, since the next one might already be in the socket on a keep-alive connection.
+        ssize_t bytes = read(socketDescriptor, buffer + bufferPosition, BUFFER_SIZE - bufferPosition);
         if (bytes == 0)
         {
             Log::logError(prefix + "Common::readMessage - The remote peer closed the connection.");
@@ -75,11 +79,9 @@ bool Common::readMessage(int socketDescriptor, char buffer[BUFFER_SIZE], const s
             }
             return false;
         }
-        else if (bytes < BUFFER_SIZE)
-        {
-            bufferPosition += bytes;
-        }
-        else
+
+        bufferPosition += bytes;
+        if (bufferPosition == BUFFER_SIZE)
         {
             return true;
         }
@@ -90,23 +92,59 @@ bool Common::readMessage(int socketDescriptor, char buffer[BUFFER_SIZE], const s
 
 bool Common::writeMessage(int socketDescriptor, const char message[BUFFER_SIZE], const std::string& prefix)
 {
-    const char *buffer = message;
+    return writeFrame(socketDescriptor, message, BUFFER_SIZE, prefix);
+}
+
+bool Common::readFrame(int socketDescriptor, char buffer[BUFFER_SIZE], const std::string& prefix)
+{
+    size_t bufferPosition = 0;
+    size_t frameSize = BINARY_FRAME_HEADER_SIZE;
+
+    while (bufferPosition < frameSize)
+    {
+        ssize_t bytes = read(socketDescriptor, buffer + bufferPosition, frameSize - bufferPosition);
+        if (bytes == 0)
+        {
+            Log::logError(prefix + "Common::readFrame - The remote peer closed the connection.");
+            return false;
+        }
+
+        if (bytes == -1)
+        {
+            int errorNumber = errno;
+            Log::logError(prefix + "Common::readFrame - Could not read data from the end point", errorNumber);
+            return false;
+        }
+
+        bufferPosition += bytes;
+        if (bufferPosition >= BINARY_FRAME_HEADER_SIZE)
+        {
+            frameSize = getFrameSize(buffer, bufferPosition);
+        }
+    }
+
+    return true;
+}
+
+bool Common::writeFrame(int socketDescriptor, const char* frame, size_t size, const std::string& prefix)
+{
+    const char *buffer = frame;
     int errorNumber;
-    ssize_t remainingBytesToSend = BUFFER_SIZE;
+    ssize_t remainingBytesToSend = size;
 
     while (remainingBytesToSend)
     {
-        ssize_t bytesSent = write(socketDescriptor, buffer, remainingBytesToSend);
+        ssize_t bytesSent = send(socketDescriptor, buffer, remainingBytesToSend, MSG_NOSIGNAL);
         if (bytesSent == 0)
         {
-            Log::logError(prefix + "Common::writeMessage - The remote peer closed the connection.");
+            Log::logError(prefix + "Common::writeFrame - The remote peer closed the connection.");
             return false;
         }
 
         if (bytesSent == -1)
         {
             errorNumber = errno;
-            Log::logError(prefix + "Common::writeMessage - Could not send data to the end point", errorNumber);
+            Log::logError(prefix + "Common::writeFrame - Could not send data to the end point", errorNumber);
             return false;
         }
         remainingBytesToSend -= bytesSent;
@@ -116,13 +154,23 @@ bool Common::writeMessage(int socketDescriptor, const char message[BUFFER_SIZE],
     return true;
 }
 
+void Common::setNoDelay(int socketDescriptor, const std::string& prefix)
+{
+    int noDelay = 1;
+    if (setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix + "Common::setNoDelay - Could not disable the Nagle algorithm", errorNumber);
+    }
+}
+
 void Common::consumePipe(int pipeReadEnd, const std::string& prefix)
 {
     bool done = false;
     while (!done)
     {
-        char ch;
-        int readResult = read(pipeReadEnd, &ch, 1);
+        char buffer[64];
+        int readResult = read(pipeReadEnd, buffer, sizeof(buffer));
 
         if (readResult == 0)
         {
@@ -143,4 +191,190 @@ void Common::consumePipe(int pipeReadEnd, const std::string& prefix)
     }
 }
 
+namespace
+{
+
+/**
+ * @param[in] value A priority received from a peer.
+ * @return The priority class of 'value'. Unknown classes are the lowest one.
+ */
+Common::Priority toPriority(uint64_t value)
+{
+    return static_cast<Common::Priority>(std::min<uint64_t>(value, static_cast<uint64_t>(Common::Priority::BULK)));
+}
+
+}
+
+void Common::encodeMessage(char buffer[BUFFER_SIZE], long delay, uint32_t requestId, Priority priority, const std::chrono::milliseconds& deadline)
+{
+    memset(buffer, 0, BUFFER_SIZE);
+    if (priority != Priority::NORMAL || deadline.count() > 0)
+    {
+        snprintf(buffer, BUFFER_SIZE, "%ld %u %d %ld", delay, requestId, static_cast<int>(priority), static_cast<long>(std::max<long>(0, deadline.count())));
+    }
+    else if (requestId == NO_REQUEST_ID)
+    {
+        snprintf(buffer, BUFFER_SIZE, "%ld", delay);
+    }
+    else
+    {
+        snprintf(buffer, BUFFER_SIZE, "%ld %u", delay, requestId);
+    }
+}
+
+long Common::decodeMessage(const char buffer[BUFFER_SIZE], uint32_t& requestId, Priority& priority, std::chrono::milliseconds& deadline)
+{
+    char* end;
+    long delay = strtol(buffer, &end, 10);
+    requestId = static_cast<uint32_t>(strtoul(end, &end, 10));
+    const char* priorityText = end;
+    unsigned long value = strtoul(priorityText, &end, 10);
+    priority = end != priorityText ? toPriority(value) : Priority::NORMAL;
+    deadline = std::chrono::milliseconds(static_cast<long>(strtoul(end, nullptr, 10)));
+    return delay;
+}
+
+size_t Common::encodeFrame(char buffer[BUFFER_SIZE], FrameFormat format, long delay, uint32_t requestId, Priority priority, const std::chrono::milliseconds& deadline)
+{
+    if (format == FrameFormat::TEXT)
+    {
+        encodeMessage(buffer, delay, requestId, priority, deadline);
+        return BUFFER_SIZE;
+    }
+
+    uint8_t* frame = reinterpret_cast<uint8_t*>(buffer);
+    size_t size = BINARY_FRAME_HEADER_SIZE;
+    uint64_t values[4] =
+    {
+        (static_cast<uint64_t>(delay) << 1) ^ static_cast<uint64_t>(delay >> 63), //Zigzag, so small negative delays stay short.
+        requestId,
+        static_cast<uint64_t>(priority),
+        std::min<uint64_t>(UINT32_MAX, static_cast<uint64_t>(std::max<long>(0, deadline.count())))
+    };
+
+    //The priority and the deadline are left out if they have their default values, so the message is the same as before they existed.
+    int numFields = priority != Priority::NORMAL || deadline.count() > 0 ? 4 : 2;
+    for (int field = 0; field < numFields; field++)
+    {
+        uint64_t value = values[field];
+        while (value >= 0x80)
+        {
+            frame[size++] = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        frame[size++] = static_cast<uint8_t>(value);
+    }
+    frame[0] = BINARY_FRAME_MAGIC;
+    frame[1] = static_cast<uint8_t>(size - BINARY_FRAME_HEADER_SIZE);
+    return size;
+}
+
+size_t Common::encodeBusyFrame(char buffer[BUFFER_SIZE], const std::chrono::milliseconds& retryAfter)
+{
+    uint8_t* frame = reinterpret_cast<uint8_t*>(buffer);
+    size_t size = BINARY_FRAME_HEADER_SIZE;
+    uint64_t value = static_cast<uint64_t>(std::max<long>(0, retryAfter.count()));
+    while (value >= 0x80)
+    {
+        frame[size++] = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    frame[size++] = static_cast<uint8_t>(value);
+    frame[0] = BUSY_FRAME_MAGIC;
+    frame[1] = static_cast<uint8_t>(size - BINARY_FRAME_HEADER_SIZE);
+    return size;
+}
+
+bool Common::decodeBusyFrame(const char* buffer, std::chrono::milliseconds& retryAfter)
+{
+    if (static_cast<uint8_t>(buffer[0]) != BUSY_FRAME_MAGIC)
+    {
+        return false;
+    }
+
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(buffer) + BINARY_FRAME_HEADER_SIZE;
+    size_t payloadSize = static_cast<uint8_t>(buffer[1]);
+    uint64_t value = 0;
+    for (size_t position = 0; position < payloadSize && position < 10; position++)
+    {
+        value |= static_cast<uint64_t>(payload[position] & 0x7F) << (7 * position);
+    }
+    retryAfter = std::chrono::milliseconds(static_cast<long>(value));
+    return true;
+}
+
+size_t Common::getFrameSize(const char* buffer, size_t size)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    if (getFrameFormat(buffer) == FrameFormat::TEXT && static_cast<uint8_t>(buffer[0]) != BUSY_FRAME_MAGIC)
+    {
+        return BUFFER_SIZE;
+    }
+    return size < BINARY_FRAME_HEADER_SIZE ? 0 : BINARY_FRAME_HEADER_SIZE + static_cast<uint8_t>(buffer[1]);
+}
+
+Common::FrameFormat Common::getFrameFormat(const char* buffer)
+{
+    return static_cast<uint8_t>(buffer[0]) == BINARY_FRAME_MAGIC ? FrameFormat::BINARY : FrameFormat::TEXT;
+}
+
+bool Common::decodeFrame(char* buffer, long& delay, uint32_t& requestId)
+{
+    Priority priority;
+    std::chrono::milliseconds deadline;
+    return decodeFrame(buffer, delay, requestId, priority, deadline);
+}
+
+bool Common::decodeFrame(char* buffer, long& delay, uint32_t& requestId, Priority& priority, std::chrono::milliseconds& deadline)
+{
+    if (static_cast<uint8_t>(buffer[0]) == BUSY_FRAME_MAGIC)
+    {
+        return false;
+    }
+
+    if (getFrameFormat(buffer) == FrameFormat::TEXT)
+    {
+        buffer[BUFFER_SIZE - 1] = 0;
+        delay = decodeMessage(buffer, requestId, priority, deadline);
+        return true;
+    }
+
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(buffer) + BINARY_FRAME_HEADER_SIZE;
+    size_t payloadSize = static_cast<uint8_t>(buffer[1]);
+    size_t position = 0;
+    uint64_t values[4] = {0, 0, static_cast<uint64_t>(Priority::NORMAL), 0};
+    for (int field = 0; field < 4; field++)
+    {
+        if (field == 2 && position == payloadSize)
+        {
+            break; //The priority and the deadline are optional.
+        }
+
+        values[field] = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if (position == payloadSize || shift > 63)
+            {
+                return false;
+            }
+            uint8_t byte = payload[position++];
+            values[field] |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+    }
+
+    delay = static_cast<long>((values[0] >> 1) ^ (~(values[0] & 1) + 1));
+    requestId = static_cast<uint32_t>(values[1]);
+    priority = toPriority(values[2]);
+    deadline = std::chrono::milliseconds(static_cast<long>(std::min<uint64_t>(values[3], UINT32_MAX)));
+    return position == payloadSize;
+}
+
 }
@@ -4,6 +4,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <iostream>
 #include <errno.h>
 #include <string.h>
@@ -12,9 +13,15 @@
 #include <chrono>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <stdint.h>
 
 #define BUFFER_SIZE 1024
 #define DEFAULT_PORT 8080
+#define NO_REQUEST_ID 0 //The request id of the messages of the original protocol, which carry only the delay.
+#define BINARY_FRAME_MAGIC 0xB5 //The first byte of a binary message. Text messages start with a digit or a sign.
+#define BINARY_FRAME_HEADER_SIZE 2 //The magic and the length of the payload.
+#define BUSY_FRAME_MAGIC 0xB6 //The first byte of the answer of a server at capacity: the magic, the length of the payload and the varint of the milliseconds to retry after.
+#define MAX_BINARY_FRAME_SIZE 23 //The header and the payload: the varints of the delay (up to 10 bytes), the request id (up to 5 bytes), the priority (1 byte) and the deadline (up to 5 bytes).
 
 namespace pipetrick
 {
@@ -36,6 +43,25 @@ public:
         ERROR //The select call failed
     };
 
+    /**
+     * The formats of the messages. Both of them can be used on the same connection, and the response to a message has its same format.
+     */
+    enum class FrameFormat
+    {
+        TEXT, //BUFFER_SIZE bytes with the text written by 'encodeMessage', padded with zeros.
+        BINARY //BINARY_FRAME_MAGIC, the length of the payload and the payload: the zigzag varint of the delay followed by the varint of the request id, and optionally the varints of the priority and the deadline.
+    };
+
+    /**
+     * The priority classes of the requests. A server that has to choose among waiting clients serves the classes in this order.
+     */
+    enum class Priority
+    {
+        INTERACTIVE, //Someone is waiting for the answer.
+        NORMAL, //The class of the messages that do not carry one.
+        BULK //Background work, which can wait behind the other classes.
+    };
+
     /**
      * Creates a socket on 'socketDescriptor' with additional flags
      *
@@ -66,6 +92,28 @@ public:
      */
     static bool writeMessage(int socketDescriptor, const char message[BUFFER_SIZE], const std::string& prefix = "");
 
+    /**
+     * Reads one message of any format on the file descriptor 'socketDescriptor', never beyond its end. The header is read first,
+     * so the size of the message is known before reading the rest of it.
+     *
+     * @param[in] socketDescriptor
+     * @param[out] buffer
+     * @param[in] prefix
+     * @return true if the read operation was successful, false otherwise
+     */
+    static bool readFrame(int socketDescriptor, char buffer[BUFFER_SIZE], const std::string& prefix = "");
+
+    /**
+     * Writes the 'size' bytes of 'frame' on the file descriptor 'socketDescriptor'.
+     *
+     * @param[in] socketDescriptor
+     * @param[in] frame
+     * @param[in] size
+     * @param[in] prefix
+     * @return true if the write operation was successful, false otherwise
+     */
+    static bool writeFrame(int socketDescriptor, const char* frame, size_t size, const std::string& prefix = "");
+
     /**
      * Performs a select operation on the file descriptors set in 'readFds' and 'writeFds', with a time out.
      *
@@ -78,10 +126,109 @@ public:
      */
     static SelectResult doSelect(int maxFileDescriptor, fd_set* readFds, fd_set* writeFds, const std::chrono::microseconds* timeOut = nullptr, const std::string& prefix = "");
 
+    /**
+     * Disables the Nagle algorithm on 'socketDescriptor'. Otherwise, the messages written back to back on a multiplexed connection
+     * wait for the delayed acknowledgement of the previous ones.
+     *
+     * @param[in] socketDescriptor
+     * @param[in] prefix
+     */
+    static void setNoDelay(int socketDescriptor, const std::string& prefix = "");
+
     /**
      * Consumes all the pending data in the read end pipe 'pipeReadEnd'.
      */
     static void consumePipe(int pipeReadEnd, const std::string& prefix = "");
+
+    /**
+     * Writes a message of size BUFFER_SIZE with the text "<delay> <requestId> <priority> <deadline>". The trailing fields with their
+     * default values are left out, so the message is just "<delay>" if it carries none of them. Peers that parse the message with 'atoi'
+     * only see the delay.
+     *
+     * @param[out] buffer
+     * @param[in] delay
+     * @param[in] requestId
+     * @param[in] priority
+     * @param[in] deadline The time the sender is willing to wait for the answer. Zero means there is no deadline.
+     */
+    static void encodeMessage(char buffer[BUFFER_SIZE], long delay, uint32_t requestId = NO_REQUEST_ID, Priority priority = Priority::NORMAL,
+                              const std::chrono::milliseconds& deadline = std::chrono::milliseconds(0));
+
+    /**
+     * Parses a message written by 'encodeMessage'.
+     *
+     * @param[in] buffer
+     * @param[out] requestId The request id of the message, or NO_REQUEST_ID if it does not carry one.
+     * @param[out] priority
+     * @param[out] deadline
+     * @return The delay of the message.
+     */
+    static long decodeMessage(const char buffer[BUFFER_SIZE], uint32_t& requestId, Priority& priority, std::chrono::milliseconds& deadline);
+
+    /**
+     * Writes a message of format 'format' at the beginning of 'buffer'. Only text messages are padded to BUFFER_SIZE.
+     *
+     * @param[out] buffer
+     * @param[in] format
+     * @param[in] delay
+     * @param[in] requestId
+     * @param[in] priority
+     * @param[in] deadline The time the sender is willing to wait for the answer. Zero means there is no deadline.
+     * @return The size of the message.
+     */
+    static size_t encodeFrame(char buffer[BUFFER_SIZE], FrameFormat format, long delay, uint32_t requestId = NO_REQUEST_ID, Priority priority = Priority::NORMAL,
+                              const std::chrono::milliseconds& deadline = std::chrono::milliseconds(0));
+
+    /**
+     * Writes the answer of a server that cannot take more clients at the beginning of 'buffer'.
+     *
+     * @param[out] buffer
+     * @param[in] retryAfter The time the client should wait before trying again.
+     * @return The size of the message.
+     */
+    static size_t encodeBusyFrame(char buffer[BUFFER_SIZE], const std::chrono::milliseconds& retryAfter);
+
+    /**
+     * @param[in] buffer A whole message.
+     * @param[out] retryAfter The time the client should wait before trying again, if the message is a busy answer.
+     * @return true if the message was written by 'encodeBusyFrame', false otherwise.
+     */
+    static bool decodeBusyFrame(const char* buffer, std::chrono::milliseconds& retryAfter);
+
+    /**
+     * @param[in] buffer The beginning of a message.
+     * @param[in] size The number of bytes of 'buffer' already received.
+     * @return The size of the whole message, or 0 if 'buffer' does not contain enough bytes to know it yet.
+     */
+    static size_t getFrameSize(const char* buffer, size_t size);
+
+    /**
+     * @param[in] buffer The beginning of a message, with at least one byte.
+     * @return The format of the message.
+     */
+    static FrameFormat getFrameFormat(const char* buffer);
+
+    /**
+     * Parses a whole message written by 'encodeFrame'. The last byte of a text message is overwritten with a zero.
+     *
+     * @param[in/out] buffer
+     * @param[out] delay
+     * @param[out] requestId
+     * @return true if the message was parsed successfully, false if it is malformed or a busy answer.
+     */
+    static bool decodeFrame(char* buffer, long& delay, uint32_t& requestId);
+
+    /**
+     * Parses a whole message written by 'encodeFrame', along with its priority and deadline. The last byte of a text message is overwritten with a zero.
+     *
+     * @param[in/out] buffer
+     * @param[out] delay
+     * @param[out] requestId
+     * @param[out] priority 'Priority::NORMAL' if the message does not carry one.
+     * @param[out] deadline Zero if the message does not carry one.
+     * @return true if the message was parsed successfully, false if it is malformed or a busy answer.
+     */
+    static bool decodeFrame(char* buffer, long& delay, uint32_t& requestId, Priority& priority, std::chrono::milliseconds& deadline);
 };
 
 }
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <cmath>
+#include "concurrency_limiter.h"
+
+namespace pipetrick
+{
+
+ConcurrencyLimiter::ConcurrencyLimiter(size_t maxLimit, const ConcurrencyLimitOptions& options)
+: options_(options)
+, maxLimit_(static_cast<double>(std::max<size_t>(1, maxLimit)))
+, minLimit_(std::min(maxLimit_, static_cast<double>(std::max<size_t>(1, options.minLimit))))
+, limit_(maxLimit_)
+, samplesSinceDecrease_(static_cast<size_t>(maxLimit_)) //So the first late sample already decreases the limit.
+, averageLateness_(0)
+{
+}
+
+void ConcurrencyLimiter::onSample(const std::chrono::microseconds& lateness, size_t inFlight)
+{
+    bool saturated = 2.0 * inFlight >= limit_;
+    if (options_.algorithm == LimitAlgorithm::AIMD)
+    {
+        samplesSinceDecrease_++;
+        if (lateness > options_.latencyTolerance)
+        {
+            //The late responses of the requests admitted before a decrease do not decrease the limit again.
+            if (samplesSinceDecrease_ >= limit_)
+            {
+                limit_ *= options_.backoffRatio;
+                samplesSinceDecrease_ = 0;
+            }
+        }
+        else if (saturated)
+        {
+            limit_ += 1.0 / limit_;
+        }
+    }
+    else if (options_.algorithm == LimitAlgorithm::GRADIENT)
+    {
+        double sample = static_cast<double>(std::max<long>(0, lateness.count()));
+        averageLateness_ += options_.smoothing * (sample - averageLateness_);
+
+        double tolerance = std::max(1.0, static_cast<double>(options_.latencyTolerance.count()));
+        double gradient = std::clamp(tolerance / std::max(tolerance, averageLateness_), 0.5, 1.0);
+        double target = limit_ * gradient;
+        if (saturated)
+        {
+            target += std::sqrt(limit_); //The headroom to probe for a higher limit.
+        }
+        limit_ += options_.smoothing * (target - limit_);
+    }
+
+    limit_ = std::clamp(limit_, minLimit_, maxLimit_);
+}
+
+size_t ConcurrencyLimiter::getLimit() const
+{
+    return static_cast<size_t>(limit_);
+}
+
+}
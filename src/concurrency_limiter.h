@@ -0,0 +1,71 @@
+#ifndef PT_CONCURRENCY_LIMITER_H
+#define PT_CONCURRENCY_LIMITER_H
+
+#include <stddef.h>
+#include <chrono>
+
+namespace pipetrick
+{
+
+/**
+ * The ways a 'ConcurrencyLimiter' adjusts its limit.
+ */
+enum class LimitAlgorithm
+{
+    FIXED, //The limit is always the maximum one.
+    AIMD, //The limit grows by one per limit of timely samples, and is multiplied by 'backoffRatio' at most once per limit of samples if they are late.
+    GRADIENT //The limit follows the ratio between 'latencyTolerance' and the moving average of the lateness, plus a headroom of its square root.
+};
+
+/**
+ * Optional settings of a 'ConcurrencyLimiter'.
+ */
+struct ConcurrencyLimitOptions
+{
+    LimitAlgorithm algorithm = LimitAlgorithm::FIXED;
+    size_t minLimit = 1; //The limit never goes below it.
+    std::chrono::microseconds latencyTolerance = std::chrono::microseconds(5000); //The lateness of a response that is still considered timely.
+    double backoffRatio = 0.9; //What the limit is multiplied by when the responses are late, in 'LimitAlgorithm::AIMD'.
+    double smoothing = 0.2; //The weight of each new sample, between zero and one, in 'LimitAlgorithm::GRADIENT'.
+};
+
+/**
+ * Adjusts a limit of requests in flight from the lateness of the responses, so an overloaded server admits fewer clients
+ * before the latency of all of them degrades. The lateness of a response is the time it was written after it was due. Not thread safe.
+ */
+class ConcurrencyLimiter
+{
+public:
+
+    /**
+     * @param[in] maxLimit The initial limit, which is never exceeded.
+     * @param[in] options
+     */
+    ConcurrencyLimiter(size_t maxLimit, const ConcurrencyLimitOptions& options = ConcurrencyLimitOptions());
+
+    /**
+     * Updates the limit with the lateness of one response.
+     *
+     * @param[in] lateness
+     * @param[in] inFlight The number of requests in flight when the response was written. The limit only grows if they use at least half of it.
+     */
+    void onSample(const std::chrono::microseconds& lateness, size_t inFlight);
+
+    /**
+     * @return The current limit, between the minimum and the maximum one.
+     */
+    size_t getLimit() const;
+
+private:
+
+    ConcurrencyLimitOptions options_;
+    double maxLimit_;
+    double minLimit_;
+    double limit_; //Fractional, so the additive increase and the smoothing accumulate.
+    size_t samplesSinceDecrease_; //The number of samples since the last multiplicative decrease.
+    double averageLateness_; //The moving average of the lateness, in microseconds.
+};
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include "connection_pool.h"
+#include "log.h"
+
+namespace pipetrick
+{
+
+ConnectionPool::ConnectionPool(const ConnectionPoolOptions& options)
+: options_(options)
+, cancelGeneration_(0)
+{
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    for (auto& endpoint : endpoints_)
+    {
+        for (const IdleConnection& connection : endpoint.second.idle)
+        {
+            close(connection.socketDescriptor);
+        }
+    }
+}
+
+bool ConnectionPool::isHealthy(const IdleConnection& connection) const
+{
+    if (options_.maxIdleTime.count() > 0 && std::chrono::steady_clock::now() - connection.since > options_.maxIdleTime)
+    {
+        Log::logVerbose("ConnectionPool::isHealthy - The connection was idle for too long.");
+        return false;
+    }
+
+    //An idle connection must not be readable: either the remote peer closed it, or it sent data nobody asked for.
+    char byte;
+    ssize_t bytes = recv(connection.socketDescriptor, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return true;
+    }
+    Log::logVerbose("ConnectionPool::isHealthy - The remote peer closed an idle connection.");
+    return false;
+}
+
+bool ConnectionPool::checkout(const std::string& key, int& socketDescriptor, const std::chrono::microseconds& timeOut)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Endpoint& endpoint = endpoints_[key];
+    uint64_t generation = cancelGeneration_;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeOut;
+
+    while (true)
+    {
+        while (!endpoint.idle.empty())
+        {
+            IdleConnection connection = endpoint.idle.back();
+            endpoint.idle.pop_back();
+            if (isHealthy(connection))
+            {
+                socketDescriptor = connection.socketDescriptor;
+                return true;
+            }
+            close(connection.socketDescriptor);
+            endpoint.total--;
+        }
+
+        if (options_.maxTotal == 0 || endpoint.total < options_.maxTotal)
+        {
+            endpoint.total++;
+            socketDescriptor = -1;
+            return true;
+        }
+
+        if (checkinCV_.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            Log::logError("ConnectionPool::checkout - Time out expired when waiting for a connection under the limit.");
+            return false;
+        }
+
+        if (generation != cancelGeneration_)
+        {
+            Log::logVerbose("ConnectionPool::checkout - Cancelled while waiting for a connection under the limit.");
+            return false;
+        }
+    }
+}
+
+void ConnectionPool::checkin(const std::string& key, int socketDescriptor, bool reusable)
+{
+    std::scoped_lock lock(mutex_);
+    Endpoint& endpoint = endpoints_[key];
+    if (reusable && socketDescriptor != -1 && endpoint.idle.size() < options_.maxIdle)
+    {
+        endpoint.idle.push_back(IdleConnection{socketDescriptor, std::chrono::steady_clock::now()});
+        checkinCV_.notify_one();
+        return;
+    }
+
+    if (socketDescriptor != -1)
+    {
+        close(socketDescriptor);
+    }
+    endpoint.total--;
+    checkinCV_.notify_one();
+}
+
+void ConnectionPool::cancel()
+{
+    std::scoped_lock lock(mutex_);
+    for (auto& endpoint : endpoints_)
+    {
+        for (const IdleConnection& connection : endpoint.second.idle)
+        {
+            close(connection.socketDescriptor);
+        }
+        endpoint.second.total -= endpoint.second.idle.size();
+        endpoint.second.idle.clear();
+    }
+    cancelGeneration_++;
+    checkinCV_.notify_all();
+}
+
+size_t ConnectionPool::getNumberOfIdleConnections(const std::string& key) const
+{
+    std::scoped_lock lock(mutex_);
+    auto endpoint = endpoints_.find(key);
+    return endpoint == endpoints_.end() ? 0 : endpoint->second.idle.size();
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef PT_CONNECTION_POOL_H
+#define PT_CONNECTION_POOL_H
+
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <deque>
+#include <string>
+
+namespace pipetrick
+{
+
+/**
+ * The limits of the connections of each endpoint of a 'ConnectionPool'.
+ */
+struct ConnectionPoolOptions
+{
+    size_t maxIdle = 8; //The maximum number of idle connections kept open. The connections checked in beyond it are closed.
+    size_t maxTotal = 0; //The maximum number of idle and checked out connections. Zero means no limit.
+    std::chrono::milliseconds maxIdleTime = std::chrono::milliseconds(0); //The idle connections older than this are closed on checkout. Zero means no limit.
+};
+
+/**
+ * The connections of a client to each endpoint, identified by a key. A connection is checked out to send a request on it, and checked
+ * in once the response is read, so the next request to the same endpoint can reuse it. Thread safe.
+ */
+class ConnectionPool
+{
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param[in] options
+     */
+    ConnectionPool(const ConnectionPoolOptions& options = ConnectionPoolOptions());
+
+    /**
+     * Closes the idle connections.
+     */
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /**
+     * Checks out a connection to the endpoint 'key'. The idle connections are checked before being handed out: the ones closed by the
+     * remote peer, with unexpected pending data or idle for longer than 'ConnectionPoolOptions::maxIdleTime' are closed.
+     * If the endpoint already has 'ConnectionPoolOptions::maxTotal' connections, this call waits for one of them to be checked in.
+     *
+     * @param[in] key
+     * @param[out] socketDescriptor The idle connection, or -1 if the caller has to create a new one, which then counts towards the limit.
+     * @param[in] timeOut The maximum time to wait for a connection under the limit.
+     * @return true if the connection was checked out, false if the time out expired or 'cancel' was called while waiting.
+     */
+    bool checkout(const std::string& key, int& socketDescriptor, const std::chrono::microseconds& timeOut);
+
+    /**
+     * Gives back a connection checked out from the endpoint 'key'.
+     *
+     * @param[in] key
+     * @param[in] socketDescriptor The connection, or -1 if the caller could not create a new one.
+     * @param[in] reusable Whether the connection can serve another request. Otherwise, or if the endpoint already has
+     *                     'ConnectionPoolOptions::maxIdle' idle connections, it is closed.
+     */
+    void checkin(const std::string& key, int socketDescriptor, bool reusable);
+
+    /**
+     * Closes all the idle connections and wakes up the calls to 'checkout' waiting for a connection, which fail.
+     */
+    void cancel();
+
+    /**
+     * @param[in] key
+     * @return The number of idle connections to the endpoint 'key'.
+     */
+    size_t getNumberOfIdleConnections(const std::string& key) const;
+
+private:
+
+    /**
+     * An idle connection.
+     */
+    struct IdleConnection
+    {
+        int socketDescriptor;
+        std::chrono::steady_clock::time_point since; //The time of the checkin.
+    };
+
+    /**
+     * The connections to one endpoint.
+     */
+    struct Endpoint
+    {
+        std::deque<IdleConnection> idle; //The most recently checked in connections are at the back.
+        size_t total = 0; //The idle and checked out connections.
+    };
+
+    /**
+     * @param[in] connection
+     * @return true if 'connection' can be reused, false if it has to be closed.
+     */
+    bool isHealthy(const IdleConnection& connection) const;
+
+    ConnectionPoolOptions options_;
+    std::unordered_map<std::string, Endpoint> endpoints_;
+    uint64_t cancelGeneration_; //Increased by 'cancel', so the waiting calls to 'checkout' give up.
+    mutable std::mutex mutex_;
+    std::condition_variable checkinCV_; //Notified when a connection is closed or 'cancel' is called.
+};
+
+}
+
+#endif
@@ -0,0 +1,417 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <atomic>
+#include <new>
+#include <vector>
+#include "coroutine.h"
+#include "common.h"
+#include "log.h"
+
+namespace pipetrick
+{
+
+namespace
+{
+
+const size_t FRAME_SIZE_CLASS = 64; //The granularity of the pooled frames, in bytes.
+const size_t NUM_FRAME_SIZE_CLASSES = 16; //So frames of up to 1024 bytes are pooled.
+const size_t MAX_FREE_FRAMES = 4096; //The maximum number of free frames kept per size class and thread.
+
+std::atomic<size_t> numberFrames(0);
+std::atomic<size_t> maximumFrameSize(0);
+
+/**
+ * The free frames of one thread, by size class.
+ */
+struct FreeFrames
+{
+    ~FreeFrames()
+    {
+        for (std::vector<void*>& frames : sizeClasses)
+        {
+            for (void* frame : frames)
+            {
+                ::operator delete(frame);
+            }
+        }
+    }
+
+    std::vector<void*> sizeClasses[NUM_FRAME_SIZE_CLASSES];
+};
+
+thread_local FreeFrames freeFrames;
+
+}
+
+void* FramePool::allocate(size_t size)
+{
+    numberFrames++;
+    size_t maximum = maximumFrameSize;
+    while (size > maximum && !maximumFrameSize.compare_exchange_weak(maximum, size))
+    {
+    }
+
+    size_t sizeClass = (size + FRAME_SIZE_CLASS - 1) / FRAME_SIZE_CLASS - 1;
+    if (sizeClass >= NUM_FRAME_SIZE_CLASSES)
+    {
+        return ::operator new(size);
+    }
+
+    std::vector<void*>& frames = freeFrames.sizeClasses[sizeClass];
+    if (frames.empty())
+    {
+        return ::operator new((sizeClass + 1) * FRAME_SIZE_CLASS);
+    }
+
+    void* frame = frames.back();
+    frames.pop_back();
+    return frame;
+}
+
+void FramePool::deallocate(void* frame, size_t size)
+{
+    numberFrames--;
+    size_t sizeClass = (size + FRAME_SIZE_CLASS - 1) / FRAME_SIZE_CLASS - 1;
+    if (sizeClass >= NUM_FRAME_SIZE_CLASSES || freeFrames.sizeClasses[sizeClass].size() >= MAX_FREE_FRAMES)
+    {
+        ::operator delete(frame);
+        return;
+    }
+
+    freeFrames.sizeClasses[sizeClass].push_back(frame);
+}
+
+size_t FramePool::getNumberOfFrames()
+{
+    return numberFrames;
+}
+
+size_t FramePool::getMaximumFrameSize()
+{
+    return maximumFrameSize;
+}
+
+const Scheduler::Group Scheduler::NO_GROUP = 0;
+
+namespace
+{
+
+const Scheduler::Group FIRST_NESTED_GROUP = Scheduler::Group(1) << 63; //So the groups created by a scheduler never clash with the ones given by its owner.
+
+}
+
+Scheduler::Awaiter::Awaiter(Scheduler& scheduler, int fileDescriptor, uint32_t events, const std::chrono::milliseconds& timeOut)
+: scheduler_(scheduler)
+, fileDescriptor_(fileDescriptor)
+, events_(events)
+, timeOut_(timeOut)
+, timer_(EventLoop::INVALID_TIMER)
+, result_(IoResult::OK)
+, group_(scheduler.currentGroup_)
+{
+}
+
+bool Scheduler::Awaiter::await_ready()
+{
+    if (scheduler_.cancelling_ || scheduler_.isInGroup(group_, scheduler_.cancellingGroup_))
+    {
+        result_ = IoResult::CANCELLED;
+        return true;
+    }
+
+    return fileDescriptor_ == -1 && timeOut_.count() <= 0;
+}
+
+bool Scheduler::Awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    handle_ = handle;
+    if (fileDescriptor_ != -1 && !scheduler_.loop_.add(fileDescriptor_, events_, [this](uint32_t)
+    {
+        complete(IoResult::OK);
+    }))
+    {
+        result_ = IoResult::FAILED;
+        return false;
+    }
+
+    if (timeOut_.count() > 0)
+    {
+        timer_ = scheduler_.loop_.addTimer(timeOut_, [this]()
+        {
+            timer_ = EventLoop::INVALID_TIMER;
+            complete(fileDescriptor_ == -1 ? IoResult::OK : IoResult::TIMED_OUT);
+        });
+    }
+
+    scheduler_.waiters_.insert(this);
+    return true;
+}
+
+IoResult Scheduler::Awaiter::await_resume() const
+{
+    return result_;
+}
+
+void Scheduler::Awaiter::complete(IoResult result)
+{
+    result_ = result;
+    if (fileDescriptor_ != -1)
+    {
+        scheduler_.loop_.remove(fileDescriptor_);
+    }
+    scheduler_.loop_.cancelTimer(timer_);
+    scheduler_.waiters_.erase(this);
+
+    //The coroutine keeps its group until it suspends again.
+    Scheduler& scheduler = scheduler_;
+    Group previousGroup = std::exchange(scheduler.currentGroup_, group_);
+    handle_.resume(); //This awaiter is not valid from here on.
+    scheduler.currentGroup_ = previousGroup;
+}
+
+Scheduler::Scheduler()
+: cancelDescriptor_(-1)
+, watchingCancellation_(false)
+, cancelling_(false)
+, cancellingGroup_(NO_GROUP)
+, currentGroup_(NO_GROUP)
+, nextGroup_(FIRST_NESTED_GROUP)
+{
+}
+
+Scheduler::~Scheduler()
+{
+    cancel();
+}
+
+bool Scheduler::init(int cancelDescriptor, const std::string& prefix)
+{
+    prefix_ = prefix;
+    cancelDescriptor_ = cancelDescriptor;
+    if (!loop_.init(prefix))
+    {
+        return false;
+    }
+
+    if (cancelDescriptor_ != -1 && !loop_.add(cancelDescriptor_, EPOLLIN, [this](uint32_t)
+    {
+        Log::logVerbose(prefix_ + "Scheduler::run - Cancelling the suspended coroutines by the self pipe trick.");
+        //The descriptor stays readable until its owner consumes it.
+        watchingCancellation_ = !loop_.modify(cancelDescriptor_, 0);
+        cancel();
+    }))
+    {
+        return false;
+    }
+
+    watchingCancellation_ = cancelDescriptor_ != -1;
+    return true;
+}
+
+void Scheduler::watchCancellation()
+{
+    if (!watchingCancellation_ && cancelDescriptor_ != -1)
+    {
+        watchingCancellation_ = loop_.modify(cancelDescriptor_, EPOLLIN);
+    }
+}
+
+Scheduler::Group Scheduler::createGroup(Group parent)
+{
+    Group group = nextGroup_++;
+    parents_[group] = parent;
+    return group;
+}
+
+void Scheduler::releaseGroup(Group group)
+{
+    parents_.erase(group);
+}
+
+bool Scheduler::isInGroup(Group group, Group ancestor) const
+{
+    if (ancestor == NO_GROUP)
+    {
+        return false;
+    }
+
+    while (group != NO_GROUP && group != ancestor)
+    {
+        auto parent = parents_.find(group);
+        group = parent != parents_.end() ? parent->second : NO_GROUP;
+    }
+    return group == ancestor;
+}
+
+Scheduler::Awaiter Scheduler::wait(int fileDescriptor, uint32_t events, const std::chrono::milliseconds& timeOut)
+{
+    return Awaiter(*this, fileDescriptor, events, timeOut);
+}
+
+Scheduler::Awaiter Scheduler::sleep(const std::chrono::milliseconds& delay)
+{
+    return Awaiter(*this, -1, 0, delay);
+}
+
+Task<IoResult> Scheduler::connect(int socketDescriptor, std::string serverIP, int serverPort, std::chrono::milliseconds timeOut)
+{
+    struct sockaddr_in serverAddress;
+    serverAddress.sin_addr.s_addr = inet_addr(serverIP.c_str());
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_port = htons(serverPort);
+
+    if (::connect(socketDescriptor, (struct sockaddr*) &serverAddress, sizeof(serverAddress)) == 0)
+    {
+        co_return IoResult::OK;
+    }
+
+    int errorNumber = errno;
+    if (errorNumber != EINPROGRESS)
+    {
+        Log::logError(prefix_ + "Scheduler::connect - Could not connect to the server", errorNumber);
+        co_return IoResult::FAILED;
+    }
+
+    IoResult result = co_await wait(socketDescriptor, EPOLLOUT, timeOut);
+    if (result != IoResult::OK)
+    {
+        co_return result;
+    }
+
+    int socketError = 0;
+    socklen_t socketErrorSize = sizeof(socketError);
+    if (getsockopt(socketDescriptor, SOL_SOCKET, SO_ERROR, &socketError, &socketErrorSize) == -1 || socketError != 0)
+    {
+        Log::logError(prefix_ + "Scheduler::connect - Could not connect to the server", socketError);
+        co_return IoResult::FAILED;
+    }
+
+    co_return IoResult::OK;
+}
+
+Task<IoResult> Scheduler::write(int socketDescriptor, const char* buffer, size_t size, std::chrono::milliseconds timeOut)
+{
+    size_t position = 0;
+    while (position < size)
+    {
+        ssize_t bytesSent = send(socketDescriptor, buffer + position, size - position, MSG_NOSIGNAL);
+        if (bytesSent != -1)
+        {
+            position += bytesSent;
+            continue;
+        }
+
+        int errorNumber = errno;
+        if (errorNumber != EAGAIN && errorNumber != EWOULDBLOCK)
+        {
+            Log::logError(prefix_ + "Scheduler::write - Could not write to the socket", errorNumber);
+            co_return IoResult::FAILED;
+        }
+
+        IoResult result = co_await wait(socketDescriptor, EPOLLOUT, timeOut);
+        if (result != IoResult::OK)
+        {
+            co_return result;
+        }
+    }
+
+    co_return IoResult::OK;
+}
+
+Task<IoResult> Scheduler::readFrame(int socketDescriptor, char* buffer, std::chrono::milliseconds timeOut)
+{
+    size_t position = 0;
+    while (true)
+    {
+        //The size of the frame is known once its header is read.
+        size_t frameSize = Common::getFrameSize(buffer, position);
+        if (frameSize != 0 && position >= frameSize)
+        {
+            co_return IoResult::OK;
+        }
+
+        size_t bytesToRead = frameSize != 0 ? frameSize - position : BINARY_FRAME_HEADER_SIZE - position;
+        ssize_t bytes = read(socketDescriptor, buffer + position, bytesToRead);
+        if (bytes > 0)
+        {
+            position += bytes;
+            continue;
+        }
+
+        if (bytes == 0)
+        {
+            Log::logVerbose(prefix_ + "Scheduler::readFrame - The remote peer closed the connection.");
+            co_return IoResult::FAILED;
+        }
+
+        int errorNumber = errno;
+        if (errorNumber != EAGAIN && errorNumber != EWOULDBLOCK)
+        {
+            Log::logError(prefix_ + "Scheduler::readFrame - Could not read from the socket", errorNumber);
+            co_return IoResult::FAILED;
+        }
+
+        IoResult result = co_await wait(socketDescriptor, EPOLLIN | EPOLLRDHUP, timeOut);
+        if (result != IoResult::OK)
+        {
+            co_return result;
+        }
+    }
+}
+
+void Scheduler::cancel()
+{
+    cancelling_ = true;
+    while (!waiters_.empty())
+    {
+        (*waiters_.begin())->complete(IoResult::CANCELLED);
+    }
+    cancelling_ = false;
+}
+
+void Scheduler::cancel(Group group)
+{
+    //A coroutine resumed here might cancel a nested group.
+    Group previousGroup = std::exchange(cancellingGroup_, group);
+    bool cancelled = true;
+    while (cancelled)
+    {
+        //Resuming a coroutine might change 'waiters_', so the search starts over after each one.
+        cancelled = false;
+        for (Awaiter* waiter : waiters_)
+        {
+            if (isInGroup(waiter->group_, group))
+            {
+                waiter->complete(IoResult::CANCELLED);
+                cancelled = true;
+                break;
+            }
+        }
+    }
+    cancellingGroup_ = previousGroup;
+}
+
+size_t Scheduler::getNumberOfWaiters() const
+{
+    return waiters_.size();
+}
+
+EventLoop& Scheduler::getLoop()
+{
+    return loop_;
+}
+
+bool Scheduler::run()
+{
+    return loop_.run();
+}
+
+void Scheduler::quit()
+{
+    loop_.quit();
+}
+
+}
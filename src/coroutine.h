@@ -0,0 +1,445 @@
+#ifndef PT_COROUTINE_H
+#define PT_COROUTINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <coroutine>
+#include <chrono>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include "event_loop.h"
+
+namespace pipetrick
+{
+
+/**
+ * Pooled allocator of coroutine frames. Frames are rounded up to a size class and kept in a free list of the thread that releases them,
+ * so starting a coroutine does not call the global allocator once the pool is warm. Frames larger than the biggest size class
+ * use the global allocator.
+ */
+class FramePool
+{
+public:
+
+    /**
+     * @param[in] size
+     * @return A block of at least 'size' bytes.
+     */
+    static void* allocate(size_t size);
+
+    /**
+     * Gives back to the pool a block returned by 'allocate'.
+     *
+     * @param[in] frame
+     * @param[in] size The size requested to 'allocate'.
+     */
+    static void deallocate(void* frame, size_t size);
+
+    /**
+     * @return The number of frames allocated and not released yet, in all the threads.
+     */
+    static size_t getNumberOfFrames();
+
+    /**
+     * @return The size of the largest frame ever allocated.
+     */
+    static size_t getMaximumFrameSize();
+};
+
+/**
+ * The outcome of waiting on a 'Scheduler'.
+ */
+enum class IoResult
+{
+    OK, //The file descriptor is ready, the sleeping time expired, or the operation finished.
+    FAILED, //The operation failed, or the remote peer closed the connection.
+    TIMED_OUT, //The file descriptor was not ready in time.
+    CANCELLED //The cancellation descriptor of the scheduler became readable (the 'Self pipe trick').
+};
+
+/**
+ * Resumes the awaiting coroutine, if any, when a 'Task' finishes.
+ */
+struct FinalAwaiter
+{
+    bool await_ready() noexcept
+    {
+        return false;
+    }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+    {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() noexcept
+    {
+    }
+};
+
+/**
+ * A lazy coroutine returning a 'T'. It starts running when it is awaited, and the awaiting coroutine is resumed once it finishes.
+ * The frame is owned by the task and comes from 'FramePool'.
+ */
+template <typename T>
+class Task
+{
+public:
+
+    struct promise_type
+    {
+        T value;
+        std::coroutine_handle<> continuation; //The coroutine awaiting this task.
+
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        FinalAwaiter final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_value(T result)
+        {
+            value = std::move(result);
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+
+        static void* operator new(size_t size)
+        {
+            return FramePool::allocate(size);
+        }
+
+        static void operator delete(void* frame, size_t size)
+        {
+            FramePool::deallocate(frame, size);
+        }
+    };
+
+    Task(Task&& other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        handle_.promise().continuation = caller;
+        return handle_;
+    }
+
+    T await_resume()
+    {
+        return std::move(handle_.promise().value);
+    }
+
+private:
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+    : handle_(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * An eager coroutine that destroys itself once it finishes. It is the root of the tasks started by 'Scheduler::spawn'.
+ */
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object()
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+
+        static void* operator new(size_t size)
+        {
+            return FramePool::allocate(size);
+        }
+
+        static void operator delete(void* frame, size_t size)
+        {
+            FramePool::deallocate(frame, size);
+        }
+    };
+};
+
+/**
+ * Single threaded scheduler of coroutines on top of an 'EventLoop'. Coroutines suspend on a file descriptor or a timer instead of
+ * blocking the thread, and the loop resumes them once they are ready. When the cancellation descriptor becomes readable, every
+ * suspended coroutine is resumed with 'IoResult::CANCELLED'. Coroutines can also be spawned in a group, to cancel only the ones of that group.
+ * Groups created by 'createGroup' are nested in a parent group, so cancelling the parent also cancels them.
+ * All the methods, except the constructor and the destructor, must be called from the thread that executes 'run'.
+ */
+class Scheduler
+{
+public:
+
+    using Group = uint64_t;
+
+    static const Group NO_GROUP;
+
+    /**
+     * Suspends the awaiting coroutine until a file descriptor is ready or a timer expires.
+     */
+    class Awaiter
+    {
+    public:
+
+        /**
+         * @param[in] scheduler
+         * @param[in] fileDescriptor The descriptor to watch, or -1 to wait for the timer only.
+         * @param[in] events The epoll events to watch.
+         * @param[in] timeOut Zero waits forever.
+         */
+        Awaiter(Scheduler& scheduler, int fileDescriptor, uint32_t events, const std::chrono::milliseconds& timeOut);
+
+        Awaiter(const Awaiter&) = delete;
+        Awaiter& operator=(const Awaiter&) = delete;
+
+        bool await_ready();
+
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        IoResult await_resume() const;
+
+    private:
+
+        friend class Scheduler;
+
+        /**
+         * Stops watching the descriptor and the timer, and resumes the awaiting coroutine with 'result'.
+         *
+         * @param[in] result
+         */
+        void complete(IoResult result);
+
+        Scheduler& scheduler_;
+        int fileDescriptor_;
+        uint32_t events_;
+        std::chrono::milliseconds timeOut_;
+        EventLoop::TimerId timer_;
+        std::coroutine_handle<> handle_; //The suspended coroutine.
+        IoResult result_;
+        Group group_; //The group of the spawned coroutine that awaits.
+    };
+
+    Scheduler();
+
+    /**
+     * Resumes every suspended coroutine with 'IoResult::CANCELLED', so all their frames are released.
+     */
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /**
+     * Creates the event loop and watches 'cancelDescriptor'. Once it becomes readable, it is not watched again until the next
+     * call to 'spawn', so the owner has time to consume it.
+     *
+     * @param[in] cancelDescriptor The read end of the 'Self pipe trick', or -1 to cancel only by calls to 'cancel'.
+     * @param[in] prefix
+     * @return true if the scheduler was initialised successfully, false otherwise.
+     */
+    bool init(int cancelDescriptor, const std::string& prefix = "");
+
+    /**
+     * Starts 'task' right away. Once it finishes, 'onDone' is called with its result in the thread of the scheduler.
+     *
+     * @param[in] task
+     * @param[in] onDone
+     * @param[in] group The group of 'task', and of all the tasks it awaits.
+     */
+    template <typename T, typename Callback>
+    void spawn(Task<T> task, Callback onDone, Group group = NO_GROUP)
+    {
+        watchCancellation();
+        Group previousGroup = std::exchange(currentGroup_, group);
+        runDetached(std::move(task), std::move(onDone));
+        currentGroup_ = previousGroup;
+    }
+
+    /**
+     * @param[in] parent
+     * @return A new group nested in 'parent'. Cancelling 'parent' also cancels the coroutines of the new group.
+     */
+    Group createGroup(Group parent = NO_GROUP);
+
+    /**
+     * Forgets a group returned by 'createGroup'. Its coroutines must have finished.
+     *
+     * @param[in] group
+     */
+    void releaseGroup(Group group);
+
+    /**
+     * @param[in] fileDescriptor
+     * @param[in] events The epoll events to wait for.
+     * @param[in] timeOut Zero waits forever.
+     * @return An awaitable resulting in 'IoResult::OK' once 'fileDescriptor' is ready.
+     */
+    Awaiter wait(int fileDescriptor, uint32_t events, const std::chrono::milliseconds& timeOut = std::chrono::milliseconds(0));
+
+    /**
+     * @param[in] delay
+     * @return An awaitable resulting in 'IoResult::OK' once 'delay' expires.
+     */
+    Awaiter sleep(const std::chrono::milliseconds& delay);
+
+    /**
+     * Connects the non blocking socket 'socketDescriptor' to 'serverIP':'serverPort'.
+     *
+     * @param[in] socketDescriptor
+     * @param[in] serverIP
+     * @param[in] serverPort
+     * @param[in] timeOut Zero waits forever.
+     */
+    Task<IoResult> connect(int socketDescriptor, std::string serverIP, int serverPort, std::chrono::milliseconds timeOut);
+
+    /**
+     * Writes 'size' bytes of 'buffer' to the non blocking socket 'socketDescriptor'.
+     *
+     * @param[in] socketDescriptor
+     * @param[in] buffer It must stay valid until the task finishes.
+     * @param[in] size
+     * @param[in] timeOut The maximum time to wait for the socket to be writable. Zero waits forever.
+     */
+    Task<IoResult> write(int socketDescriptor, const char* buffer, size_t size, std::chrono::milliseconds timeOut);
+
+    /**
+     * Reads one whole frame, text or binary, from the non blocking socket 'socketDescriptor'. It never reads beyond the frame, so
+     * the bytes of the next frames stay in the socket.
+     *
+     * @param[in] socketDescriptor
+     * @param[out] buffer At least BUFFER_SIZE bytes. It must stay valid until the task finishes.
+     * @param[in] timeOut The maximum time to wait for the socket to be readable. Zero waits forever.
+     * @return A task resulting in 'IoResult::FAILED' if the remote peer closed the connection or the read failed.
+     */
+    Task<IoResult> readFrame(int socketDescriptor, char* buffer, std::chrono::milliseconds timeOut);
+
+    /**
+     * Resumes every suspended coroutine with 'IoResult::CANCELLED'. The coroutines that wait again while they are being cancelled
+     * are not suspended, and get 'IoResult::CANCELLED' right away.
+     */
+    void cancel();
+
+    /**
+     * Resumes the suspended coroutines of 'group', and of the groups nested in it, with 'IoResult::CANCELLED'. The coroutines of 'group'
+     * that wait again while they are being cancelled get 'IoResult::CANCELLED' right away.
+     *
+     * @param[in] group
+     */
+    void cancel(Group group);
+
+    /**
+     * @return The number of suspended coroutines.
+     */
+    size_t getNumberOfWaiters() const;
+
+    /**
+     * @return The loop of the scheduler, to watch other descriptors.
+     */
+    EventLoop& getLoop();
+
+    /**
+     * Dispatches events and timers until 'quit' is called or until the epoll call fails.
+     *
+     * @return true if the loop finished because of a call to 'quit', false if the epoll call failed.
+     */
+    bool run();
+
+    /**
+     * Makes 'run' return after the current iteration.
+     */
+    void quit();
+
+private:
+
+    template <typename T, typename Callback>
+    static DetachedTask runDetached(Task<T> task, Callback onDone)
+    {
+        T result = co_await task;
+        onDone(result);
+    }
+
+    /**
+     * @param[in] group
+     * @param[in] ancestor
+     * @return true if 'group' is 'ancestor' or is nested in it.
+     */
+    bool isInGroup(Group group, Group ancestor) const;
+
+    /**
+     * Watches 'cancelDescriptor_' again if it was disabled by a cancellation.
+     */
+    void watchCancellation();
+
+    EventLoop loop_;
+    int cancelDescriptor_; //The read end of the 'Self pipe trick'.
+    bool watchingCancellation_; //Whether 'cancelDescriptor_' is watched.
+    bool cancelling_; //Raised while 'cancel' resumes the suspended coroutines.
+    Group cancellingGroup_; //The group being cancelled, or NO_GROUP.
+    Group currentGroup_; //The group of the coroutine being executed.
+    Group nextGroup_; //The next group returned by 'createGroup'.
+    std::unordered_map<Group, Group> parents_; //The parent of each group returned by 'createGroup'.
+    std::unordered_set<Awaiter*> waiters_; //The awaiters of the suspended coroutines.
+    std::string prefix_;
+};
+
+}
+
+#endif
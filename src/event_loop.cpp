@@ -0,0 +1,194 @@
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <algorithm>
+#include "event_loop.h"
+#include "log.h"
+
+namespace pipetrick
+{
+
+const EventLoop::TimerId EventLoop::INVALID_TIMER = TimerWheel::INVALID_TIMER;
+
+EventLoop::EventLoop()
+: epollDescriptor_(-1)
+, quit_(false)
+, nextGeneration_(0)
+, startTime_(std::chrono::steady_clock::now())
+{
+}
+
+EventLoop::~EventLoop()
+{
+    if (epollDescriptor_ != -1)
+    {
+        close(epollDescriptor_);
+    }
+}
+
+bool EventLoop::init(const std::string& prefix)
+{
+    prefix_ = prefix;
+    epollDescriptor_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epollDescriptor_ == -1)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "EventLoop::init - Could not create the epoll file descriptor", errorNumber);
+        return false;
+    }
+
+    return true;
+}
+
+bool EventLoop::add(int fileDescriptor, uint32_t events, Handler handler)
+{
+    uint32_t generation = nextGeneration_++;
+    struct epoll_event event;
+    event.events = events;
+    event.data.u64 = (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fileDescriptor);
+
+    if (epoll_ctl(epollDescriptor_, EPOLL_CTL_ADD, fileDescriptor, &event) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "EventLoop::add - Could not register the file descriptor", errorNumber);
+        return false;
+    }
+
+    registrations_[fileDescriptor] = Registration{generation, std::move(handler)};
+    return true;
+}
+
+bool EventLoop::modify(int fileDescriptor, uint32_t events)
+{
+    auto registration = registrations_.find(fileDescriptor);
+    if (registration == registrations_.end())
+    {
+        Log::logError(prefix_ + "EventLoop::modify - The file descriptor is not registered.");
+        return false;
+    }
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.u64 = (static_cast<uint64_t>(registration->second.generation) << 32) | static_cast<uint32_t>(fileDescriptor);
+
+    if (epoll_ctl(epollDescriptor_, EPOLL_CTL_MOD, fileDescriptor, &event) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "EventLoop::modify - Could not modify the events of the file descriptor", errorNumber);
+        return false;
+    }
+
+    return true;
+}
+
+void EventLoop::remove(int fileDescriptor)
+{
+    auto registration = registrations_.find(fileDescriptor);
+    if (registration == registrations_.end())
+    {
+        return;
+    }
+
+    if (epoll_ctl(epollDescriptor_, EPOLL_CTL_DEL, fileDescriptor, nullptr) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "EventLoop::remove - Could not unregister the file descriptor", errorNumber);
+    }
+
+    //The handler might be the one being executed right now, so its destruction is deferred to the end of the iteration.
+    removedHandlers_.push_back(std::move(registration->second.handler));
+    registrations_.erase(registration);
+}
+
+EventLoop::TimerId EventLoop::addTimer(const std::chrono::milliseconds& delay, TimerHandler handler)
+{
+    //Round up, so the timer never expires before 'delay'.
+    auto expiration = std::chrono::ceil<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime_ + delay);
+    return timers_.add(expiration.count(), std::move(handler));
+}
+
+void EventLoop::cancelTimer(TimerId timerId)
+{
+    timers_.cancel(timerId);
+}
+
+size_t EventLoop::getNumberOfTimers() const
+{
+    return timers_.size();
+}
+
+uint64_t EventLoop::getCurrentTick() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime_).count();
+}
+
+int EventLoop::nextTimeOut() const
+{
+    uint64_t nextTick = timers_.nextEventTick();
+    if (nextTick == UINT64_MAX)
+    {
+        return -1;
+    }
+
+    uint64_t currentTick = getCurrentTick();
+    if (nextTick <= currentTick)
+    {
+        return 0;
+    }
+
+    return static_cast<int>(std::min<uint64_t>(nextTick - currentTick, INT_MAX));
+}
+
+void EventLoop::runExpiredTimers()
+{
+    timers_.advance(getCurrentTick());
+}
+
+bool EventLoop::run()
+{
+    const int MAX_EVENTS = 256;
+    struct epoll_event events[MAX_EVENTS];
+
+    quit_ = false;
+    while (!quit_)
+    {
+        int numberEvents = epoll_wait(epollDescriptor_, events, MAX_EVENTS, nextTimeOut());
+        if (numberEvents == -1)
+        {
+            int errorNumber = errno;
+            if (errorNumber == EINTR)
+            {
+                continue;
+            }
+            Log::logError(prefix_ + "EventLoop::run - epoll_wait failed", errorNumber);
+            return false;
+        }
+
+        for (int i = 0; i < numberEvents && !quit_; i++)
+        {
+            int fileDescriptor = static_cast<int>(events[i].data.u64 & 0xFFFFFFFF);
+            uint32_t generation = static_cast<uint32_t>(events[i].data.u64 >> 32);
+            auto registration = registrations_.find(fileDescriptor);
+            if (registration == registrations_.end() || registration->second.generation != generation)
+            {
+                continue;
+            }
+            registration->second.handler(events[i].events);
+        }
+
+        if (!quit_)
+        {
+            runExpiredTimers();
+        }
+        removedHandlers_.clear();
+    }
+
+    return true;
+}
+
+void EventLoop::quit()
+{
+    quit_ = true;
+}
+
+}
@@ -0,0 +1,138 @@
+#ifndef PT_EVENT_LOOP_H
+#define PT_EVENT_LOOP_H
+
+#include <sys/epoll.h>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include "timer_wheel.h"
+
+namespace pipetrick
+{
+
+/**
+ * Single threaded event loop based on epoll.
+ * File descriptors are registered together with a handler that is executed in the loop thread every time the descriptor is ready,
+ * and timers are executed in the loop thread once they expire. Timers are kept in a timer wheel with a resolution of one millisecond.
+ * All the methods, except the constructor and the destructor, must be called from the thread that executes 'run'.
+ */
+class EventLoop
+{
+public:
+
+    using Handler = std::function<void(uint32_t events)>;
+    using TimerHandler = TimerWheel::Handler;
+    using TimerId = TimerWheel::TimerId;
+
+    static const TimerId INVALID_TIMER;
+
+    EventLoop();
+
+    ~EventLoop();
+
+    /**
+     * Creates the epoll file descriptor.
+     *
+     * @param[in] prefix
+     * @return true if the epoll file descriptor was created successfully, false otherwise.
+     */
+    bool init(const std::string& prefix = "");
+
+    /**
+     * Registers the file descriptor 'fileDescriptor' to be watched for the epoll events 'events'.
+     *
+     * @param[in] fileDescriptor
+     * @param[in] events The epoll events (EPOLLIN, EPOLLOUT, ...) to watch.
+     * @param[in] handler The handler to execute each time 'fileDescriptor' is ready.
+     * @return true if the file descriptor was registered successfully, false otherwise.
+     */
+    bool add(int fileDescriptor, uint32_t events, Handler handler);
+
+    /**
+     * Changes the events watched for the registered file descriptor 'fileDescriptor'.
+     *
+     * @param[in] fileDescriptor
+     * @param[in] events The new epoll events to watch. Zero disables the notifications without unregistering the descriptor.
+     * @return true if the events were modified successfully, false otherwise.
+     */
+    bool modify(int fileDescriptor, uint32_t events);
+
+    /**
+     * Unregisters the file descriptor 'fileDescriptor'. Pending events for it in the current iteration are discarded.
+     * It must be called before closing the descriptor.
+     *
+     * @param[in] fileDescriptor
+     */
+    void remove(int fileDescriptor);
+
+    /**
+     * Schedules 'handler' to be executed once 'delay' expires.
+     *
+     * @param[in] delay
+     * @param[in] handler
+     * @return The identifier of the timer, to be used in 'cancelTimer'.
+     */
+    TimerId addTimer(const std::chrono::milliseconds& delay, TimerHandler handler);
+
+    /**
+     * Cancels a pending timer. Cancelling an expired or unknown timer has no effect.
+     *
+     * @param[in] timerId
+     */
+    void cancelTimer(TimerId timerId);
+
+    /**
+     * @return The number of pending timers.
+     */
+    size_t getNumberOfTimers() const;
+
+    /**
+     * Dispatches events and timers until 'quit' is called or until the epoll call fails.
+     *
+     * @return true if the loop finished because of a call to 'quit', false if the epoll call failed.
+     */
+    bool run();
+
+    /**
+     * Makes 'run' return after the current iteration.
+     */
+    void quit();
+
+private:
+
+    struct Registration
+    {
+        uint32_t generation; //Discards stale events of a descriptor number that was reused in the same iteration.
+        Handler handler;
+    };
+
+    /**
+     * @return The time in milliseconds until the next timer expires, or -1 if there are no pending timers.
+     */
+    int nextTimeOut() const;
+
+    /**
+     * @return The number of milliseconds elapsed since the construction of the loop, which is the current tick of 'timers_'.
+     */
+    uint64_t getCurrentTick() const;
+
+    /**
+     * Executes the handlers of all the expired timers.
+     */
+    void runExpiredTimers();
+
+    int epollDescriptor_; //The epoll file descriptor.
+    bool quit_; //Raised by 'quit'.
+    uint32_t nextGeneration_;
+    std::chrono::steady_clock::time_point startTime_; //The time of the tick zero of 'timers_'.
+    std::unordered_map<int, Registration> registrations_; //The handlers of the registered file descriptors.
+    std::vector<Handler> removedHandlers_; //Handlers removed while dispatching, destroyed at the end of the iteration.
+    TimerWheel timers_; //The pending timers.
+    std::string prefix_;
+};
+
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "io_uring.h"
+#include "log.h"
+
+namespace pipetrick
+{
+
+IoUring::IoUring()
+: ringDescriptor_(-1)
+, sqRing_(MAP_FAILED)
+, sqRingSize_(0)
+, cqRing_(MAP_FAILED)
+, cqRingSize_(0)
+, sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED))
+, sqHead_(nullptr)
+, sqTail_(nullptr)
+, sqMask_(nullptr)
+, sqArray_(nullptr)
+, cqHead_(nullptr)
+, cqTail_(nullptr)
+, cqMask_(nullptr)
+, cqes_(nullptr)
+, localSqTail_(0)
+{
+    memset(&params_, 0, sizeof(params_));
+}
+
+IoUring::~IoUring()
+{
+    if (sqes_ != MAP_FAILED)
+    {
+        munmap(sqes_, params_.sq_entries * sizeof(struct io_uring_sqe));
+    }
+
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+    {
+        munmap(cqRing_, cqRingSize_);
+    }
+
+    if (sqRing_ != MAP_FAILED)
+    {
+        munmap(sqRing_, sqRingSize_);
+    }
+
+    if (ringDescriptor_ != -1)
+    {
+        close(ringDescriptor_);
+    }
+}
+
+bool IoUring::init(unsigned entries, const std::string& prefix)
+{
+    prefix_ = prefix;
+    ringDescriptor_ = syscall(__NR_io_uring_setup, entries, &params_);
+    if (ringDescriptor_ == -1)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "IoUring::init - Could not create the io_uring instance", errorNumber);
+        return false;
+    }
+
+    sqRingSize_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params_.cq_off.cqes + params_.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMap = params_.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap && cqRingSize_ > sqRingSize_)
+    {
+        sqRingSize_ = cqRingSize_;
+    }
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "IoUring::init - Could not map the submission ring", errorNumber);
+        return false;
+    }
+
+    cqRing_ = singleMap ? sqRing_ : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor_, IORING_OFF_CQ_RING);
+    if (cqRing_ == MAP_FAILED)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "IoUring::init - Could not map the completion ring", errorNumber);
+        return false;
+    }
+
+    void* sqes = mmap(nullptr, params_.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "IoUring::init - Could not map the submission entries", errorNumber);
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sqRing = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sqRing + params_.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sqRing + params_.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sqRing + params_.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sqRing + params_.sq_off.array);
+
+    char* cqRing = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cqRing + params_.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cqRing + params_.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cqRing + params_.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cqRing + params_.cq_off.cqes);
+
+    localSqTail_ = *sqTail_;
+    return true;
+}
+
+bool IoUring::isSupported(const std::vector<uint8_t>& opcodes)
+{
+    //The probe is followed by one entry per operation, up to the last operation known by these headers.
+    std::vector<char> probeBuffer(sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(probeBuffer.data());
+    if (syscall(__NR_io_uring_register, ringDescriptor_, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "IoUring::isSupported - Could not probe the operations", errorNumber);
+        return false;
+    }
+
+    for (uint8_t opcode : opcodes)
+    {
+        if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED))
+        {
+            Log::logError(prefix_ + "IoUring::isSupported - The operation " + std::to_string(opcode) + " is not supported.");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IoUring::registerBuffers(const struct iovec* buffers, unsigned numberBuffers)
+{
+    if (syscall(__NR_io_uring_register, ringDescriptor_, IORING_REGISTER_BUFFERS, buffers, numberBuffers) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError(prefix_ + "IoUring::registerBuffers - Could not register the buffers", errorNumber);
+        return false;
+    }
+
+    return true;
+}
+
+struct io_uring_sqe* IoUring::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (localSqTail_ - head >= params_.sq_entries)
+    {
+        if (!submit())
+        {
+            return nullptr;
+        }
+
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (localSqTail_ - head >= params_.sq_entries)
+        {
+            return nullptr;
+        }
+    }
+
+    unsigned index = localSqTail_ & *sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    localSqTail_++;
+    return sqe;
+}
+
+bool IoUring::reserve(unsigned number)
+{
+    if (localSqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) + number <= params_.sq_entries)
+    {
+        return true;
+    }
+
+    return submit() && localSqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) + number <= params_.sq_entries;
+}
+
+bool IoUring::submit(unsigned waitNumber)
+{
+    __atomic_store_n(sqTail_, localSqTail_, __ATOMIC_RELEASE);
+
+    while (true)
+    {
+        //The entries consumed by an interrupted call are not submitted again, since the kernel already moved the head.
+        unsigned pendingSubmissions = localSqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        unsigned flags = waitNumber ? IORING_ENTER_GETEVENTS : 0;
+        if (syscall(__NR_io_uring_enter, ringDescriptor_, pendingSubmissions, waitNumber, flags, nullptr, 0) >= 0)
+        {
+            return true;
+        }
+
+        int errorNumber = errno;
+        if (errorNumber != EINTR)
+        {
+            Log::logError(prefix_ + "IoUring::submit - io_uring_enter failed", errorNumber);
+            return false;
+        }
+    }
+}
+
+bool IoUring::popCqe(struct io_uring_cqe& cqe)
+{
+    unsigned head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+
+    cqe = cqes_[head & *cqMask_];
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+}
@@ -0,0 +1,112 @@
+#ifndef PT_IO_URING_H
+#define PT_IO_URING_H
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace pipetrick
+{
+
+/**
+ * Minimal wrapper of an io_uring instance, built directly on top of the io_uring system calls.
+ * It is not thread safe: submissions and completions must be handled by one thread at a time.
+ */
+class IoUring
+{
+public:
+
+    IoUring();
+
+    /**
+     * Unmaps the rings and closes the io_uring file descriptor.
+     */
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * Creates the io_uring instance and maps its submission and completion rings.
+     *
+     * @param[in] entries The number of entries of the submission ring.
+     * @param[in] prefix
+     * @return true if the instance was created successfully, false if io_uring is not available.
+     */
+    bool init(unsigned entries, const std::string& prefix = "");
+
+    /**
+     * Asks the kernel, with IORING_REGISTER_PROBE, whether it implements some operations. The flags of each operation are not probed.
+     *
+     * @param[in] opcodes
+     * @return true if all of 'opcodes' are supported, false otherwise, or if the kernel is too old to be probed.
+     */
+    bool isSupported(const std::vector<uint8_t>& opcodes);
+
+    /**
+     * Registers 'numberBuffers' buffers to be used by the IORING_OP_READ_FIXED and IORING_OP_WRITE_FIXED operations.
+     *
+     * @param[in] buffers
+     * @param[in] numberBuffers
+     * @return true if the buffers were registered successfully, false otherwise.
+     */
+    bool registerBuffers(const struct iovec* buffers, unsigned numberBuffers);
+
+    /**
+     * Gets a zeroed submission queue entry. If the submission ring is full, the queued entries are submitted first.
+     *
+     * @return The entry, or nullptr if the submission ring is full and could not be submitted.
+     */
+    struct io_uring_sqe* getSqe();
+
+    /**
+     * Makes room for 'number' consecutive submission queue entries, submitting the queued ones if needed. Linked operations
+     * have to be reserved together, so they are not split across two io_uring_enter calls.
+     *
+     * @param[in] number
+     * @return true if the next 'number' calls to 'getSqe' will not submit, false otherwise.
+     */
+    bool reserve(unsigned number);
+
+    /**
+     * Submits all the queued entries and waits for at least 'waitNumber' completions, with a single io_uring_enter call.
+     *
+     * @param[in] waitNumber
+     * @return true if the call was successful, false otherwise.
+     */
+    bool submit(unsigned waitNumber = 0);
+
+    /**
+     * Takes the oldest completion out of the completion ring.
+     *
+     * @param[out] cqe
+     * @return true if there was a completion, false if the completion ring is empty.
+     */
+    bool popCqe(struct io_uring_cqe& cqe);
+
+private:
+
+    int ringDescriptor_;
+    struct io_uring_params params_;
+    void* sqRing_; //The mapped submission ring.
+    size_t sqRingSize_;
+    void* cqRing_; //The mapped completion ring. It is the same mapping as 'sqRing_' if the kernel supports IORING_FEAT_SINGLE_MMAP.
+    size_t cqRingSize_;
+    struct io_uring_sqe* sqes_; //The mapped array of submission entries.
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    struct io_uring_cqe* cqes_;
+    unsigned localSqTail_; //The tail of the submission ring, published to the kernel on 'submit'.
+    std::string prefix_;
+};
+
+}
+
+#endif
@@ -0,0 +1,43 @@
+#include <algorithm>
+#include "latency_window.h"
+
+namespace pipetrick
+{
+
+LatencyWindow::LatencyWindow(size_t capacity)
+: capacity_(std::max<size_t>(1, capacity))
+, next_(0)
+{
+}
+
+void LatencyWindow::record(const std::chrono::microseconds& latency)
+{
+    if (samples_.size() < capacity_)
+    {
+        samples_.push_back(latency);
+        return;
+    }
+
+    samples_[next_] = latency;
+    next_ = (next_ + 1) % capacity_;
+}
+
+size_t LatencyWindow::getNumberOfSamples() const
+{
+    return samples_.size();
+}
+
+std::chrono::microseconds LatencyWindow::getPercentile(double percentile) const
+{
+    if (samples_.empty())
+    {
+        return std::chrono::microseconds(0);
+    }
+
+    std::vector<std::chrono::microseconds> sorted(samples_);
+    size_t position = std::min(sorted.size() - 1, static_cast<size_t>(std::max(0.0, percentile) * sorted.size()));
+    std::nth_element(sorted.begin(), sorted.begin() + position, sorted.end());
+    return sorted[position];
+}
+
+}
@@ -0,0 +1,48 @@
+#ifndef PT_LATENCY_WINDOW_H
+#define PT_LATENCY_WINDOW_H
+
+#include <stddef.h>
+#include <chrono>
+#include <vector>
+
+namespace pipetrick
+{
+
+/**
+ * The most recent latencies of a kind of request, to estimate their percentiles. Not thread safe.
+ */
+class LatencyWindow
+{
+public:
+
+    /**
+     * @param[in] capacity The number of recent latencies kept. The oldest one is replaced once it is full.
+     */
+    explicit LatencyWindow(size_t capacity = 1000);
+
+    /**
+     * @param[in] latency
+     */
+    void record(const std::chrono::microseconds& latency);
+
+    /**
+     * @return The number of latencies kept.
+     */
+    size_t getNumberOfSamples() const;
+
+    /**
+     * @param[in] percentile Between zero and one.
+     * @return The latency under which 'percentile' of the latencies kept are, or zero if there are none.
+     */
+    std::chrono::microseconds getPercentile(double percentile) const;
+
+private:
+
+    std::vector<std::chrono::microseconds> samples_;
+    size_t capacity_;
+    size_t next_; //The position of the next latency once 'samples_' is full.
+};
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include "load_balancer.h"
+#include "common.h"
+#include "log.h"
+
+namespace pipetrick
+{
+
+LoadBalancer::LoadBalancer(const std::vector<Endpoint>& endpoints, const LoadBalancerOptions& options)
+: options_(options)
+, next_(0)
+, random_(std::random_device()())
+{
+    for (const Endpoint& endpoint : endpoints)
+    {
+        servers_.push_back(Server{endpoint, 0, 0, 0, std::chrono::steady_clock::time_point()});
+    }
+
+    if (servers_.empty())
+    {
+        Log::logError("LoadBalancer::LoadBalancer - There are no endpoints, so the requests go to the default server.");
+        servers_.push_back(Server{Endpoint{"127.0.0.1", DEFAULT_PORT}, 0, 0, 0, std::chrono::steady_clock::time_point()});
+    }
+}
+
+size_t LoadBalancer::pick()
+{
+    std::scoped_lock lock(mutex_);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < servers_.size(); i++)
+    {
+        //Starting from 'next_', so the order of the candidates rotates.
+        size_t server = (next_ + i) % servers_.size();
+        if (isAvailable(server, now))
+        {
+            candidates.push_back(server);
+        }
+    }
+
+    if (candidates.empty())
+    {
+        Log::logVerbose("LoadBalancer::pick - All the servers are ejected, so all of them are picked again.");
+        for (size_t i = 0; i < servers_.size(); i++)
+        {
+            candidates.push_back((next_ + i) % servers_.size());
+        }
+    }
+
+    size_t picked = candidates[0];
+    if (options_.policy == BalancingPolicy::LEAST_OUTSTANDING)
+    {
+        for (size_t candidate : candidates)
+        {
+            if (servers_[candidate].outstanding < servers_[picked].outstanding)
+            {
+                picked = candidate;
+            }
+        }
+    }
+    else if (options_.policy == BalancingPolicy::POWER_OF_TWO_EWMA && candidates.size() > 1)
+    {
+        size_t first = random_() % candidates.size();
+        size_t second = random_() % (candidates.size() - 1);
+        second += second >= first ? 1 : 0; //Two different candidates.
+        picked = getCost(candidates[first]) <= getCost(candidates[second]) ? candidates[first] : candidates[second];
+    }
+
+    next_ = (picked + 1) % servers_.size();
+    servers_[picked].outstanding++;
+    return picked;
+}
+
+void LoadBalancer::release(size_t server, bool success, const std::chrono::microseconds& latency)
+{
+    std::scoped_lock lock(mutex_);
+    Server& state = servers_[server];
+    state.outstanding--;
+    if (success)
+    {
+        double sample = static_cast<double>(latency.count());
+        state.latency = state.latency == 0 ? sample : options_.ewmaWeight * sample + (1 - options_.ewmaWeight) * state.latency;
+        state.failures = 0;
+        return;
+    }
+
+    state.failures++;
+    if (options_.maxFailures != 0 && state.failures >= options_.maxFailures)
+    {
+        Log::logVerbose("LoadBalancer::release - Ejecting the server " + state.endpoint.ip + ":" + std::to_string(state.endpoint.port));
+        state.ejectedUntil = std::chrono::steady_clock::now() + options_.ejectionTime;
+        state.failures = 0;
+    }
+}
+
+void LoadBalancer::abandon(size_t server)
+{
+    std::scoped_lock lock(mutex_);
+    servers_[server].outstanding--;
+}
+
+const Endpoint& LoadBalancer::getEndpoint(size_t server) const
+{
+    return servers_[server].endpoint;
+}
+
+size_t LoadBalancer::getNumberOfServers() const
+{
+    return servers_.size();
+}
+
+size_t LoadBalancer::getNumberOfOutstanding(size_t server)
+{
+    std::scoped_lock lock(mutex_);
+    return servers_[server].outstanding;
+}
+
+bool LoadBalancer::isEjected(size_t server)
+{
+    std::scoped_lock lock(mutex_);
+    return !isAvailable(server, std::chrono::steady_clock::now());
+}
+
+bool LoadBalancer::isAvailable(size_t server, const std::chrono::steady_clock::time_point& now) const
+{
+    return servers_[server].ejectedUntil <= now;
+}
+
+double LoadBalancer::getCost(size_t server) const
+{
+    return servers_[server].latency * (servers_[server].outstanding + 1);
+}
+
+}
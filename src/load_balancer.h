@@ -0,0 +1,145 @@
+#ifndef PT_LOAD_BALANCER_H
+#define PT_LOAD_BALANCER_H
+
+#include <stddef.h>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace pipetrick
+{
+
+/**
+ * The address of a server.
+ */
+struct Endpoint
+{
+    std::string ip;
+    int port;
+};
+
+/**
+ * The ways a 'LoadBalancer' picks the server of each request.
+ */
+enum class BalancingPolicy
+{
+    ROUND_ROBIN, //Each server in turn.
+    LEAST_OUTSTANDING, //The server with the fewest requests in flight. Ties are broken in turn.
+    POWER_OF_TWO_EWMA //The best of two servers picked at random, by their average latency weighted by their requests in flight.
+};
+
+/**
+ * Optional settings of a 'LoadBalancer'.
+ */
+struct LoadBalancerOptions
+{
+    BalancingPolicy policy = BalancingPolicy::ROUND_ROBIN;
+    double ewmaWeight = 0.3; //The weight of each new latency in the moving average of a server, between zero and one.
+    size_t maxFailures = 3; //The number of consecutive failed requests, such as time outs, after which a server is ejected. Zero never ejects.
+    std::chrono::milliseconds ejectionTime = std::chrono::milliseconds(5000); //The time an ejected server is not picked.
+};
+
+/**
+ * Routes the requests of a client among a set of servers. Servers whose requests keep failing are ejected for a while (passive outlier
+ * detection). If all of them are ejected, they are all picked again. Thread safe.
+ */
+class LoadBalancer
+{
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param[in] endpoints At least one.
+     * @param[in] options
+     */
+    LoadBalancer(const std::vector<Endpoint>& endpoints, const LoadBalancerOptions& options = LoadBalancerOptions());
+
+    LoadBalancer(const LoadBalancer&) = delete;
+    LoadBalancer& operator=(const LoadBalancer&) = delete;
+
+    /**
+     * Picks the server of a new request, which counts as outstanding until 'release' is called.
+     *
+     * @return The index of the server.
+     */
+    size_t pick();
+
+    /**
+     * Finishes a request to the server 'server'.
+     *
+     * @param[in] server The index returned by 'pick'.
+     * @param[in] success Whether the server answered back. A failed request counts towards the ejection of the server.
+     * @param[in] latency The time the server took to answer back, only used if 'success' is true.
+     */
+    void release(size_t server, bool success, const std::chrono::microseconds& latency);
+
+    /**
+     * Finishes a request to the server 'server' that was neither answered nor failed by the server, such as a cancelled request.
+     *
+     * @param[in] server The index returned by 'pick'.
+     */
+    void abandon(size_t server);
+
+    /**
+     * @param[in] server
+     * @return The address of the server 'server'.
+     */
+    const Endpoint& getEndpoint(size_t server) const;
+
+    /**
+     * @return The number of servers.
+     */
+    size_t getNumberOfServers() const;
+
+    /**
+     * @param[in] server
+     * @return The number of outstanding requests of the server 'server'.
+     */
+    size_t getNumberOfOutstanding(size_t server);
+
+    /**
+     * @param[in] server
+     * @return Whether the server 'server' is ejected now.
+     */
+    bool isEjected(size_t server);
+
+private:
+
+    /**
+     * The state of one server.
+     */
+    struct Server
+    {
+        Endpoint endpoint;
+        size_t outstanding; //The number of requests in flight.
+        double latency; //The moving average of the latencies, in microseconds. Zero until the first one, so new servers are tried first.
+        size_t failures; //The number of consecutive failed requests.
+        std::chrono::steady_clock::time_point ejectedUntil;
+    };
+
+    /**
+     * @param[in] server
+     * @param[in] now
+     * @return Whether the server 'server' can be picked. The caller must hold 'mutex_'.
+     */
+    bool isAvailable(size_t server, const std::chrono::steady_clock::time_point& now) const;
+
+    /**
+     * @param[in] server
+     * @return The cost of sending one more request to the server 'server'. The caller must hold 'mutex_'.
+     */
+    double getCost(size_t server) const;
+
+    std::vector<Server> servers_;
+    LoadBalancerOptions options_;
+    std::mutex mutex_;
+    size_t next_; //The first server to consider by the next pick in turn.
+    std::minstd_rand random_; //Picks the candidates of the power of two choices.
+};
+
+}
+
+#endif
@@ -6,6 +6,7 @@ namespace pipetrick
 {
 
 std::mutex Log::mutex_;
+std::atomic<bool> Log::verbose_(true);
 
 void Log::logError(const std::string& errorMsg)
 {
@@ -21,6 +22,10 @@ void Log::logError(const std::string &errorMsg, int errnoNumber)
 void Log::logVerbose(const std::string& message)
 {
 #ifdef VERBOSE_LOGIN
+    if (!verbose_)
+    {
+        return;
+    }
     std::scoped_lock lock(mutex_);
     std::cout << message << std::endl;
 #else
@@ -28,4 +33,9 @@ void Log::logVerbose(const std::string& message)
 #endif
 }
 
+void Log::setVerbose(bool verbose)
+{
+    verbose_ = verbose;
+}
+
 }
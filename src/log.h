@@ -1,6 +1,7 @@
 #ifndef PT_LOG_H
 #define PT_LOG_H
 #include <mutex>
+#include <atomic>
 #include <string>
 
 namespace pipetrick
@@ -31,8 +32,16 @@ public:
      */
     static void logVerbose(const std::string &message);
 
+    /**
+     * Enables or disables the verbose messages at runtime. They are enabled by default when VERBOSE_LOGIN is defined.
+     *
+     * @param[in] verbose
+     */
+    static void setVerbose(bool verbose);
+
 private:
     static std::mutex mutex_;
+    static std::atomic<bool> verbose_;
 };
 
 }
@@ -1,151 +1,249 @@
 #include <sys/ioctl.h>
+#include <time.h>
+#include <poll.h>
+#include <algorithm>
+#include <queue>
 #include "server.h"
 #include "log.h"
 
 namespace pipetrick
 {
 
+namespace
+{
+
+//The operations of the io_uring engine. They are stored in the lowest bits of the user data of each submission, and the rest of
+//bits contain the address of the connection or the request, if any.
+const uint64_t URING_IDLE_TIMEOUT = 0; //Linked to the read of the next message of a keep-alive connection, or on its own if it is multiplexed. Always has a connection address.
+const uint64_t URING_READ = 1;
+const uint64_t URING_TIMEOUT = 2;
+const uint64_t URING_POLL = 3;
+const uint64_t URING_WRITE = 4;
+const uint64_t URING_CANCEL = 5;
+const uint64_t URING_ACCEPT = 6;
+const uint64_t URING_PIPE = 7;
+const uint64_t URING_REQUEST_TIMEOUT = 8; //The sleep of a request of a multiplexed connection. Always has the address of a 'UringRequest'.
+const uint64_t URING_OPERATION_MASK = 15;
+
+const unsigned URING_ENTRIES = 1024;
+const size_t URING_MAX_REGISTERED_BUFFERS = 1024;
+
+}
+
 const std::chrono::milliseconds Server::MAX_TIME_TO_WAIT_FOR_CLIENTS_TO_FINISH = std::chrono::milliseconds(2000);
 
-Server::Server(size_t maxClients) 
-: maxNumberClients_(maxClients)
+Server::Server(size_t maxClients, const ServerOptions& options)
+: options_(options)
+, maxNumberClients_(maxClients)
 , currentNumberClients_(0)
-, serverSocketDescriptor_(-1)
-, isRunning_(false)
+, limiter_(maxClients, options.concurrencyLimit)
+, sourceLimiter_(options.sourceLimit)
+, topClients_(options.topClients)
+, numberRunningAcceptors_(0)
+, numberWaitingClients_(0)
+, numberDroppedClients_(0)
 , quitSignal_(true)
 {
 }
 
-void Server::closeClientAndNotify(int socketClientDescriptor)
+void Server::closeClientAndNotify(Acceptor& acceptor, int socketClientDescriptor)
 {
     std::scoped_lock lock(mutex_);
+    acceptor.bulkClients.erase(socketClientDescriptor);
+    sourceLimiter_.release(socketClientDescriptor);
     close(socketClientDescriptor);
     currentNumberClients_--;
+    acceptor.numberClients--;
     clientsCV_.notify_all();
 }
 
-bool Server::sleep(int socketClientDescriptor, char clientBuffer[BUFFER_SIZE])
+void Server::runClient(Acceptor& acceptor, int socketClientDescriptor)
 {
-    int sleepingTime = atoi(clientBuffer);
-    std::chrono::microseconds selectTimeOut(sleepingTime * 1000);
-    fd_set readFds;
-    FD_ZERO(&readFds);
-    FD_SET(socketClientDescriptor, &readFds);
-    FD_SET(pipeDescriptors_[0], &readFds);
-
-    SelectResult result = Common::doSelect((pipeDescriptors_[0] > socketClientDescriptor ? pipeDescriptors_[0] : socketClientDescriptor) + 1, &readFds, nullptr, &selectTimeOut, "Server:");
-    if (result == SelectResult::TIMEOUT)
+    //The thread of the client that frees the slot serves the next waiting client, so no hand-off is needed.
+    while (socketClientDescriptor != -1)
     {
-        strcpy(clientBuffer, std::to_string(++sleepingTime).c_str());
-        return false;
+        serveConnection(socketClientDescriptor);
+        closeClientAndNotify(acceptor, socketClientDescriptor);
+        socketClientDescriptor = admitWaitingClient(acceptor);
     }
+}
 
-    if (result == SelectResult::ERROR)
+void Server::serveConnection(int socketClientDescriptor)
+{
+    struct SleepingRequest
     {
-        Log::logError("Server::sleep - Select call failed.");
-        return true;
-    }
+        std::chrono::steady_clock::time_point expiration;
+        long sleepingTime;
+        uint32_t requestId;
+        FrameFormat format;
 
-    if (FD_ISSET(pipeDescriptors_[0], &readFds))
-    {
-        Log::logVerbose("Server::sleep - stop was called while sleeping.");
-        return true;
-    }
+        bool operator>(const SleepingRequest& other) const
+        {
+            return expiration > other.expiration;
+        }
+    };
 
-    if (!FD_ISSET(socketClientDescriptor, &readFds))
-    {
-        Log::logError("Server::sleep - select returned with no error, no files ready to be read and before the sleeping time!!!");
-        return true;
-    }
+    std::priority_queue<SleepingRequest, std::vector<SleepingRequest>, std::greater<SleepingRequest> > sleepingRequests;
+    char clientBuffer[BUFFER_SIZE];
+    size_t bufferPosition = 0;
+    bool multiplexed = false;
+    bool answered = false;
+    std::chrono::steady_clock::time_point idleSince = std::chrono::steady_clock::now();
+    uint32_t address = topClients_.isEnabled() ? getClientAddress(socketClientDescriptor) : 0;
+    std::chrono::microseconds cpuTime = getThreadCpuTime(); //The thread only serves this client, so all its CPU time is charged to it.
 
-    //Let's check if the remote peer closed the connection
-    int bytesAvailable;
-    if (ioctl(socketClientDescriptor, FIONREAD, &bytesAvailable) == -1)
+    while (true)
     {
-        int errorNumber = errno;
-        Log::logError("Server::sleep - ioctel failed when checking if the remote peer closed the connection", errorNumber);
-        return true;
-    }
+        bool persistent = multiplexed || options_.keepAliveTimeOut.count() > 0;
+        if (answered && sleepingRequests.empty() && bufferPosition == 0 && !persistent)
+        {
+            return;
+        }
 
-    if (bytesAvailable == 0) //The remote peer closed the connection.
-    {
-        Log::logVerbose("Server::sleep - the remote peer closed the connection.");
-    }
+        //Wait for the next message, the expiration of the earliest request or the idle time out, whatever comes first.
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::microseconds selectTimeOut(0);
+        const std::chrono::microseconds* timeOut = nullptr;
+        if (!sleepingRequests.empty())
+        {
+            selectTimeOut = std::max(std::chrono::microseconds(0), std::chrono::ceil<std::chrono::microseconds>(sleepingRequests.top().expiration - now));
+            timeOut = &selectTimeOut;
+        }
+        else if (answered && options_.keepAliveTimeOut.count() > 0)
+        {
+            if (now - idleSince >= options_.keepAliveTimeOut)
+            {
+                Log::logVerbose("Server::serveConnection - The connection was idle for too long.");
+                return;
+            }
+            selectTimeOut = std::chrono::ceil<std::chrono::microseconds>(idleSince + options_.keepAliveTimeOut - now);
+            timeOut = &selectTimeOut;
+        }
 
-    return true;
-}
+        fd_set readFds;
+        FD_ZERO(&readFds);
+        FD_SET(socketClientDescriptor, &readFds);
+        FD_SET(wakeup_.getDescriptor(), &readFds);
 
-void Server::runClient(int socketClientDescriptor)
-{
-    fd_set writeFds;
-    fd_set readFds;
-    char clientBuffer[BUFFER_SIZE];
-    memset(clientBuffer, 0, sizeof(clientBuffer));
+        SelectResult result = Common::doSelect((wakeup_.getDescriptor() > socketClientDescriptor ? wakeup_.getDescriptor() : socketClientDescriptor) + 1, &readFds, nullptr, timeOut, "Server:");
+        if (result == SelectResult::ERROR)
+        {
+            Log::logError("Server::serveConnection - Error in the select operation when waiting for the client messages.");
+            return;
+        }
 
-    FD_ZERO(&readFds);
-    FD_SET(socketClientDescriptor, &readFds);
-    FD_SET(pipeDescriptors_[0], &readFds);
+        if (result == SelectResult::OK && FD_ISSET(wakeup_.getDescriptor(), &readFds))
+        {
+            Log::logVerbose("Server::serveConnection - Socket client closed by self pipe.");
+            return;
+        }
 
-    if (Common::doSelect((pipeDescriptors_[0] > socketClientDescriptor ? pipeDescriptors_[0] : socketClientDescriptor) + 1, &readFds, nullptr, nullptr, "Server:") != SelectResult::OK)
-    {
-        Log::logError("Server::runClient - Error in the select operation when waiting for the client message with the sleeping time.");
-        closeClientAndNotify(socketClientDescriptor);
-        return;
-    }
+        if (result == SelectResult::OK && FD_ISSET(socketClientDescriptor, &readFds))
+        {
+            ssize_t bytes = read(socketClientDescriptor, clientBuffer + bufferPosition, BUFFER_SIZE - bufferPosition);
+            if (bytes == 0)
+            {
+                Log::logVerbose("Server::serveConnection - The remote peer closed the connection.");
+                return;
+            }
 
-    if (FD_ISSET(pipeDescriptors_[0], &readFds))
-    {
-        Log::logVerbose("Server::runClient - Socket client closed by self pipe.");
-        closeClientAndNotify(socketClientDescriptor);
-        return;
-    }
+            if (bytes == -1)
+            {
+                int errorNumber = errno;
+                if (errorNumber != EAGAIN && errorNumber != EWOULDBLOCK)
+                {
+                    Log::logError("Server::serveConnection - Error reading the client message with the sleeping time", errorNumber);
+                    return;
+                }
+            }
+            else
+            {
+                bufferPosition += bytes;
+            }
 
-    if (!FD_ISSET(socketClientDescriptor, &readFds))
-    {
-        Log::logError("Server::runClient - Expected a client file descriptor ready to read operations.");
-        closeClientAndNotify(socketClientDescriptor);
-        return;
-    }
+            //A single read might carry several binary messages, and the beginning of the next one.
+            size_t frameSize = Common::getFrameSize(clientBuffer, bufferPosition);
+            while (frameSize != 0 && bufferPosition >= frameSize)
+            {
+                long sleepingTime;
+                uint32_t requestId;
+                FrameFormat format = Common::getFrameFormat(clientBuffer);
+                if (!Common::decodeFrame(clientBuffer, sleepingTime, requestId))
+                {
+                    Log::logError("Server::serveConnection - Malformed client message.");
+                    return;
+                }
+                recordLoad(ClientLoad{address, 1, static_cast<uint64_t>(std::max(0L, sleepingTime)), frameSize});
 
-    if (!Common::readMessage(socketClientDescriptor, clientBuffer, "Server:"))
-    {
-        Log::logError("Server::runClient - Error reading the client message with the sleeping time.");
-        closeClientAndNotify(socketClientDescriptor);
-        return;
-    }
+                if (!multiplexed && requestId != NO_REQUEST_ID)
+                {
+                    multiplexed = true;
+                    Common::setNoDelay(socketClientDescriptor, "Server:");
+                }
+                sleepingRequests.push(SleepingRequest{std::chrono::steady_clock::now() + std::chrono::milliseconds(sleepingTime), sleepingTime, requestId, format});
+                bufferPosition -= frameSize;
+                memmove(clientBuffer, clientBuffer + frameSize, bufferPosition);
+                frameSize = Common::getFrameSize(clientBuffer, bufferPosition);
+            }
 
-    if (sleep(socketClientDescriptor, clientBuffer))
-    {
-        Log::logVerbose("Server::runClient - Client will be closed after the sleeping time. No writing back to them.");
-        closeClientAndNotify(socketClientDescriptor);
-        return;
+            //Otherwise, the next read would get no room and return 0, as if the remote peer had closed the connection.
+            if (bufferPosition == BUFFER_SIZE)
+            {
+                Log::logError("Server::serveConnection - Malformed client message, which does not fit in the buffer.");
+                return;
+            }
+        }
+
+        now = std::chrono::steady_clock::now();
+        while (!sleepingRequests.empty() && sleepingRequests.top().expiration <= now)
+        {
+            SleepingRequest request = sleepingRequests.top();
+            sleepingRequests.pop();
+            size_t responseSize;
+            if (!writeResponse(socketClientDescriptor, request.format, request.sleepingTime, request.requestId, responseSize))
+            {
+                return;
+            }
+            recordLateness(request.expiration);
+
+            std::chrono::microseconds usedCpuTime = getThreadCpuTime();
+            recordLoad(ClientLoad{address, 0, 0, responseSize, usedCpuTime - cpuTime});
+            cpuTime = usedCpuTime;
+            answered = true;
+            idleSince = std::chrono::steady_clock::now();
+        }
     }
+}
 
+bool Server::writeResponse(int socketClientDescriptor, FrameFormat format, long sleepingTime, uint32_t requestId, size_t& responseSize)
+{
+    fd_set writeFds;
     FD_ZERO(&writeFds);
     FD_SET(socketClientDescriptor, &writeFds);
 
     if (Common::doSelect(socketClientDescriptor + 1, nullptr, &writeFds, nullptr, "Server:") != SelectResult::OK)
     {
-        Log::logError("Server::runClient - Error in the select operation when writing the increased sleeping time to the client.");
-        closeClientAndNotify(socketClientDescriptor);
-        return;
+        Log::logError("Server::writeResponse - Error in the select operation when writing the increased sleeping time to the client.");
+        return false;
     }
 
     if (!FD_ISSET(socketClientDescriptor, &writeFds))
     {
-        Log::logError("Server::runClient - Expected a client file descriptor ready to write operations.");
-        closeClientAndNotify(socketClientDescriptor);
-        return;
+        Log::logError("Server::writeResponse - Expected a client file descriptor ready to write operations.");
+        return false;
     }
 
-    if (!Common::writeMessage(socketClientDescriptor, clientBuffer, "Server:"))
+    char clientBuffer[BUFFER_SIZE];
+    responseSize = Common::encodeFrame(clientBuffer, format, sleepingTime + 1, requestId);
+    if (!Common::writeFrame(socketClientDescriptor, clientBuffer, responseSize, "Server:"))
     {
-        Log::logError("Server::runClient - Error writing to the client message the increased sleeping time.");
+        Log::logError("Server::writeResponse - Error writing to the client message the increased sleeping time.");
+        return false;
     }
-    closeClientAndNotify(socketClientDescriptor);
+    return true;
 }
 
-bool Server::bindAndListen(int port)
+bool Server::bindAndListen(Acceptor& acceptor, int port, bool reusePort)
 {
     struct sockaddr_in socketAddress;
     socketAddress.sin_family = AF_INET;
@@ -153,14 +251,22 @@ bool Server::bindAndListen(int port)
     socketAddress.sin_port = htons(port);
 
     int socketReuseOption = 1;
-    if (setsockopt(serverSocketDescriptor_, SOL_SOCKET, SO_REUSEADDR, &socketReuseOption, sizeof(int)) == -1)
+    if (setsockopt(acceptor.socketDescriptor, SOL_SOCKET, SO_REUSEADDR, &socketReuseOption, sizeof(int)) == -1)
     {
         int errorNumber = errno;
         Log::logError("Server::start - Could not reuse the socket descriptor", errorNumber);
         return false;
     }
 
-    if (::bind(serverSocketDescriptor_, (struct sockaddr*) &socketAddress, sizeof(socketAddress)) == -1)
+    //Every listener bound to the same port with SO_REUSEPORT gets its own accept queue, and the kernel spreads the incoming connections among them.
+    if (reusePort && setsockopt(acceptor.socketDescriptor, SOL_SOCKET, SO_REUSEPORT, &socketReuseOption, sizeof(int)) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError("Server::start - Could not reuse the port", errorNumber);
+        return false;
+    }
+
+    if (::bind(acceptor.socketDescriptor, (struct sockaddr*) &socketAddress, sizeof(socketAddress)) == -1)
     {
         int errorNumber = errno;
         Log::logError("Server::bind - Could not bind to socket address", errorNumber);
@@ -168,7 +274,14 @@ bool Server::bindAndListen(int port)
     }
 
     const int LISTEN_BACKLOG = 550;
-    if (listen(serverSocketDescriptor_, LISTEN_BACKLOG) == -1)
+    //The first message of a client can come in its SYN. Without kernel support, the clients just do the regular handshake.
+    if (options_.fastOpen && setsockopt(acceptor.socketDescriptor, IPPROTO_TCP, TCP_FASTOPEN, &options_.fastOpenQueueLength, sizeof(int)) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError("Server::start - Could not enable TCP Fast Open, so the clients do the regular handshake", errorNumber);
+    }
+
+    if (listen(acceptor.socketDescriptor, LISTEN_BACKLOG) == -1)
     {
         int errorNumber = errno;
         Log::logError("Server::start - Could not listen to socket", errorNumber);
@@ -180,37 +293,140 @@ bool Server::bindAndListen(int port)
 
 bool Server::start(int port)
 {
-    if (!Common::createSocket(serverSocketDescriptor_, SOCK_NONBLOCK, "Server:"))
+    if (!wakeup_.init(options_.wakeup, "Server:"))
     {
         return false;
     }
 
-    if (pipe2(pipeDescriptors_, O_NONBLOCK) == -1)
+    //Each acceptor needs at least one client of the budget.
+    size_t numAcceptors = std::max<size_t>(1, std::min(options_.numAcceptors, maxNumberClients_));
+    bool useUring = options_.mode == ServerMode::IO_URING;
+    if (useUring && !isUringSupported())
     {
-        int errorNumber = errno;
-        Log::logError("Server::Server - Could not create the pipe file descriptors", errorNumber);
-        return false;
+        Log::logError("Server::start - The io_uring operations needed are not supported. Falling back to one thread per client.");
+        useUring = false;
     }
 
-    if (!bindAndListen(port))
+    for (size_t i = 0; i < numAcceptors; i++)
     {
-        return false;
+        std::unique_ptr<Acceptor> acceptor(new Acceptor());
+        acceptor->maxNumberClients = maxNumberClients_ / numAcceptors + (i < maxNumberClients_ % numAcceptors ? 1 : 0);
+        acceptor->numberClients = 0;
+        acceptor->listenerPaused = false;
+        acceptor->uringAcceptArmed = false;
+        acceptor->uringQuitting = false;
+        if (options_.admission == AdmissionPolicy::QUEUE)
+        {
+            size_t capacity = options_.waitingQueue.capacity ? options_.waitingQueue.capacity : acceptor->maxNumberClients;
+            acceptor->waitingClients.reset(new WaitingQueue(capacity, options_.waitingQueue, &Server::peekFirstRequest));
+        }
+        if (!Common::createSocket(acceptor->socketDescriptor, SOCK_NONBLOCK, "Server:"))
+        {
+            closeAcceptors();
+            return false;
+        }
+        acceptors_.push_back(std::move(acceptor));
+
+        if (!bindAndListen(*acceptors_.back(), port, numAcceptors > 1))
+        {
+            closeAcceptors();
+            return false;
+        }
+
+        //The loops are created here rather than by the thread of the acceptor, so they are ready once 'start' returns.
+        bool initialised = true;
+        if (options_.mode == ServerMode::REACTOR)
+        {
+            initialised = initReactor(*acceptors_.back());
+        }
+        else if (options_.mode == ServerMode::COROUTINE)
+        {
+            initialised = acceptors_.back()->scheduler.init(wakeup_.getDescriptor(), "Server:");
+        }
+
+        if (!initialised)
+        {
+            Log::logError("Server::start - Could not initialise the event loop of an acceptor.");
+            closeAcceptors();
+            return false;
+        }
+
+        if (useUring)
+        {
+            acceptors_.back()->ring.reset(new IoUring());
+            if (!acceptors_.back()->ring->init(URING_ENTRIES, "Server:"))
+            {
+                Log::logError("Server::start - io_uring is not available. Falling back to one thread per client.");
+                useUring = false;
+            }
+        }
+    }
+
+    if (options_.mode == ServerMode::IO_URING && !useUring)
+    {
+        for (auto& acceptor : acceptors_)
+        {
+            acceptor->ring.reset();
+        }
+    }
+
+    if (options_.mode == ServerMode::WORKER_POOL)
+    {
+        size_t numWorkers = options_.numWorkers ? options_.numWorkers : maxNumberClients_;
+        size_t queueCapacity = options_.workerQueueCapacity ? options_.workerQueueCapacity : maxNumberClients_;
+        workerPool_.reset(new ThreadPool(numWorkers, queueCapacity));
+        workerPool_->start();
     }
 
-    isRunning_ = true;
+    numberRunningAcceptors_ = acceptors_.size();
     quitSignal_ = false;
-    serverThread_ = std::thread(&Server::run, this);
+    for (auto& acceptor : acceptors_)
+    {
+        if (useUring)
+        {
+            acceptor->thread = std::thread(&Server::runUring, this, std::ref(*acceptor));
+        }
+        else
+        {
+            void (Server::*runMethod)(Acceptor&) = &Server::run;
+            if (options_.mode == ServerMode::REACTOR)
+            {
+                runMethod = &Server::runReactor;
+            }
+            else if (options_.mode == ServerMode::COROUTINE)
+            {
+                runMethod = &Server::runCoroutines;
+            }
+            acceptor->thread = std::thread(runMethod, this, std::ref(*acceptor));
+        }
+    }
     return true;
 }
 
+void Server::closeAcceptors()
+{
+    for (auto& acceptor : acceptors_)
+    {
+        close(acceptor->socketDescriptor);
+    }
+    acceptors_.clear();
+}
+
 void Server::stop()
 {
     quitRunningThread();
     waitForRunningThread();
-    serverThread_.join();
-    close(serverSocketDescriptor_);
-    close(pipeDescriptors_[0]);
-    close(pipeDescriptors_[1]);
+    for (auto& acceptor : acceptors_)
+    {
+        acceptor->thread.join();
+    }
+    closeAcceptors();
+    if (workerPool_)
+    {
+        workerPool_->stop();
+        workerPool_.reset();
+    }
+    wakeup_.release();
 }
 
 void Server::waitForRunningThread()
@@ -218,33 +434,33 @@ void Server::waitForRunningThread()
     std::unique_lock < std::mutex > lock(mutex_);
     auto quitPredicate = [this]()
     {
-        return !isRunning_;
+        return numberRunningAcceptors_ == 0;
     };
 
     if (!clientsCV_.wait_for(lock, MAX_TIME_TO_WAIT_FOR_CLIENTS_TO_FINISH, quitPredicate))
     {
-        Log::logError("Server::stop - Time out expired when waiting for the running thread to finish!!!");
+        Log::logError("Server::stop - Time out expired when waiting for the running threads to finish!!!");
     }
     else
     {
-        Common::consumePipe(pipeDescriptors_[0], "Server:");
+        wakeup_.consume();
     }
 }
 
 void Server::quitRunningThread()
 {
     std::scoped_lock lock(mutex_);
-    write(pipeDescriptors_[1], "0", 1);
+    wakeup_.notify();
     quitSignal_ = true;
     clientsCV_.notify_all();
 }
 
-bool Server::doAccept()
+bool Server::doAccept(Acceptor& acceptor)
 {
     struct sockaddr_in clientAddress;
     int sizeofSockAddr = sizeof(struct sockaddr_in);
 
-    int socketClientDescriptor = accept4(serverSocketDescriptor_, (struct sockaddr*) &clientAddress, (socklen_t*) &sizeofSockAddr, SOCK_NONBLOCK);
+    int socketClientDescriptor = accept4(acceptor.socketDescriptor, (struct sockaddr*) &clientAddress, (socklen_t*) &sizeofSockAddr, SOCK_NONBLOCK);
     if (socketClientDescriptor == -1)
     {
         int errorNumber = errno;
@@ -253,99 +469,1656 @@ bool Server::doAccept()
             Log::logError("Server::doAccept - The system reached the maximum number of open files."); 
             return true; //This client is not attended, but the server is kept alive
         }
+        if (errorNumber == EAGAIN || errorNumber == EWOULDBLOCK)
+        {
+            return true; //Another acceptor took the connection first.
+        }
         Log::logError("Server::doAccept - Could not accept on the socket descriptor", errorNumber);
         return false;
     }
 
-    if (checkForMaximumNumberClients())
+    if (!admitSource(socketClientDescriptor, &clientAddress))
+    {
+        return true;
+    }
+
+    if (options_.admission == AdmissionPolicy::QUEUE && queueClient(acceptor, socketClientDescriptor))
+    {
+        return true;
+    }
+
+    if (options_.admission == AdmissionPolicy::REJECT && isAcceptorFull(acceptor))
+    {
+        rejectClient(socketClientDescriptor);
+        return true;
+    }
+
+    if (checkForMaximumNumberClients(acceptor))
     {
         Log::logVerbose("Server::doAccept - Quit signal was raised while waiting for the current number of clients to decrease.");
+        sourceLimiter_.release(socketClientDescriptor);
+        close(socketClientDescriptor);
         return false;
     }
 
     std::scoped_lock lock(mutex_);
+    if (workerPool_)
+    {
+        Acceptor* acceptorPtr = &acceptor;
+        if (!workerPool_->submit([this, acceptorPtr, socketClientDescriptor]()
+        {
+            runClient(*acceptorPtr, socketClientDescriptor);
+        }))
+        {
+            Log::logError("Server::doAccept - The queue of clients waiting for a free worker is full.");
+            acceptor.bulkClients.erase(socketClientDescriptor);
+            sourceLimiter_.release(socketClientDescriptor);
+            close(socketClientDescriptor);
+            return true; //This client is not attended, but the server is kept alive
+        }
+        currentNumberClients_++;
+        acceptor.numberClients++;
+        return true;
+    }
+
     currentNumberClients_++;
-    std::thread(&Server::runClient, this, socketClientDescriptor).detach();
+    acceptor.numberClients++;
+    std::thread(&Server::runClient, this, std::ref(acceptor), socketClientDescriptor).detach();
     return true;
 }
 
-bool Server::checkForMaximumNumberClients()
+bool Server::checkForMaximumNumberClients(Acceptor& acceptor)
 {
     std::unique_lock < std::mutex > lock(mutex_);
-    if (currentNumberClients_ >= maxNumberClients_)
+    if (acceptor.numberClients >= getAcceptorLimit(acceptor))
     {
-        Log::logVerbose("Server::checkForMaximumNumberClients - The maximum number of clients has been reached. Waiting until one client finishes.");
-        if (currentNumberClients_ > maxNumberClients_)
+        Log::logVerbose("Server::checkForMaximumNumberClients - The concurrency limit of this acceptor has been reached. Waiting until one client finishes.");
+        if (acceptor.numberClients > acceptor.maxNumberClients)
         {
             Log::logError("Server::checkForMaximumNumberClients - The current number of clients is way beyond the maximum number allowed. This should never happen!!!");
         }
     
-        clientsCV_.wait(lock, [this]()
+        //Either a client finishes or the limit grows.
+        clientsCV_.wait(lock, [this, &acceptor]()
         {
-            return (currentNumberClients_ < maxNumberClients_) || quitSignal_;
+            return (acceptor.numberClients < getAcceptorLimit(acceptor)) || quitSignal_;
         });
     }
 
     return quitSignal_;
 }
 
-void Server::waitForClientsToFinish()
+bool Server::admitSource(int socketClientDescriptor, const struct sockaddr_in* clientAddress)
 {
-    std::unique_lock <std::mutex> lock(mutex_);
-    auto clientsToFinishPredicate = [this]()
+    if (!sourceLimiter_.isEnabled())
     {
-        return currentNumberClients_ == 0;
-    };
+        return true;
+    }
 
-    if(currentNumberClients_ == 0)
+    uint32_t address = clientAddress ? clientAddress->sin_addr.s_addr : getClientAddress(socketClientDescriptor);
+    if (sourceLimiter_.acquire(socketClientDescriptor, address, SourceLimiter::Clock::now()))
     {
-        Log::logVerbose("Server::waitForClientsToFinish - No clients connected.");
+        return true;
     }
-    else if(!clientsCV_.wait_for(lock, MAX_TIME_TO_WAIT_FOR_CLIENTS_TO_FINISH, clientsToFinishPredicate))
+
+    Log::logVerbose("Server::admitSource - The source address of the client is over its limits.");
+    rejectClient(socketClientDescriptor);
+    return false;
+}
+
+void Server::rejectClient(int socketClientDescriptor)
+{
+    Log::logVerbose("Server::rejectClient - Rejecting the client with a busy message.");
+    char message[BUFFER_SIZE];
+    size_t messageSize = Common::encodeBusyFrame(message, options_.retryAfter);
+    if (send(socketClientDescriptor, message, messageSize, MSG_NOSIGNAL | MSG_DONTWAIT) == -1)
     {
-        Log::logError("Server::waitForClientsToFinish  - Time out expired when waiting for all the clients to finish. There are still some clients connected!!!");
+        int errorNumber = errno;
+        Log::logError("Server::rejectClient - Could not send the busy message", errorNumber);
     }
 
-    isRunning_ = false;
-    clientsCV_.notify_all();
+    //Closing a socket with unread data resets the connection, so the request already received is read first.
+    while (recv(socketClientDescriptor, message, BUFFER_SIZE, MSG_DONTWAIT) > 0)
+    {
+    }
+    sourceLimiter_.release(socketClientDescriptor);
+    close(socketClientDescriptor);
 }
 
-void Server::run()
+bool Server::queueClient(Acceptor& acceptor, int socketClientDescriptor)
 {
-    bool quit = false;
-    while (!quit)
-    {
-        fd_set readFds;
-        FD_ZERO(&readFds);
-        FD_SET(serverSocketDescriptor_, &readFds);
-        FD_SET(pipeDescriptors_[0], &readFds);
+    //The accept loop never waits for the first request: until it arrives, the client counts as 'Priority::NORMAL' for its admission,
+    //and if it is queued, the queue classifies it once it is readable.
+    Priority priority = Priority::NORMAL;
+    std::chrono::milliseconds deadline;
+    peekFirstRequest(socketClientDescriptor, priority, deadline);
 
-        if (Common::doSelect((pipeDescriptors_[0] > serverSocketDescriptor_ ? pipeDescriptors_[0] : serverSocketDescriptor_) + 1, &readFds, nullptr, nullptr, "Server:") != SelectResult::OK)
+    std::vector<int> droppedClients;
+    {
+        std::scoped_lock lock(mutex_);
+        if (acceptor.numberClients < getAcceptorLimit(acceptor) && (priority != Priority::BULK || isBulkAllowed(acceptor)))
         {
-            quit = true;
+            if (priority == Priority::BULK)
+            {
+                acceptor.bulkClients.insert(socketClientDescriptor);
+            }
+            return false;
         }
-        else if (FD_ISSET(pipeDescriptors_[0], &readFds))
+
+        WaitingQueue& waitingClients = *acceptor.waitingClients;
+        WaitingQueue::Clock::time_point now = WaitingQueue::Clock::now();
+        size_t previousSize = waitingClients.getSize();
+        waitingClients.drop(now, droppedClients);
+        if (!waitingClients.push(socketClientDescriptor, now))
         {
-            Log::logVerbose("Server::run - Quitting server main loop by the self pipe trick.");
-            quit = true;
+            Log::logVerbose("Server::queueClient - The queue of waiting clients is full.");
+            droppedClients.push_back(socketClientDescriptor);
         }
-        else if (FD_ISSET(serverSocketDescriptor_, &readFds))
+        numberWaitingClients_ = numberWaitingClients_ + waitingClients.getSize() - previousSize;
+        numberDroppedClients_ += droppedClients.size();
+    }
+
+    rejectClients(droppedClients);
+    return true;
+}
+
+int Server::admitWaitingClient(Acceptor& acceptor)
+{
+    if (!acceptor.waitingClients)
+    {
+        return -1;
+    }
+
+    int socketClientDescriptor = -1;
+    std::vector<int> droppedClients;
+    {
+        std::scoped_lock lock(mutex_);
+        WaitingQueue& waitingClients = *acceptor.waitingClients;
+        size_t previousSize = waitingClients.getSize();
+        Priority priority;
+        if (!quitSignal_ && acceptor.numberClients < getAcceptorLimit(acceptor)
+            && waitingClients.pop(socketClientDescriptor, priority, WaitingQueue::Clock::now(), droppedClients, isBulkAllowed(acceptor) ? Priority::BULK : Priority::NORMAL))
         {
-            if (!doAccept())
+            currentNumberClients_++;
+            acceptor.numberClients++;
+            if (priority == Priority::BULK)
             {
-                quit = true;
+                acceptor.bulkClients.insert(socketClientDescriptor);
             }
         }
+        numberWaitingClients_ = numberWaitingClients_ + waitingClients.getSize() - previousSize;
+        numberDroppedClients_ += droppedClients.size();
     }
 
-    quitRunningThread();
-    waitForClientsToFinish();
+    rejectClients(droppedClients);
+    return socketClientDescriptor;
 }
 
-size_t Server::getNumberOfClients() const
+bool Server::peekFirstRequest(int socketClientDescriptor, Priority& priority, std::chrono::milliseconds& deadline)
+{
+    char buffer[BUFFER_SIZE];
+    ssize_t bytes = recv(socketClientDescriptor, buffer, BUFFER_SIZE, MSG_PEEK | MSG_DONTWAIT);
+    if (bytes <= 0)
+    {
+        return false;
+    }
+
+    size_t frameSize = Common::getFrameSize(buffer, bytes);
+    if (frameSize == 0 || static_cast<size_t>(bytes) < frameSize)
+    {
+        return false;
+    }
+
+    long delay;
+    uint32_t requestId;
+    if (!Common::decodeFrame(buffer, delay, requestId, priority, deadline))
+    {
+        priority = Priority::NORMAL; //The malformed request is reported once the client is served.
+        deadline = std::chrono::milliseconds(0);
+    }
+    return true;
+}
+
+bool Server::isBulkAllowed(const Acceptor& acceptor) const
+{
+    size_t share = static_cast<size_t>(getAcceptorLimit(acceptor) * std::clamp(options_.bulkShare, 0.0, 1.0));
+    return acceptor.bulkClients.size() < std::max<size_t>(1, share);
+}
+
+void Server::rejectClients(const std::vector<int>& socketClientDescriptors)
+{
+    for (int socketClientDescriptor : socketClientDescriptors)
+    {
+        rejectClient(socketClientDescriptor);
+    }
+}
+
+void Server::closeWaitingClients(Acceptor& acceptor)
+{
+    if (!acceptor.waitingClients)
+    {
+        return;
+    }
+
+    std::vector<int> waitingClients;
+    {
+        std::scoped_lock lock(mutex_);
+        acceptor.waitingClients->clear(waitingClients);
+        numberWaitingClients_ -= waitingClients.size();
+    }
+
+    for (int socketClientDescriptor : waitingClients)
+    {
+        sourceLimiter_.release(socketClientDescriptor);
+        close(socketClientDescriptor);
+    }
+}
+
+bool Server::isAcceptorFull(const Acceptor& acceptor) const
 {
     std::scoped_lock lock(mutex_);
-    return currentNumberClients_;
+    return acceptor.numberClients >= getAcceptorLimit(acceptor);
+}
+
+size_t Server::getAcceptorLimit(const Acceptor& acceptor) const
+{
+    //Rounded up, so the shares of all the acceptors add up to at least the limit.
+    size_t limit = limiter_.getLimit();
+    return std::max<size_t>(1, (acceptor.maxNumberClients * limit + maxNumberClients_ - 1) / std::max<size_t>(1, maxNumberClients_));
+}
+
+void Server::recordLateness(const std::chrono::steady_clock::time_point& expiration)
+{
+    if (options_.concurrencyLimit.algorithm == LimitAlgorithm::FIXED)
+    {
+        return;
+    }
+
+    std::chrono::microseconds lateness = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - expiration);
+    std::scoped_lock lock(mutex_);
+    size_t previousLimit = limiter_.getLimit();
+    limiter_.onSample(lateness, currentNumberClients_);
+    if (limiter_.getLimit() > previousLimit)
+    {
+        clientsCV_.notify_all();
+    }
+}
+
+void Server::recordLoad(const ClientLoad& load)
+{
+    topClients_.add(load);
+}
+
+uint32_t Server::getClientAddress(int socketClientDescriptor)
+{
+    struct sockaddr_in clientAddress;
+    memset(&clientAddress, 0, sizeof(clientAddress));
+    socklen_t sizeofSockAddr = sizeof(struct sockaddr_in);
+    if (getpeername(socketClientDescriptor, (struct sockaddr*) &clientAddress, &sizeofSockAddr) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError("Server::getClientAddress - Could not get the address of the client", errorNumber);
+        return 0;
+    }
+    return clientAddress.sin_addr.s_addr;
+}
+
+std::chrono::microseconds Server::getThreadCpuTime() const
+{
+    struct timespec cpuTime;
+    if (!topClients_.isEnabled() || clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime) == -1)
+    {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::seconds(cpuTime.tv_sec) + std::chrono::nanoseconds(cpuTime.tv_nsec));
+}
+
+void Server::waitForClientsToFinish(Acceptor& acceptor)
+{
+    std::unique_lock <std::mutex> lock(mutex_);
+    auto clientsToFinishPredicate = [&acceptor]()
+    {
+        return acceptor.numberClients == 0;
+    };
+
+    if(acceptor.numberClients == 0)
+    {
+        Log::logVerbose("Server::waitForClientsToFinish - No clients connected.");
+    }
+    else if(!clientsCV_.wait_for(lock, MAX_TIME_TO_WAIT_FOR_CLIENTS_TO_FINISH, clientsToFinishPredicate))
+    {
+        Log::logError("Server::waitForClientsToFinish  - Time out expired when waiting for all the clients to finish. There are still some clients connected!!!");
+    }
+
+    numberRunningAcceptors_--;
+    clientsCV_.notify_all();
+}
+
+void Server::run(Acceptor& acceptor)
+{
+    bool quit = false;
+    while (!quit)
+    {
+        //The listener is not watched while the acceptor is full, and the new clients wait in the backlog.
+        if (options_.admission == AdmissionPolicy::PAUSE && checkForMaximumNumberClients(acceptor))
+        {
+            break;
+        }
+
+        fd_set readFds;
+        FD_ZERO(&readFds);
+        FD_SET(acceptor.socketDescriptor, &readFds);
+        FD_SET(wakeup_.getDescriptor(), &readFds);
+
+        if (Common::doSelect((wakeup_.getDescriptor() > acceptor.socketDescriptor ? wakeup_.getDescriptor() : acceptor.socketDescriptor) + 1, &readFds, nullptr, nullptr, "Server:") != SelectResult::OK)
+        {
+            quit = true;
+        }
+        else if (FD_ISSET(wakeup_.getDescriptor(), &readFds))
+        {
+            Log::logVerbose("Server::run - Quitting server main loop by the self pipe trick.");
+            quit = true;
+        }
+        else if (FD_ISSET(acceptor.socketDescriptor, &readFds))
+        {
+            if (!doAccept(acceptor))
+            {
+                quit = true;
+            }
+        }
+    }
+
+    quitRunningThread();
+    closeWaitingClients(acceptor);
+    waitForClientsToFinish(acceptor);
+}
+
+size_t Server::getNumberOfClients() const
+{
+    std::scoped_lock lock(mutex_);
+    return currentNumberClients_;
+}
+
+size_t Server::getConcurrencyLimit() const
+{
+    std::scoped_lock lock(mutex_);
+    return limiter_.getLimit();
+}
+
+size_t Server::getNumberOfWaitingClients() const
+{
+    std::scoped_lock lock(mutex_);
+    return numberWaitingClients_;
+}
+
+size_t Server::getNumberOfDroppedClients() const
+{
+    std::scoped_lock lock(mutex_);
+    return numberDroppedClients_;
+}
+
+size_t Server::getNumberOfThrottledClients() const
+{
+    return sourceLimiter_.getNumberOfRejections();
+}
+
+size_t Server::getNumberOfDroppedSources() const
+{
+    return sourceLimiter_.getNumberOfDroppedSources();
+}
+
+std::vector<ClientLoad> Server::getTopClients(size_t count) const
+{
+    return topClients_.getTop(count);
+}
+
+bool Server::initReactor(Acceptor& acceptor)
+{
+    bool initialised = acceptor.loop.init("Server:");
+
+    initialised = initialised && acceptor.loop.add(wakeup_.getDescriptor(), EPOLLIN, [&acceptor](uint32_t)
+    {
+        Log::logVerbose("Server::runReactor - Quitting reactor loop by the self pipe trick.");
+        acceptor.loop.quit();
+    });
+
+    return initialised && acceptor.loop.add(acceptor.socketDescriptor, EPOLLIN, [this, &acceptor](uint32_t)
+    {
+        if (!acceptReactorClients(acceptor))
+        {
+            acceptor.loop.quit();
+        }
+    });
+}
+
+void Server::runReactor(Acceptor& acceptor)
+{
+    acceptor.listenerPaused = false;
+    acceptor.loop.run();
+
+    closeWaitingClients(acceptor);
+    while (!acceptor.connections.empty())
+    {
+        closeReactorClient(acceptor, *acceptor.connections.begin()->second);
+    }
+
+    quitRunningThread();
+    waitForClientsToFinish(acceptor);
+}
+
+bool Server::acceptReactorClients(Acceptor& acceptor)
+{
+    while (true)
+    {
+        bool full;
+        {
+            std::scoped_lock lock(mutex_);
+            full = acceptor.numberClients >= getAcceptorLimit(acceptor);
+            if (full && options_.admission != AdmissionPolicy::REJECT && options_.admission != AdmissionPolicy::QUEUE)
+            {
+                Log::logVerbose("Server::acceptReactorClients - The concurrency limit of this acceptor has been reached. Not watching the listener until one client finishes.");
+                acceptor.listenerPaused = acceptor.loop.modify(acceptor.socketDescriptor, 0);
+                return true;
+            }
+        }
+
+        struct sockaddr_in clientAddress;
+        socklen_t sizeofSockAddr = sizeof(struct sockaddr_in);
+        int socketClientDescriptor = accept4(acceptor.socketDescriptor, (struct sockaddr*) &clientAddress, &sizeofSockAddr, SOCK_NONBLOCK);
+        if (socketClientDescriptor == -1)
+        {
+            int errorNumber = errno;
+            if (errorNumber == EAGAIN || errorNumber == EWOULDBLOCK)
+            {
+                return true;
+            }
+
+            if (errorNumber == EMFILE)
+            {
+                Log::logError("Server::acceptReactorClients - The system reached the maximum number of open files.");
+                return true; //This client is not attended, but the server is kept alive
+            }
+            Log::logError("Server::acceptReactorClients - Could not accept on the socket descriptor", errorNumber);
+            return false;
+        }
+
+        if (!admitSource(socketClientDescriptor, &clientAddress))
+        {
+            continue;
+        }
+
+        if (options_.admission == AdmissionPolicy::QUEUE && queueClient(acceptor, socketClientDescriptor))
+        {
+            continue;
+        }
+
+        if (full && options_.admission == AdmissionPolicy::REJECT)
+        {
+            rejectClient(socketClientDescriptor);
+            continue;
+        }
+
+        {
+            std::scoped_lock lock(mutex_);
+            currentNumberClients_++;
+            acceptor.numberClients++;
+        }
+        startReactorClient(acceptor, socketClientDescriptor);
+    }
+}
+
+void Server::startReactorClient(Acceptor& acceptor, int socketClientDescriptor)
+{
+    uint32_t address = topClients_.isEnabled() ? getClientAddress(socketClientDescriptor) : 0;
+    std::unique_ptr<Connection> connection(new Connection{socketClientDescriptor, 0, nullptr, 0, {}, {}, 0, false, false, false, address, EventLoop::INVALID_TIMER});
+    Connection* connectionPtr = connection.get();
+    if (!acceptor.loop.add(socketClientDescriptor, EPOLLIN | EPOLLRDHUP, [this, &acceptor, connectionPtr, address](uint32_t events)
+    {
+        //The loop serves all the clients of the acceptor, so only the CPU time of this event is charged to the client.
+        std::chrono::microseconds cpuTime = getThreadCpuTime();
+        onReactorClientEvent(acceptor, *connectionPtr, events);
+        recordLoad(ClientLoad{address, 0, 0, 0, getThreadCpuTime() - cpuTime});
+    }))
+    {
+        closeClientAndNotify(acceptor, socketClientDescriptor);
+        return;
+    }
+
+    acceptor.connections[socketClientDescriptor] = std::move(connection);
+}
+
+void Server::onReactorClientEvent(Acceptor& acceptor, Connection& connection, uint32_t events)
+{
+    if (events & EPOLLERR)
+    {
+        Log::logError("Server::onReactorClientEvent - Error in the client socket.");
+        closeReactorClient(acceptor, connection);
+        return;
+    }
+
+    if ((events & EPOLLOUT) && !writeReactorClient(acceptor, connection))
+    {
+        return;
+    }
+
+    //The remote peer closing the connection, even while sleeping, is detected by the read returning 0.
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+    {
+        readReactorClient(acceptor, connection);
+    }
+}
+
+bool Server::readReactorClient(Acceptor& acceptor, Connection& connection)
+{
+    //A keep-alive connection is not idle anymore once the next message starts arriving.
+    acceptor.loop.cancelTimer(connection.idleTimer);
+    connection.idleTimer = EventLoop::INVALID_TIMER;
+
+    if (!connection.buffer)
+    {
+        connection.buffer.reset(new char[BUFFER_SIZE]);
+        connection.bufferPosition = 0;
+    }
+
+    ssize_t bytes = read(connection.socketDescriptor, connection.buffer.get() + connection.bufferPosition, BUFFER_SIZE - connection.bufferPosition);
+    if (bytes == 0)
+    {
+        Log::logVerbose("Server::readReactorClient - The remote peer closed the connection.");
+        closeReactorClient(acceptor, connection);
+        return false;
+    }
+
+    if (bytes == -1)
+    {
+        int errorNumber = errno;
+        if (errorNumber != EAGAIN && errorNumber != EWOULDBLOCK)
+        {
+            Log::logError("Server::readReactorClient - Error reading the client message with the sleeping time", errorNumber);
+            closeReactorClient(acceptor, connection);
+            return false;
+        }
+        return true;
+    }
+
+    connection.bufferPosition += bytes;
+
+    //A single read might carry several binary messages, and the beginning of the next one.
+    int socketClientDescriptor = connection.socketDescriptor;
+    size_t frameSize = Common::getFrameSize(connection.buffer.get(), connection.bufferPosition);
+    while (frameSize != 0 && connection.bufferPosition >= frameSize)
+    {
+        long sleepingTime;
+        uint32_t requestId;
+        FrameFormat format = Common::getFrameFormat(connection.buffer.get());
+        if (!Common::decodeFrame(connection.buffer.get(), sleepingTime, requestId))
+        {
+            Log::logError("Server::readReactorClient - Malformed client message.");
+            closeReactorClient(acceptor, connection);
+            return false;
+        }
+        recordLoad(ClientLoad{connection.address, 1, static_cast<uint64_t>(std::max(0L, sleepingTime)), frameSize});
+        connection.bufferPosition -= frameSize;
+        memmove(connection.buffer.get(), connection.buffer.get() + frameSize, connection.bufferPosition);
+
+        if (!connection.multiplexed && requestId != NO_REQUEST_ID)
+        {
+            connection.multiplexed = true;
+            Common::setNoDelay(connection.socketDescriptor, "Server:");
+        }
+
+        //The timers are rounded up to the next tick, so a request without sleeping time is answered right away instead.
+        if (sleepingTime <= 0)
+        {
+            recordLateness(std::chrono::steady_clock::now());
+            answerReactorClient(acceptor, connection, format, sleepingTime, requestId);
+            if (acceptor.connections.count(socketClientDescriptor) == 0)
+            {
+                return false; //'connection' was closed.
+            }
+        }
+        else
+        {
+            Connection* connectionPtr = &connection;
+            uint64_t request = connection.nextRequest++;
+            std::chrono::steady_clock::time_point expiration = std::chrono::steady_clock::now() + std::chrono::milliseconds(sleepingTime);
+            connection.sleepingRequests[request] = acceptor.loop.addTimer(std::chrono::milliseconds(sleepingTime), [this, &acceptor, connectionPtr, request, format, sleepingTime, requestId, expiration]()
+            {
+                uint32_t address = connectionPtr->address;
+                std::chrono::microseconds cpuTime = getThreadCpuTime();
+                connectionPtr->sleepingRequests.erase(request);
+                recordLateness(expiration);
+                answerReactorClient(acceptor, *connectionPtr, format, sleepingTime, requestId);
+                recordLoad(ClientLoad{address, 0, 0, 0, getThreadCpuTime() - cpuTime});
+            });
+        }
+        frameSize = Common::getFrameSize(connection.buffer.get(), connection.bufferPosition);
+    }
+
+    //Otherwise, the next read would get no room and return 0, as if the remote peer had closed the connection.
+    if (connection.bufferPosition == BUFFER_SIZE)
+    {
+        Log::logError("Server::readReactorClient - Malformed client message, which does not fit in the buffer.");
+        closeReactorClient(acceptor, connection);
+        return false;
+    }
+
+    if (connection.bufferPosition == 0)
+    {
+        connection.buffer.reset();
+
+        //The responses written above while the buffer was still allocated skipped the close and idle checks, so they run again.
+        if (connection.answered && connection.responses.empty())
+        {
+            return writeReactorClient(acceptor, connection);
+        }
+    }
+    return true;
+}
+
+void Server::answerReactorClient(Acceptor& acceptor, Connection& connection, FrameFormat format, long sleepingTime, uint32_t requestId)
+{
+    char response[BUFFER_SIZE];
+    size_t size = Common::encodeFrame(response, format, sleepingTime + 1, requestId);
+    connection.responses.emplace_back(response, size);
+    if (!connection.watchingWrites)
+    {
+        writeReactorClient(acceptor, connection);
+    }
+}
+
+bool Server::writeReactorClient(Acceptor& acceptor, Connection& connection)
+{
+    while (!connection.responses.empty())
+    {
+        const std::string& response = connection.responses.front();
+        while (connection.writePosition < response.size())
+        {
+            ssize_t bytesSent = send(connection.socketDescriptor, response.data() + connection.writePosition, response.size() - connection.writePosition, MSG_NOSIGNAL);
+            if (bytesSent == -1)
+            {
+                int errorNumber = errno;
+                if (errorNumber == EAGAIN || errorNumber == EWOULDBLOCK)
+                {
+                    connection.watchingWrites = connection.watchingWrites || acceptor.loop.modify(connection.socketDescriptor, EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+                    return true;
+                }
+                Log::logError("Server::writeReactorClient - Error writing to the client message the increased sleeping time", errorNumber);
+                closeReactorClient(acceptor, connection);
+                return false;
+            }
+            connection.writePosition += bytesSent;
+        }
+        recordLoad(ClientLoad{connection.address, 0, 0, response.size()});
+        connection.responses.pop_front();
+        connection.writePosition = 0;
+        connection.answered = true;
+    }
+
+    if (connection.watchingWrites)
+    {
+        acceptor.loop.modify(connection.socketDescriptor, EPOLLIN | EPOLLRDHUP);
+        connection.watchingWrites = false;
+    }
+
+    if (!connection.sleepingRequests.empty() || connection.buffer)
+    {
+        return true;
+    }
+
+    if (!connection.multiplexed && options_.keepAliveTimeOut.count() == 0)
+    {
+        closeReactorClient(acceptor, connection);
+        return false;
+    }
+
+    //Wait for the next message, closing the connection if it stays idle for too long.
+    if (options_.keepAliveTimeOut.count() > 0 && connection.idleTimer == EventLoop::INVALID_TIMER)
+    {
+        Connection* connectionPtr = &connection;
+        connection.idleTimer = acceptor.loop.addTimer(options_.keepAliveTimeOut, [this, &acceptor, connectionPtr]()
+        {
+            Log::logVerbose("Server::writeReactorClient - The connection was idle for too long.");
+            connectionPtr->idleTimer = EventLoop::INVALID_TIMER;
+            closeReactorClient(acceptor, *connectionPtr);
+        });
+    }
+    return true;
+}
+
+void Server::closeReactorClient(Acceptor& acceptor, Connection& connection)
+{
+    int socketClientDescriptor = connection.socketDescriptor;
+    acceptor.loop.cancelTimer(connection.idleTimer);
+    for (const auto& sleepingRequest : connection.sleepingRequests)
+    {
+        acceptor.loop.cancelTimer(sleepingRequest.second);
+    }
+    acceptor.loop.remove(socketClientDescriptor);
+    acceptor.connections.erase(socketClientDescriptor); //'connection' is not valid from here on.
+    closeClientAndNotify(acceptor, socketClientDescriptor);
+
+    int waitingClient = admitWaitingClient(acceptor);
+    if (waitingClient != -1)
+    {
+        startReactorClient(acceptor, waitingClient);
+    }
+    else if (acceptor.listenerPaused && !isAcceptorFull(acceptor))
+    {
+        acceptor.listenerPaused = !acceptor.loop.modify(acceptor.socketDescriptor, EPOLLIN);
+    }
+}
+
+void Server::runCoroutines(Acceptor& acceptor)
+{
+    acceptor.listenerPaused = false;
+    startCoroutineAcceptor(acceptor);
+    acceptor.scheduler.run();
+    closeWaitingClients(acceptor); //Otherwise, the clients cancelled below would start them.
+    acceptor.scheduler.cancel(); //Releases the clients left if the loop failed.
+
+    quitRunningThread();
+    waitForClientsToFinish(acceptor);
+}
+
+void Server::startCoroutineAcceptor(Acceptor& acceptor)
+{
+    acceptor.scheduler.spawn(acceptCoroutineClients(acceptor), [&acceptor](bool paused)
+    {
+        if (!paused)
+        {
+            acceptor.scheduler.quit();
+        }
+    });
+}
+
+Task<bool> Server::acceptCoroutineClients(Acceptor& acceptor)
+{
+    while (true)
+    {
+        //Like the reactor, a full acceptor only keeps accepting to reject or queue the new clients.
+        bool full = isAcceptorFull(acceptor);
+        if (full && options_.admission != AdmissionPolicy::REJECT && options_.admission != AdmissionPolicy::QUEUE)
+        {
+            break;
+        }
+
+        struct sockaddr_in clientAddress;
+        socklen_t sizeofSockAddr = sizeof(struct sockaddr_in);
+        int socketClientDescriptor = accept4(acceptor.socketDescriptor, (struct sockaddr*) &clientAddress, &sizeofSockAddr, SOCK_NONBLOCK);
+        if (socketClientDescriptor == -1)
+        {
+            int errorNumber = errno;
+            if (errorNumber == EMFILE)
+            {
+                Log::logError("Server::acceptCoroutineClients - The system reached the maximum number of open files.");
+            }
+            else if (errorNumber != EAGAIN && errorNumber != EWOULDBLOCK)
+            {
+                Log::logError("Server::acceptCoroutineClients - Could not accept on the socket descriptor", errorNumber);
+                co_return false;
+            }
+
+            if (co_await acceptor.scheduler.wait(acceptor.socketDescriptor, EPOLLIN) != IoResult::OK)
+            {
+                Log::logVerbose("Server::acceptCoroutineClients - Quitting the accept loop by the self pipe trick.");
+                co_return false;
+            }
+            continue;
+        }
+
+        if (!admitSource(socketClientDescriptor, &clientAddress))
+        {
+            continue;
+        }
+
+        if (options_.admission == AdmissionPolicy::QUEUE && queueClient(acceptor, socketClientDescriptor))
+        {
+            continue;
+        }
+
+        if (full && options_.admission == AdmissionPolicy::REJECT)
+        {
+            rejectClient(socketClientDescriptor);
+            continue;
+        }
+
+        {
+            std::scoped_lock lock(mutex_);
+            currentNumberClients_++;
+            acceptor.numberClients++;
+        }
+        startCoroutineClient(acceptor, socketClientDescriptor);
+    }
+
+    Log::logVerbose("Server::acceptCoroutineClients - The maximum number of clients of this acceptor has been reached. Not accepting until one client finishes.");
+    acceptor.listenerPaused = true;
+    co_return true;
+}
+
+void Server::startCoroutineClient(Acceptor& acceptor, int socketClientDescriptor)
+{
+    acceptor.scheduler.spawn(serveCoroutineClient(acceptor, socketClientDescriptor), [this, &acceptor, socketClientDescriptor](bool)
+    {
+        closeClientAndNotify(acceptor, socketClientDescriptor);
+        int waitingClient = admitWaitingClient(acceptor);
+        if (waitingClient != -1)
+        {
+            startCoroutineClient(acceptor, waitingClient);
+        }
+        else if (acceptor.listenerPaused && !isAcceptorFull(acceptor))
+        {
+            acceptor.listenerPaused = false;
+            startCoroutineAcceptor(acceptor);
+        }
+    });
+}
+
+Task<bool> Server::serveCoroutineClient(Acceptor& acceptor, int socketClientDescriptor)
+{
+    Scheduler& scheduler = acceptor.scheduler;
+    bool multiplexed = false;
+    bool answered = false;
+    uint32_t address = topClients_.isEnabled() ? getClientAddress(socketClientDescriptor) : 0;
+    while (true)
+    {
+        long sleepingTime;
+        uint32_t requestId;
+        FrameFormat format;
+        {
+            //The buffer is only allocated while a message is being read, so a sleeping client does not hold it.
+            std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+            IoResult result = co_await scheduler.readFrame(socketClientDescriptor, buffer.get(), answered ? options_.keepAliveTimeOut : std::chrono::milliseconds(0));
+            if (result != IoResult::OK)
+            {
+                if (result == IoResult::TIMED_OUT)
+                {
+                    Log::logVerbose("Server::serveCoroutineClient - The connection was idle for too long.");
+                }
+                co_return answered && result != IoResult::CANCELLED;
+            }
+
+            //The scheduler runs the other clients while this one is suspended, so only the CPU time between suspensions is charged to it.
+            std::chrono::microseconds cpuTime = getThreadCpuTime();
+            format = Common::getFrameFormat(buffer.get());
+            if (!Common::decodeFrame(buffer.get(), sleepingTime, requestId))
+            {
+                Log::logError("Server::serveCoroutineClient - Malformed client message.");
+                co_return false;
+            }
+            size_t frameSize = Common::getFrameSize(buffer.get(), BUFFER_SIZE);
+            recordLoad(ClientLoad{address, 1, static_cast<uint64_t>(std::max(0L, sleepingTime)), frameSize, getThreadCpuTime() - cpuTime});
+        }
+
+        if (!multiplexed && requestId != NO_REQUEST_ID)
+        {
+            multiplexed = true;
+            Common::setNoDelay(socketClientDescriptor, "Server:");
+        }
+
+        //Only the remote peer closing the connection can interrupt the sleeping time, besides the self pipe.
+        std::chrono::steady_clock::time_point expiration = std::chrono::steady_clock::now() + std::chrono::milliseconds(sleepingTime);
+        if (sleepingTime > 0)
+        {
+            IoResult result = co_await scheduler.wait(socketClientDescriptor, EPOLLRDHUP, std::chrono::milliseconds(sleepingTime));
+            if (result == IoResult::OK)
+            {
+                Log::logVerbose("Server::serveCoroutineClient - The remote peer closed the connection.");
+                co_return false;
+            }
+
+            if (result != IoResult::TIMED_OUT)
+            {
+                Log::logVerbose("Server::serveCoroutineClient - Quitting the client by the self pipe trick.");
+                co_return false;
+            }
+        }
+
+        {
+            std::chrono::microseconds cpuTime = getThreadCpuTime();
+            std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+            size_t messageSize = Common::encodeFrame(buffer.get(), format, sleepingTime + 1, requestId);
+            cpuTime = getThreadCpuTime() - cpuTime;
+            if (co_await scheduler.write(socketClientDescriptor, buffer.get(), messageSize, std::chrono::milliseconds(0)) != IoResult::OK)
+            {
+                co_return false;
+            }
+            recordLoad(ClientLoad{address, 0, 0, messageSize, cpuTime});
+        }
+        recordLateness(expiration);
+        answered = true;
+
+        if (!multiplexed && options_.keepAliveTimeOut.count() == 0)
+        {
+            co_return true;
+        }
+    }
+}
+
+void Server::runUring(Acceptor& acceptor)
+{
+    size_t numberBuffers = std::min(acceptor.maxNumberClients, URING_MAX_REGISTERED_BUFFERS);
+    acceptor.uringBuffers.assign(numberBuffers * BUFFER_SIZE, 0);
+    std::vector<struct iovec> buffers(numberBuffers);
+    for (size_t i = 0; i < numberBuffers; i++)
+    {
+        buffers[i].iov_base = acceptor.uringBuffers.data() + i * BUFFER_SIZE;
+        buffers[i].iov_len = BUFFER_SIZE;
+    }
+
+    acceptor.freeUringBuffers.clear();
+    if (acceptor.ring->registerBuffers(buffers.data(), numberBuffers))
+    {
+        for (size_t i = numberBuffers; i > 0; i--)
+        {
+            acceptor.freeUringBuffers.push_back(i - 1);
+        }
+    }
+
+    acceptor.uringQuitting = false;
+    struct io_uring_sqe* sqe = acceptor.ring->getSqe();
+    if (sqe)
+    {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wakeup_.getDescriptor();
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = URING_PIPE;
+        armUringAccept(acceptor);
+
+        //Each iteration submits the operations queued by the previous completions and waits for new completions with one system call.
+        while (!acceptor.uringQuitting || acceptor.uringAcceptArmed || !acceptor.uringConnections.empty())
+        {
+            if (!acceptor.ring->submit(1))
+            {
+                break;
+            }
+
+            struct io_uring_cqe cqe;
+            while (acceptor.ring->popCqe(cqe))
+            {
+                handleUringCompletion(acceptor, cqe);
+            }
+        }
+    }
+
+    for (int socketClientDescriptor : acceptor.uringPendingClients)
+    {
+        sourceLimiter_.release(socketClientDescriptor);
+        close(socketClientDescriptor);
+    }
+    acceptor.uringPendingClients.clear();
+
+    //Only reached without pending operations, unless io_uring_enter failed.
+    for (auto& connection : acceptor.uringConnections)
+    {
+        closeClientAndNotify(acceptor, connection.second->socketDescriptor);
+    }
+    acceptor.uringConnections.clear();
+
+    quitRunningThread();
+    waitForClientsToFinish(acceptor);
+}
+
+void Server::quitUring(Acceptor& acceptor)
+{
+    acceptor.uringQuitting = true;
+    for (auto& connection : acceptor.uringConnections)
+    {
+        connection.second->closing = true;
+    }
+
+    //One cancellation for every pending operation of the ring, including the multishot accept.
+    struct io_uring_sqe* sqe = acceptor.ring->getSqe();
+    if (sqe)
+    {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        sqe->user_data = URING_CANCEL;
+    }
+}
+
+bool Server::isUringSupported()
+{
+    IoUring ring;
+    if (!ring.init(4, "Server:") || !ring.isSupported({IORING_OP_ACCEPT, IORING_OP_ASYNC_CANCEL, IORING_OP_POLL_ADD, IORING_OP_TIMEOUT,
+        IORING_OP_LINK_TIMEOUT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED}))
+    {
+        return false;
+    }
+
+    //The flags are not probed, so they are tried, as their preparation fails with EINVAL on the kernels without them: first the
+    //cancellation of any operation, with none pending, and then a multishot accept on a listener nobody connects to, cancelled right away.
+    struct io_uring_sqe* sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = URING_CANCEL;
+    struct io_uring_cqe cqe;
+    if (!ring.submit(1) || !ring.popCqe(cqe) || cqe.res == -EINVAL)
+    {
+        Log::logError("Server::isUringSupported - The cancellation of any operation is not supported.");
+        return false;
+    }
+
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listener == -1 || listen(listener, 1) == -1)
+    {
+        int errorNumber = errno;
+        Log::logError("Server::isUringSupported - Could not create a listener to try the multishot accept", errorNumber);
+        if (listener != -1)
+        {
+            close(listener);
+        }
+        return false;
+    }
+
+    sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listener;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = URING_ACCEPT;
+    sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = URING_ACCEPT;
+    sqe->user_data = URING_CANCEL;
+
+    bool supported = ring.submit(2);
+    for (int i = 0; supported && i < 2 && ring.popCqe(cqe); i++)
+    {
+        supported = cqe.user_data != URING_ACCEPT || cqe.res != -EINVAL;
+    }
+    close(listener);
+    if (!supported)
+    {
+        Log::logError("Server::isUringSupported - The multishot accept is not supported.");
+    }
+    return supported;
+}
+
+void Server::armUringAccept(Acceptor& acceptor)
+{
+    struct io_uring_sqe* sqe = acceptor.ring->getSqe();
+    if (!sqe)
+    {
+        Log::logError("Server::armUringAccept - Could not get a submission entry for the accept operation.");
+        return;
+    }
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = acceptor.socketDescriptor;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK;
+    sqe->user_data = URING_ACCEPT;
+    acceptor.uringAcceptArmed = true;
+}
+
+void Server::submitUringCancel(Acceptor& acceptor, uint64_t userData)
+{
+    struct io_uring_sqe* sqe = acceptor.ring->getSqe();
+    if (!sqe)
+    {
+        Log::logError("Server::submitUringCancel - Could not get a submission entry for the cancel operation.");
+        return;
+    }
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = userData;
+    sqe->user_data = URING_CANCEL;
+}
+
+char* Server::getUringBuffer(Acceptor& acceptor, UringConnection& connection)
+{
+    if (connection.bufferIndex != -1)
+    {
+        return acceptor.uringBuffers.data() + connection.bufferIndex * BUFFER_SIZE;
+    }
+
+    if (!connection.buffer)
+    {
+        if (!acceptor.freeUringBuffers.empty())
+        {
+            connection.bufferIndex = acceptor.freeUringBuffers.back();
+            acceptor.freeUringBuffers.pop_back();
+            return acceptor.uringBuffers.data() + connection.bufferIndex * BUFFER_SIZE;
+        }
+        connection.buffer.reset(new char[BUFFER_SIZE]);
+    }
+
+    return connection.buffer.get();
+}
+
+void Server::releaseUringBuffer(Acceptor& acceptor, UringConnection& connection)
+{
+    if (connection.bufferIndex != -1)
+    {
+        acceptor.freeUringBuffers.push_back(connection.bufferIndex);
+        connection.bufferIndex = -1;
+    }
+    connection.buffer.reset();
+}
+
+void Server::startUringClient(Acceptor& acceptor, int socketClientDescriptor)
+{
+    {
+        std::scoped_lock lock(mutex_);
+        currentNumberClients_++;
+        acceptor.numberClients++;
+    }
+
+    std::unique_ptr<UringConnection> connection(new UringConnection());
+    connection->socketDescriptor = socketClientDescriptor;
+    connection->state = ConnectionState::READING;
+    connection->sleepingTime = 0;
+    connection->requestId = NO_REQUEST_ID;
+    connection->multiplexed = false;
+    connection->format = FrameFormat::TEXT;
+    connection->messageSize = 0;
+    connection->bufferPosition = 0;
+    connection->bufferIndex = -1;
+    connection->pendingOperations = 0;
+    connection->closing = false;
+    connection->idle = false;
+    connection->address = topClients_.isEnabled() ? getClientAddress(socketClientDescriptor) : 0;
+    connection->nextRequest = 0;
+    connection->writePosition = 0;
+
+    UringConnection& connectionRef = *connection;
+    acceptor.uringConnections[socketClientDescriptor] = std::move(connection);
+    if (!submitUringTransfer(acceptor, connectionRef, URING_READ))
+    {
+        closeUringClient(acceptor, connectionRef);
+    }
+}
+
+bool Server::submitUringTransfer(Acceptor& acceptor, UringConnection& connection, uint64_t operation)
+{
+    //The read of an idle keep-alive connection is linked to a timeout, which cancels the read once it expires.
+    bool linkIdleTimeOut = operation == URING_READ && connection.idle && !connection.multiplexed;
+    struct io_uring_sqe* sqe = linkIdleTimeOut && !acceptor.ring->reserve(2) ? nullptr : acceptor.ring->getSqe();
+    if (!sqe)
+    {
+        Log::logError("Server::submitUringTransfer - Could not get a submission entry.");
+        return false;
+    }
+
+    char* buffer = getUringBuffer(acceptor, connection);
+    sqe->fd = connection.socketDescriptor;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer + connection.bufferPosition);
+    sqe->len = (operation == URING_READ ? BUFFER_SIZE : connection.messageSize) - connection.bufferPosition;
+    sqe->user_data = reinterpret_cast<uint64_t>(&connection) | operation;
+    if (connection.bufferIndex != -1)
+    {
+        sqe->opcode = operation == URING_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        sqe->buf_index = connection.bufferIndex;
+    }
+    else
+    {
+        sqe->opcode = operation == URING_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    }
+    connection.pendingOperations |= 1 << operation;
+
+    if (linkIdleTimeOut)
+    {
+        sqe->flags |= IOSQE_IO_LINK;
+        struct io_uring_sqe* timeoutSqe = acceptor.ring->getSqe();
+        timeoutSqe->opcode = IORING_OP_LINK_TIMEOUT;
+        timeoutSqe->fd = -1;
+        timeoutSqe->addr = reinterpret_cast<uint64_t>(&connection.sleepingTimeSpec);
+        timeoutSqe->len = 1;
+        timeoutSqe->user_data = reinterpret_cast<uint64_t>(&connection) | URING_IDLE_TIMEOUT;
+        connection.pendingOperations |= 1 << URING_IDLE_TIMEOUT;
+    }
+    return true;
+}
+
+void Server::handleUringCompletion(Acceptor& acceptor, const struct io_uring_cqe& cqe)
+{
+    uint64_t operation = cqe.user_data & URING_OPERATION_MASK;
+    switch (operation)
+    {
+        case URING_CANCEL:
+            return;
+        case URING_PIPE:
+            Log::logVerbose("Server::handleUringCompletion - Quitting io_uring loop by the self pipe trick.");
+            quitUring(acceptor);
+            return;
+        case URING_ACCEPT:
+            if (!(cqe.flags & IORING_CQE_F_MORE))
+            {
+                acceptor.uringAcceptArmed = false;
+            }
+
+            if (cqe.res >= 0)
+            {
+                if (acceptor.uringQuitting)
+                {
+                    close(cqe.res);
+                }
+                else if (admitSource(cqe.res, nullptr))
+                {
+                    if (isAcceptorFull(acceptor))
+                    {
+                        Log::logVerbose("Server::handleUringCompletion - The maximum number of clients has been reached. Cancelling the accept until one client finishes.");
+                        acceptor.uringPendingClients.push_back(cqe.res);
+                        if (acceptor.uringAcceptArmed)
+                        {
+                            submitUringCancel(acceptor, URING_ACCEPT);
+                        }
+                    }
+                    else
+                    {
+                        startUringClient(acceptor, cqe.res);
+                    }
+                }
+            }
+            else if (cqe.res == -EMFILE)
+            {
+                Log::logError("Server::handleUringCompletion - The system reached the maximum number of open files.");
+            }
+            else if (cqe.res != -ECANCELED && cqe.res != -EAGAIN)
+            {
+                //Like the accept loops of the other modes, a hard error stops the acceptor instead of submitting the accept again.
+                Log::logError("Server::handleUringCompletion - Could not accept on the socket descriptor", -cqe.res);
+                if (!acceptor.uringQuitting)
+                {
+                    quitUring(acceptor);
+                }
+            }
+
+            if (!acceptor.uringAcceptArmed && !acceptor.uringQuitting && acceptor.uringPendingClients.empty() && !isAcceptorFull(acceptor))
+            {
+                armUringAccept(acceptor);
+            }
+            return;
+        case URING_REQUEST_TIMEOUT:
+        {
+            UringRequest* request = reinterpret_cast<UringRequest*>(cqe.user_data & ~URING_OPERATION_MASK);
+            uint32_t address = request->connection->address;
+            std::chrono::microseconds cpuTime = getThreadCpuTime();
+            answerUringRequest(acceptor, *request, cqe.res);
+            recordLoad(ClientLoad{address, 0, 0, 0, getThreadCpuTime() - cpuTime});
+            return;
+        }
+        default:
+        {
+            UringConnection* connection = reinterpret_cast<UringConnection*>(cqe.user_data & ~URING_OPERATION_MASK);
+            connection->pendingOperations &= ~(1 << operation);
+
+            //The ring serves all the clients of the acceptor, so only the CPU time of this completion is charged to the client.
+            uint32_t address = connection->address;
+            std::chrono::microseconds cpuTime = getThreadCpuTime();
+            handleUringClientCompletion(acceptor, *connection, operation, cqe.res);
+            recordLoad(ClientLoad{address, 0, 0, 0, getThreadCpuTime() - cpuTime});
+        }
+    }
+}
+
+bool Server::startUringRequest(Acceptor& acceptor, UringConnection& connection)
+{
+    char* buffer = getUringBuffer(acceptor, connection);
+    size_t frameSize = Common::getFrameSize(buffer, connection.bufferPosition);
+    if (frameSize == 0 || connection.bufferPosition < frameSize)
+    {
+        //Otherwise, the next read would get no room and complete with 0, as if the remote peer had closed the connection.
+        if (connection.bufferPosition == BUFFER_SIZE)
+        {
+            Log::logError("Server::startUringRequest - Malformed client message, which does not fit in the buffer.");
+            return false;
+        }
+        return submitUringTransfer(acceptor, connection, URING_READ) && (!connection.multiplexed || armUringIdleTimeOut(acceptor, connection));
+    }
+
+    long sleepingTime;
+    uint32_t requestId;
+    FrameFormat format = Common::getFrameFormat(buffer);
+    if (!Common::decodeFrame(buffer, sleepingTime, requestId))
+    {
+        Log::logError("Server::startUringRequest - Malformed client message.");
+        return false;
+    }
+    connection.idle = false;
+    recordLoad(ClientLoad{connection.address, 1, static_cast<uint64_t>(std::max(0L, sleepingTime)), frameSize});
+
+    if (!connection.multiplexed && requestId != NO_REQUEST_ID)
+    {
+        connection.multiplexed = true;
+        Common::setNoDelay(connection.socketDescriptor, "Server:");
+    }
+
+    if (connection.multiplexed)
+    {
+        //The keep-alive timeout of the connection only runs while it has nothing to do.
+        if (connection.pendingOperations & (1 << URING_IDLE_TIMEOUT))
+        {
+            submitUringCancel(acceptor, reinterpret_cast<uint64_t>(&connection) | URING_IDLE_TIMEOUT);
+        }
+
+        //A single read might carry several requests, and the beginning of the next one.
+        connection.bufferPosition -= frameSize;
+        memmove(buffer, buffer + frameSize, connection.bufferPosition);
+        return submitUringSleep(acceptor, connection, format, sleepingTime, requestId) && startUringRequest(acceptor, connection);
+    }
+
+    connection.format = format;
+    connection.requestId = requestId;
+    connection.sleepingTime = sleepingTime;
+    long timeOut = std::max(0L, sleepingTime); //A negative timeout would make the IORING_OP_TIMEOUT fail with EINVAL.
+    connection.pendingBytes.assign(buffer + frameSize, connection.bufferPosition - frameSize);
+    releaseUringBuffer(acceptor, connection);
+    connection.state = ConnectionState::SLEEPING;
+    connection.sleepingTimeSpec.tv_sec = timeOut / 1000;
+    connection.sleepingTimeSpec.tv_nsec = (timeOut % 1000) * 1000000LL;
+    connection.expiration = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOut);
+
+    //The sleep and the detection of the remote peer closing the connection are submitted together. The poll stays armed until
+    //the connection is closed, so it is only submitted with the first request.
+    bool armPoll = !(connection.pendingOperations & (1 << URING_POLL));
+    if (!acceptor.ring->reserve(armPoll ? 2 : 1))
+    {
+        Log::logError("Server::startUringRequest - Could not get the submission entries for the sleeping time.");
+        return false;
+    }
+
+    struct io_uring_sqe* timeoutSqe = acceptor.ring->getSqe();
+    timeoutSqe->opcode = IORING_OP_TIMEOUT;
+    timeoutSqe->fd = -1;
+    timeoutSqe->addr = reinterpret_cast<uint64_t>(&connection.sleepingTimeSpec);
+    timeoutSqe->len = 1;
+    timeoutSqe->user_data = reinterpret_cast<uint64_t>(&connection) | URING_TIMEOUT;
+    connection.pendingOperations |= 1 << URING_TIMEOUT;
+
+    if (armPoll)
+    {
+        //Only POLLRDHUP, as the next requests of a pipelining client may already be readable.
+        struct io_uring_sqe* pollSqe = acceptor.ring->getSqe();
+        pollSqe->opcode = IORING_OP_POLL_ADD;
+        pollSqe->fd = connection.socketDescriptor;
+        pollSqe->poll32_events = POLLRDHUP;
+        pollSqe->user_data = reinterpret_cast<uint64_t>(&connection) | URING_POLL;
+        connection.pendingOperations |= 1 << URING_POLL;
+    }
+    return true;
+}
+
+bool Server::submitUringSleep(Acceptor& acceptor, UringConnection& connection, FrameFormat format, long sleepingTime, uint32_t requestId)
+{
+    struct io_uring_sqe* sqe = acceptor.ring->getSqe();
+    if (!sqe)
+    {
+        Log::logError("Server::submitUringSleep - Could not get a submission entry for the sleeping time.");
+        return false;
+    }
+
+    long timeOut = std::max(0L, sleepingTime); //A negative timeout would make the IORING_OP_TIMEOUT fail with EINVAL.
+    uint64_t sequence = connection.nextRequest++;
+    UringRequest& request = connection.sleepingRequests[sequence];
+    request.connection = &connection;
+    request.sequence = sequence;
+    request.sleepingTime = sleepingTime;
+    request.requestId = requestId;
+    request.format = format;
+    request.expiration = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeOut);
+    request.sleepingTimeSpec.tv_sec = timeOut / 1000;
+    request.sleepingTimeSpec.tv_nsec = (timeOut % 1000) * 1000000LL;
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&request.sleepingTimeSpec);
+    sqe->len = 1;
+    sqe->user_data = reinterpret_cast<uint64_t>(&request) | URING_REQUEST_TIMEOUT;
+    return true;
+}
+
+void Server::answerUringRequest(Acceptor& acceptor, UringRequest& request, int result)
+{
+    UringConnection& connection = *request.connection;
+    UringRequest answered = request;
+    connection.sleepingRequests.erase(request.sequence); //'request' is not valid from here on.
+
+    if (connection.closing || result != -ETIME)
+    {
+        closeUringClient(acceptor, connection);
+        return;
+    }
+
+    recordLateness(answered.expiration);
+    char response[BUFFER_SIZE];
+    size_t size = Common::encodeFrame(response, answered.format, answered.sleepingTime + 1, answered.requestId);
+    connection.responses.append(response, size);
+    if (!submitUringResponses(acceptor, connection))
+    {
+        closeUringClient(acceptor, connection);
+    }
+}
+
+bool Server::submitUringResponses(Acceptor& acceptor, UringConnection& connection)
+{
+    if (connection.pendingOperations & (1 << URING_WRITE))
+    {
+        return true;
+    }
+
+    if (connection.writePosition == connection.writingResponses.size())
+    {
+        if (connection.responses.empty())
+        {
+            return true;
+        }
+        connection.writingResponses.swap(connection.responses);
+        connection.responses.clear();
+        connection.writePosition = 0;
+    }
+
+    struct io_uring_sqe* sqe = acceptor.ring->getSqe();
+    if (!sqe)
+    {
+        Log::logError("Server::submitUringResponses - Could not get a submission entry.");
+        return false;
+    }
+
+    //The registered buffer of the connection is taken by its read, so the responses are written from their own memory.
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = connection.socketDescriptor;
+    sqe->addr = reinterpret_cast<uint64_t>(connection.writingResponses.data() + connection.writePosition);
+    sqe->len = connection.writingResponses.size() - connection.writePosition;
+    sqe->user_data = reinterpret_cast<uint64_t>(&connection) | URING_WRITE;
+    connection.pendingOperations |= 1 << URING_WRITE;
+    return true;
+}
+
+bool Server::armUringIdleTimeOut(Acceptor& acceptor, UringConnection& connection)
+{
+    bool busy = !connection.sleepingRequests.empty() || !connection.responses.empty() || (connection.pendingOperations & ((1 << URING_WRITE) | (1 << URING_IDLE_TIMEOUT)));
+    if (options_.keepAliveTimeOut.count() == 0 || busy)
+    {
+        return true;
+    }
+
+    struct io_uring_sqe* sqe = acceptor.ring->getSqe();
+    if (!sqe)
+    {
+        Log::logError("Server::armUringIdleTimeOut - Could not get a submission entry for the keep-alive timeout.");
+        return false;
+    }
+
+    connection.idle = true;
+    connection.sleepingTimeSpec.tv_sec = options_.keepAliveTimeOut.count() / 1000;
+    connection.sleepingTimeSpec.tv_nsec = (options_.keepAliveTimeOut.count() % 1000) * 1000000LL;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&connection.sleepingTimeSpec);
+    sqe->len = 1;
+    sqe->user_data = reinterpret_cast<uint64_t>(&connection) | URING_IDLE_TIMEOUT;
+    connection.pendingOperations |= 1 << URING_IDLE_TIMEOUT;
+    return true;
+}
+
+void Server::handleUringClientCompletion(Acceptor& acceptor, UringConnection& connection, uint64_t operation, int result)
+{
+    if (connection.closing)
+    {
+        closeUringClient(acceptor, connection);
+        return;
+    }
+
+    switch (operation)
+    {
+        case URING_READ:
+            if (result <= 0)
+            {
+                Log::logVerbose("Server::handleUringClientCompletion - Could not read the client message with the sleeping time.");
+                closeUringClient(acceptor, connection);
+                return;
+            }
+
+            connection.bufferPosition += result;
+            if (!startUringRequest(acceptor, connection))
+            {
+                closeUringClient(acceptor, connection);
+            }
+            return;
+        case URING_TIMEOUT:
+            if (result != -ETIME)
+            {
+                closeUringClient(acceptor, connection);
+                return;
+            }
+
+            recordLateness(connection.expiration);
+            connection.state = ConnectionState::WRITING;
+            connection.bufferPosition = 0;
+            connection.messageSize = Common::encodeFrame(getUringBuffer(acceptor, connection), connection.format, connection.sleepingTime + 1, connection.requestId);
+            if (!submitUringTransfer(acceptor, connection, URING_WRITE))
+            {
+                closeUringClient(acceptor, connection);
+            }
+            return;
+        case URING_POLL:
+            //The socket reported POLLRDHUP, so the remote peer closed the connection.
+            Log::logVerbose("Server::handleUringClientCompletion - the remote peer closed the connection.");
+            closeUringClient(acceptor, connection);
+            return;
+        case URING_WRITE:
+            if (result <= 0)
+            {
+                Log::logError("Server::handleUringClientCompletion - Error writing to the client message the increased sleeping time", -result);
+                closeUringClient(acceptor, connection);
+                return;
+            }
+
+            if (connection.multiplexed)
+            {
+                connection.writePosition += result;
+                recordLoad(ClientLoad{connection.address, 0, 0, static_cast<uint64_t>(result)});
+                if (!submitUringResponses(acceptor, connection) || !armUringIdleTimeOut(acceptor, connection))
+                {
+                    closeUringClient(acceptor, connection);
+                }
+                return;
+            }
+
+            connection.bufferPosition += result;
+            if (connection.bufferPosition < connection.messageSize)
+            {
+                if (!submitUringTransfer(acceptor, connection, URING_WRITE))
+                {
+                    closeUringClient(acceptor, connection);
+                }
+                return;
+            }
+            recordLoad(ClientLoad{connection.address, 0, 0, connection.messageSize});
+
+            if (options_.keepAliveTimeOut.count() == 0 && connection.pendingBytes.empty())
+            {
+                closeUringClient(acceptor, connection);
+                return;
+            }
+
+            //Serve the next message of the keep-alive connection, starting with the bytes already read.
+            connection.state = ConnectionState::READING;
+            connection.idle = options_.keepAliveTimeOut.count() > 0;
+            connection.bufferPosition = connection.pendingBytes.size();
+            memcpy(getUringBuffer(acceptor, connection), connection.pendingBytes.data(), connection.bufferPosition);
+            connection.pendingBytes.clear();
+            connection.sleepingTimeSpec.tv_sec = options_.keepAliveTimeOut.count() / 1000;
+            connection.sleepingTimeSpec.tv_nsec = (options_.keepAliveTimeOut.count() % 1000) * 1000000LL;
+            if (!startUringRequest(acceptor, connection))
+            {
+                closeUringClient(acceptor, connection);
+            }
+            return;
+        case URING_IDLE_TIMEOUT:
+            if (connection.multiplexed)
+            {
+                //Unless a request started in the meantime, and then the timeout is submitted again once the connection is idle.
+                if (result == -ETIME && connection.idle)
+                {
+                    Log::logVerbose("Server::handleUringClientCompletion - The multiplexed connection was idle for too long.");
+                    closeUringClient(acceptor, connection);
+                }
+                else if (!armUringIdleTimeOut(acceptor, connection))
+                {
+                    closeUringClient(acceptor, connection);
+                }
+                return;
+            }
+
+            //The linked read completes with -ECANCELED, which closes the connection.
+            if (result == -ETIME)
+            {
+                Log::logVerbose("Server::handleUringClientCompletion - The keep-alive connection was idle for too long.");
+            }
+            return;
+    }
+}
+
+void Server::closeUringClient(Acceptor& acceptor, UringConnection& connection)
+{
+    if (!connection.closing)
+    {
+        connection.closing = true;
+        for (uint64_t operation : {URING_IDLE_TIMEOUT, URING_READ, URING_TIMEOUT, URING_POLL, URING_WRITE})
+        {
+            if (connection.pendingOperations & (1 << operation))
+            {
+                submitUringCancel(acceptor, reinterpret_cast<uint64_t>(&connection) | operation);
+            }
+        }
+        for (auto& request : connection.sleepingRequests)
+        {
+            submitUringCancel(acceptor, reinterpret_cast<uint64_t>(&request.second) | URING_REQUEST_TIMEOUT);
+        }
+    }
+
+    if (connection.pendingOperations || !connection.sleepingRequests.empty())
+    {
+        return;
+    }
+
+    int socketClientDescriptor = connection.socketDescriptor;
+    releaseUringBuffer(acceptor, connection);
+    acceptor.uringConnections.erase(socketClientDescriptor); //'connection' is not valid from here on.
+    closeClientAndNotify(acceptor, socketClientDescriptor);
+
+    if (acceptor.uringQuitting)
+    {
+        return;
+    }
+
+    while (!acceptor.uringPendingClients.empty() && !isAcceptorFull(acceptor))
+    {
+        int pendingClient = acceptor.uringPendingClients.front();
+        acceptor.uringPendingClients.pop_front();
+        startUringClient(acceptor, pendingClient);
+    }
+
+    //Several clients might close while others are pending, so the accept is armed again as soon as there is room left.
+    if (!acceptor.uringAcceptArmed && !acceptor.uringQuitting && acceptor.uringPendingClients.empty() && !isAcceptorFull(acceptor))
+    {
+        armUringAccept(acceptor);
+    }
 }
 
 }
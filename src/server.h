@@ -5,11 +5,71 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <vector>
+#include <string>
 #include "common.h"
+#include "concurrency_limiter.h"
+#include "event_loop.h"
+#include "coroutine.h"
+#include "thread_pool.h"
+#include "io_uring.h"
+#include "source_limiter.h"
+#include "top_clients.h"
+#include "waiting_queue.h"
+#include "wakeup.h"
 
 namespace pipetrick
 {
 
+/**
+ * The ways a server can attend its clients.
+ */
+enum class ServerMode
+{
+    THREAD_PER_CLIENT, //Each client is served by its own thread, which blocks in select calls.
+    WORKER_POOL, //Each client is served by one thread of a pre-started pool, which blocks in select calls.
+    REACTOR, //One epoll loop owns the listener, the self pipe and every client socket.
+    IO_URING, //One io_uring instance accepts, reads, sleeps and writes for every client. Falls back to THREAD_PER_CLIENT if io_uring is not available.
+    COROUTINE //One scheduler runs a coroutine per client, written as sequential steps that suspend instead of blocking.
+};
+
+/**
+ * What an acceptor does with the new clients while it is full.
+ */
+enum class AdmissionPolicy
+{
+    WAIT, //THREAD_PER_CLIENT and WORKER_POOL accept the client and wait for another one to finish. The other modes stop watching the listener.
+    PAUSE, //The listener is not watched until another client finishes, so the backlog absorbs the bursts.
+    REJECT, //The client is accepted and answered right away with a busy message carrying 'ServerOptions::retryAfter', so it fails fast. IO_URING pauses instead.
+    QUEUE //The client is accepted and waits in a 'WaitingQueue' for a free slot, by the priority and the deadline of its first request. The clients dropped by the queue get the busy message. IO_URING pauses instead.
+};
+
+/**
+ * Optional settings of a server.
+ */
+struct ServerOptions
+{
+    ServerMode mode = ServerMode::THREAD_PER_CLIENT;
+    size_t numWorkers = 0; //The number of threads of the pool in 'ServerMode::WORKER_POOL'. Zero means one thread per allowed client.
+    size_t workerQueueCapacity = 0; //The maximum number of accepted clients waiting for a free worker. Zero means the maximum number of clients.
+    WakeupType wakeup = WakeupType::PIPE; //The implementation of the 'Self pipe trick'.
+    std::chrono::milliseconds keepAliveTimeOut = std::chrono::milliseconds(0); //How long a connection can wait for its next request. Zero closes the connection after one request.
+    AdmissionPolicy admission = AdmissionPolicy::WAIT;
+    std::chrono::milliseconds retryAfter = std::chrono::milliseconds(100); //The time the clients rejected by 'AdmissionPolicy::REJECT', 'AdmissionPolicy::QUEUE' or 'sourceLimit' are asked to wait before retrying.
+    WaitingQueueOptions waitingQueue; //The queue of each acceptor in 'AdmissionPolicy::QUEUE'.
+    double bulkShare = 1.0; //The share of the concurrency limit that the clients of 'Common::Priority::BULK' can hold in 'AdmissionPolicy::QUEUE', so the rest of slots stay free for the other classes. A client whose first request did not arrive yet when accepted counts as 'Common::Priority::NORMAL'.
+    SourceLimitOptions sourceLimit; //The limits of the new and the open connections of each source address, enforced right after the accept, before the client takes a slot.
+    TopClientsOptions topClients; //The tracking of the source addresses with the highest load, returned by 'Server::getTopClients'.
+    bool fastOpen = false; //Whether the listening sockets accept TCP Fast Open, so the first message of a client comes in its SYN.
+    int fastOpenQueueLength = 256; //The maximum number of TCP Fast Open connections of each listening socket whose handshake is not completed yet. Beyond it, the clients do the regular handshake.
+    ConcurrencyLimitOptions concurrencyLimit; //How the number of parallel clients allowed adapts to the lateness of the responses, below the maximum one.
+    size_t numAcceptors = 1; //The number of listening sockets bound to the same port with SO_REUSEPORT, each one with its own accept loop. Capped to the maximum number of clients.
+};
+
 class Server
 {
 public:
@@ -17,16 +77,19 @@ public:
     static const std::chrono::milliseconds MAX_TIME_TO_WAIT_FOR_CLIENTS_TO_FINISH;
 
     using SelectResult = Common::SelectResult;
+    using FrameFormat = Common::FrameFormat;
+    using Priority = Common::Priority;
 
     /**
      * Constructor
      *
      * @param[in] maxClients The maximum number of parallel clients that this server can attend at the same time.
+     * @param[in] options
      */
-    explicit Server(size_t maxClients);
+    explicit Server(size_t maxClients, const ServerOptions& options = ServerOptions());
 
     /**
-     * Starts the server to listen to connections on port 'port' in a new thread that will execute the method 'run'.
+     * Starts the server to listen to connections on port 'port'. Each acceptor listens on its own socket in a new thread.
      *
      * @param[in] port The port where the server will listen to incoming connections.
      * @return true if the server is started successfully, false otherwise.
@@ -34,7 +97,7 @@ public:
     bool start(int port = DEFAULT_PORT);
 
     /**
-     * Writes to the 'write' end of the pipe descriptor (pipeDescriptors_[1]) and waits for all clients to finish.
+     * Notifies 'wakeup_' and waits for all clients to finish.
      */
     void stop();
 
@@ -43,86 +106,624 @@ public:
      */
     size_t getNumberOfClients() const;
 
+    /**
+     * @return the current number of parallel clients allowed, which 'ServerOptions::concurrencyLimit' adapts below the maximum one.
+     */
+    size_t getConcurrencyLimit() const;
+
+    /**
+     * @return the current number of clients waiting for a free slot in 'AdmissionPolicy::QUEUE'.
+     */
+    size_t getNumberOfWaitingClients() const;
+
+    /**
+     * @return the number of waiting clients dropped so far in 'AdmissionPolicy::QUEUE', because they waited for too long or the queue was full.
+     */
+    size_t getNumberOfDroppedClients() const;
+
+    /**
+     * @return the number of clients rejected so far because their source address was over the limits of 'ServerOptions::sourceLimit'.
+     */
+    size_t getNumberOfThrottledClients() const;
+
+    /**
+     * @return the number of source addresses forgotten or not tracked so far because the table of 'ServerOptions::sourceLimit' was full.
+     */
+    size_t getNumberOfDroppedSources() const;
+
+    /**
+     * @param[in] count The maximum number of addresses returned.
+     * @return The source addresses with the highest load, from the highest one, if 'ServerOptions::topClients' tracks them. The load
+     * of the clients still connected is included up to their last event.
+     */
+    std::vector<ClientLoad> getTopClients(size_t count) const;
+
 private:
 
     /**
-     * Performs a bind and listen operations on the socket 'serverSocketDescriptor_' on port 'port'.
+     * The states of a client served by the io_uring engine.
+     */
+    enum class ConnectionState
+    {
+        READING, //Waiting for the message with the sleeping time.
+        SLEEPING, //Waiting for the sleeping time to expire.
+        WRITING //Writing back the increased sleeping time.
+    };
+
+    /**
+     * A client served by the reactor. It is the state machine equivalent to 'serveConnection': the socket is always watched for
+     * the next message, and every request sleeps in its own timer.
+     */
+    struct Connection
+    {
+        int socketDescriptor;
+        size_t bufferPosition; //The number of bytes of 'buffer' already read.
+        std::unique_ptr<char[]> buffer; //Only allocated while a message is being read, so a sleeping client does not hold a message buffer.
+        uint64_t nextRequest; //The sequence number of the next request read.
+        std::unordered_map<uint64_t, EventLoop::TimerId> sleepingRequests; //The timers of the requests still sleeping, by sequence number.
+        std::deque<std::string> responses; //The responses waiting to be written. The first one might be partially written.
+        size_t writePosition; //The number of bytes of the first response already written.
+        bool watchingWrites; //Whether EPOLLOUT is watched because the socket was not writable.
+        bool multiplexed; //Raised once a request with an id is read.
+        bool answered; //Raised once a response is written.
+        uint32_t address; //The source address, only known while tracking the top clients.
+        EventLoop::TimerId idleTimer; //Closes a keep-alive or multiplexed connection that stays idle for too long.
+    };
+
+    struct UringConnection;
+
+    /**
+     * A request of a multiplexed client of the io_uring engine, which sleeps in its own IORING_OP_TIMEOUT operation. Its address
+     * is stored in the user data of that operation, so its lowest bits must be free for the operation.
+     */
+    struct alignas(16) UringRequest
+    {
+        UringConnection* connection;
+        uint64_t sequence; //The key of the request in 'UringConnection::sleepingRequests'.
+        long sleepingTime;
+        uint32_t requestId;
+        FrameFormat format;
+        std::chrono::steady_clock::time_point expiration; //When the sleeping time expires.
+        struct __kernel_timespec sleepingTimeSpec; //The timeout of the IORING_OP_TIMEOUT operation, which must outlive the submission.
+    };
+
+    /**
+     * A client served by the io_uring engine. Its requests are served one at a time, unless it is multiplexed: then every request
+     * sleeps in its own 'UringRequest' while the next ones are read, as in the reactor.
+     */
+    struct alignas(16) UringConnection
+    {
+        int socketDescriptor;
+        ConnectionState state;
+        int sleepingTime;
+        uint32_t requestId; //The id of the request being served, echoed in its response.
+        FrameFormat format; //The format of the request being served, which is also the format of its response.
+        size_t messageSize; //The size of the response being written.
+        std::chrono::steady_clock::time_point expiration; //When the sleeping time of the request being served expires.
+        std::string pendingBytes; //The bytes read beyond the request being served, which belong to the next ones.
+        bool multiplexed; //Raised once a request with an id is read, so the connection is kept open after each response.
+        size_t bufferPosition; //The number of bytes of the buffer already read or written.
+        int bufferIndex; //The index of the registered buffer used while reading or writing, or -1 if it uses 'buffer'.
+        std::unique_ptr<char[]> buffer; //Only allocated when all the registered buffers are in use.
+        unsigned pendingOperations; //One bit per operation submitted and not completed yet.
+        bool closing; //Raised when the connection has to be released once all its pending operations complete.
+        bool idle; //Raised while a keep-alive connection waits for its next message, even if part of it was already read.
+        uint32_t address; //The source address, only known while tracking the top clients.
+        struct __kernel_timespec sleepingTimeSpec; //The timeout of the IORING_OP_TIMEOUT (or the idle IORING_OP_LINK_TIMEOUT) operation, which must outlive the submission.
+        uint64_t nextRequest; //The sequence number of the next request of a multiplexed connection.
+        std::unordered_map<uint64_t, UringRequest> sleepingRequests; //The requests of a multiplexed connection still sleeping, by sequence number.
+        std::string responses; //The responses of a multiplexed connection waiting to be written.
+        std::string writingResponses; //The responses being written, which do not move until the write completes.
+        size_t writePosition; //The number of bytes of 'writingResponses' already written.
+    };
+
+    /**
+     * A listening socket with its own accept loop and its share of the maximum number of clients. The state of the reactor and
+     * the io_uring engine is only accessed by the thread of the acceptor.
+     */
+    struct Acceptor
+    {
+        int socketDescriptor;
+        size_t maxNumberClients; //The share of 'maxNumberClients_' of this acceptor.
+        size_t numberClients; //The clients accepted by this acceptor that are still connected. Protected by 'mutex_'.
+        std::thread thread; //The thread running the accept loop.
+        EventLoop loop; //The reactor loop in 'ServerMode::REACTOR' mode.
+        std::unordered_map<int, std::unique_ptr<Connection> > connections; //The clients served by the reactor.
+        bool listenerPaused; //Whether the reactor (or the coroutine scheduler) stopped watching the listener because the acceptor is full.
+        Scheduler scheduler; //The coroutine scheduler in 'ServerMode::COROUTINE' mode.
+        std::unique_ptr<WaitingQueue> waitingClients; //The clients waiting for a free slot in 'AdmissionPolicy::QUEUE'. Protected by 'mutex_'.
+        std::unordered_set<int> bulkClients; //The clients of 'Priority::BULK' admitted in 'AdmissionPolicy::QUEUE'. Protected by 'mutex_'.
+        std::unique_ptr<IoUring> ring; //The io_uring instance in 'ServerMode::IO_URING' mode.
+        std::unordered_map<int, std::unique_ptr<UringConnection> > uringConnections; //The clients served by the io_uring engine.
+        std::vector<char> uringBuffers; //The memory of the registered buffers, BUFFER_SIZE bytes each.
+        std::vector<int> freeUringBuffers; //The indexes of the registered buffers not in use.
+        std::deque<int> uringPendingClients; //Clients accepted by the multishot accept after the acceptor became full.
+        bool uringAcceptArmed; //Whether the multishot accept is active.
+        bool uringQuitting; //Raised when the poll on the self pipe completes.
+    };
+
+    /**
+     * Performs a bind and listen operations on the socket of 'acceptor' on port 'port'.
      *
+     * @param[in] acceptor
      * @param[in] The port to bind.
+     * @param[in] reusePort Whether SO_REUSEPORT is set, so several acceptors can listen on the same port.
      * @return true if the bind and listen operations were successful, false otherwise.
      */
-    bool bindAndListen(int port);
+    bool bindAndListen(Acceptor& acceptor, int port, bool reusePort);
 
     /**
-     * Method to serve a client with a socket descriptor 'socketDecriptor'.
+     * Closes the listening sockets and releases all the acceptors.
+     */
+    void closeAcceptors();
+
+    /**
+     * Method to serve a client with a socket descriptor 'socketDecriptor', and then the clients waiting in the queue of 'acceptor', if any.
      * This method blocks for a specific amount of time that is sent by the client.
      * However, if 'stop' is called in the middle of the sleeping time, this call returns immediately.
      *
+     * @param[in] acceptor The acceptor that accepted the client.
+     * @param[in] socketClientDescriptor The socket descriptor of the client.
+     */
+    void runClient(Acceptor& acceptor, int socketClientDescriptor);
+
+    /**
+     * Serves the requests of the client with a socket descriptor 'socketDecriptor' until the connection has to be closed. The requests
+     * sleep in a queue ordered by their expiration, and the messages keep being read meanwhile, so the requests with an id are answered
+     * as soon as each one of them expires, even out of order.
+     * The connection is closed when the remote peer closes it, 'stop' is called, or there are no requests left and the connection
+     * is neither multiplexed (its requests carry an id) nor keep-alive. A keep-alive or multiplexed connection is also closed once
+     * it stays idle for 'ServerOptions::keepAliveTimeOut', if it is not zero.
+     *
      * @param[in] socketClientDescriptor The socket descriptor of the client.
      */
-    void runClient(int socketClientDescriptor);
+    void serveConnection(int socketClientDescriptor);
 
     /**
-     * Performs an accept call. For each new connection, it creates a new thread to serve it and increases 'currentNumberClients_'.
+     * Waits for the socket 'socketClientDescriptor' to be writable and writes the response to a request.
      *
+     * @param[in] socketClientDescriptor
+     * @param[in] format The format of the request, which is also the format of the response.
+     * @param[in] sleepingTime The sleeping time of the request, which is written back increased by one.
+     * @param[in] requestId
+     * @param[out] responseSize The size of the response.
+     * @return true if the response was written successfully, false otherwise.
+     */
+    bool writeResponse(int socketClientDescriptor, FrameFormat format, long sleepingTime, uint32_t requestId, size_t& responseSize);
+
+    /**
+     * Performs an accept call on the listener of 'acceptor'. For each new connection, it creates a new thread (or hands it off to 'workerPool_') to serve it
+     * and increases 'currentNumberClients_'.
+     *
+     * @param[in] acceptor
      * @return true if the accept operation was successful, false otherwise.
      */
-    bool doAccept();
+    bool doAccept(Acceptor& acceptor);
 
     /**
-     * Checks whether the maximum number of clients has been reached. In that case, the call blocks until one or several clients finish or
+     * Checks whether the share of the concurrency limit of 'acceptor' has been reached. In that case, the call blocks until one or several of its clients finish or
      * until the 'quitSignal_' flag is raised.
      *
-     * @return true if the 'quitSignal_' flag is raised, false the current number of clients(currentNumberClients_) is less than the maximum number of clients allowed (maxNumberClients_).
+     * @param[in] acceptor
+     * @return true if the 'quitSignal_' flag is raised, false if the number of clients of 'acceptor' is less than its share.
      */
-    bool checkForMaximumNumberClients();
+    bool checkForMaximumNumberClients(Acceptor& acceptor);
 
     /**
-     * Waits for all the current clients to finish and clears the flag 'isRunning_' to notify on 'clientsCV_'.
+     * Counts the new client 'socketClientDescriptor' in the limits of its source address. If the address is over them, the client is rejected.
+     *
+     * @param[in] socketClientDescriptor
+     * @param[in] clientAddress The address returned by the accept call, or nullptr to query it.
+     * @return true if the client is allowed, false if it was rejected.
      */
-    void waitForClientsToFinish();
+    bool admitSource(int socketClientDescriptor, const struct sockaddr_in* clientAddress);
 
     /**
-     * Closes the socket client descriptor and decreases 'currentNumberClients_' to notify on 'clientsCV_'.
+     * Answers the client 'socketClientDescriptor' with a busy message and closes it, without counting it as a client.
      *
-     * @param[in] socketClientDescriptor The socket file descriptor to be closed.
+     * @param[in] socketClientDescriptor
      */
-    void closeClientAndNotify(int socketClientDescriptor);
+    void rejectClient(int socketClientDescriptor);
 
     /**
-     * Place the current thread to sleep for the number of milliseconds specified in 'buffer'. However, the call will return immediately if 'stop' is called from
-     * another thread or if the remote client closes the connection. It also modifies 'buffer' by increasing the initial number of milliseconds by one.
+     * Queues the client 'socketClientDescriptor' if 'acceptor' is full. The clients dropped by the queue are rejected.
      *
-     * @param[in] The socket descriptor of the remote client.
-     * @param[in/out] buffer The string containing the number of milliseconds to sleep. If the thread slept the specified time, this string will be modified to contain the initial number increased by one.
-     * @return true if 'stop' call was performed while sleeping or the peer closed the connection, false if the current thread was capable of sleeping for the time specified in 'buffer', in which
-     *         case 'buffer' will be modified to contain the initial number of milliseconds increased by one.
+     * @param[in] acceptor
+     * @param[in] socketClientDescriptor
+     * @return true if the client was queued or rejected, false if 'acceptor' is not full, so the client has to be served.
      */
-    bool sleep(int socketClientDescriptor, char buffer[BUFFER_SIZE]);
+    bool queueClient(Acceptor& acceptor, int socketClientDescriptor);
 
     /**
-     * Raises the flag 'quitSignal_' and writes to the 'write' end of the pipe (pipeDescriptor_[1]).
+     * Reads the priority and the deadline of the first request of a client, without consuming it.
+     *
+     * @param[in] socketClientDescriptor
+     * @param[out] priority
+     * @param[out] deadline
+     * @return true if the first request was already received, false otherwise.
+     */
+    static bool peekFirstRequest(int socketClientDescriptor, Priority& priority, std::chrono::milliseconds& deadline);
+
+    /**
+     * @param[in] acceptor
+     * @return true if one more client of 'Priority::BULK' fits in the share of 'ServerOptions::bulkShare'. The caller must hold 'mutex_'.
+     */
+    bool isBulkAllowed(const Acceptor& acceptor) const;
+
+    /**
+     * Takes the next client waiting in the queue of 'acceptor', if it is not full, and counts it as one of its clients. The clients
+     * of 'Priority::BULK' are skipped if their share is used up. The clients dropped by the queue are rejected.
+     *
+     * @param[in] acceptor
+     * @return The socket descriptor of the client, or -1 if there is none or the 'quitSignal_' flag is raised.
+     */
+    int admitWaitingClient(Acceptor& acceptor);
+
+    /**
+     * Rejects 'socketClientDescriptors', which are not counted as clients.
+     *
+     * @param[in] socketClientDescriptors
+     */
+    void rejectClients(const std::vector<int>& socketClientDescriptors);
+
+    /**
+     * Closes the clients left in the queue of 'acceptor'.
+     *
+     * @param[in] acceptor
+     */
+    void closeWaitingClients(Acceptor& acceptor);
+
+    /**
+     * @return true if 'acceptor' reached its share of the current concurrency limit, false otherwise.
+     */
+    bool isAcceptorFull(const Acceptor& acceptor) const;
+
+    /**
+     * @param[in] acceptor
+     * @return The share of 'acceptor' of the current concurrency limit, at least one client. The caller must hold 'mutex_'.
+     */
+    size_t getAcceptorLimit(const Acceptor& acceptor) const;
+
+    /**
+     * Feeds 'limiter_' with the lateness of a response written now, and notifies on 'clientsCV_' if the limit grows.
+     *
+     * @param[in] expiration When the sleeping time of the request expired.
+     */
+    void recordLateness(const std::chrono::steady_clock::time_point& expiration);
+
+    /**
+     * Adds a load to 'topClients_', if it tracks the clients.
+     *
+     * @param[in] load
+     */
+    void recordLoad(const ClientLoad& load);
+
+    /**
+     * @param[in] socketClientDescriptor
+     * @return The IPv4 address of the remote peer, in network byte order, or 0 if it is not known.
+     */
+    static uint32_t getClientAddress(int socketClientDescriptor);
+
+    /**
+     * @return The CPU time used by the calling thread so far, or 0 if 'topClients_' does not track the clients, so the time is not
+     * read for nothing.
+     */
+    std::chrono::microseconds getThreadCpuTime() const;
+
+    /**
+     * Waits for all the current clients of 'acceptor' to finish and decreases 'numberRunningAcceptors_' to notify on 'clientsCV_'.
+     *
+     * @param[in] acceptor
+     */
+    void waitForClientsToFinish(Acceptor& acceptor);
+
+    /**
+     * Closes the socket client descriptor and decreases 'currentNumberClients_' to notify on 'clientsCV_'.
+     *
+     * @param[in] acceptor The acceptor that accepted the client.
+     * @param[in] socketClientDescriptor The socket file descriptor to be closed.
+     */
+    void closeClientAndNotify(Acceptor& acceptor, int socketClientDescriptor);
+
+    /**
+     * Raises the flag 'quitSignal_' and notifies 'wakeup_'.
      */
     void quitRunningThread();
 
     /**
-     * Blocks the current thread until the flag 'isRunning_' is cleared.
+     * Blocks the current thread until all the accept loops finish.
      */
     void waitForRunningThread();
 
     /**
-     * The method executed by the server to attend connections. It will be executed until a call to 'stop' is performed.
+     * The method executed by each acceptor to attend connections. It will be executed until a call to 'stop' is performed.
+     *
+     * @param[in] acceptor
+     */
+    void run(Acceptor& acceptor);
+
+    /**
+     * Checks that the kernel supports all the io_uring operations and flags used by 'ServerMode::IO_URING', on a ring of its own.
+     *
+     * @return true if they are supported, false if the server has to fall back to another mode.
+     */
+    static bool isUringSupported();
+
+    /**
+     * Marks all the clients of 'acceptor' as closing and cancels all the pending operations of its ring, so the io_uring loop ends
+     * once they complete.
+     *
+     * @param[in] acceptor
+     */
+    void quitUring(Acceptor& acceptor);
+
+    /**
+     * Creates the event loop of 'acceptor' in 'ServerMode::REACTOR' mode, watching its listener and the self pipe.
+     *
+     * @param[in] acceptor
+     * @return true if the loop was initialised successfully, false otherwise.
+     */
+    bool initReactor(Acceptor& acceptor);
+
+    /**
+     * The method executed by each acceptor in 'ServerMode::REACTOR' mode. It will be executed until a call to 'stop' is performed.
+     *
+     * @param[in] acceptor
+     */
+    void runReactor(Acceptor& acceptor);
+
+    /**
+     * Accepts all the pending connections while the maximum number of clients is not reached. Once it is reached, the listener
+     * is removed from the events watched by the loop of 'acceptor' until one of its clients finishes.
+     *
+     * @param[in] acceptor The acceptor that owns the reactor loop.
+     * @return false if the accept call failed, true otherwise.
+     */
+    bool acceptReactorClients(Acceptor& acceptor);
+
+    /**
+     * Registers the accepted client 'socketClientDescriptor' in the reactor loop of 'acceptor'. It must be already counted as a client.
+     *
+     * @param[in] acceptor
+     * @param[in] socketClientDescriptor
+     */
+    void startReactorClient(Acceptor& acceptor, int socketClientDescriptor);
+
+    /**
+     * Advances the state machine of 'connection' when its socket is ready.
+     *
+     * @param[in] acceptor The acceptor that owns the reactor loop.
+     * @param[in] connection
+     * @param[in] events The epoll events reported for the socket of 'connection'.
+     */
+    void onReactorClientEvent(Acceptor& acceptor, Connection& connection, uint32_t events);
+
+    /**
+     * Reads the available bytes of the next message with a sleeping time. Once the whole message is read, a sleeping timer is
+     * started for the request.
+     *
+     * @param[in] acceptor The acceptor that owns the reactor loop.
+     * @param[in] connection
+     * @return false if 'connection' was closed, true otherwise.
+     */
+    bool readReactorClient(Acceptor& acceptor, Connection& connection);
+
+    /**
+     * Queues the response of a request whose sleeping time expired and writes the pending responses.
+     *
+     * @param[in] acceptor The acceptor that owns the reactor loop.
+     * @param[in] connection
+     * @param[in] format The format of the request.
+     * @param[in] sleepingTime
+     * @param[in] requestId
      */
-    void run();
+    void answerReactorClient(Acceptor& acceptor, Connection& connection, FrameFormat format, long sleepingTime, uint32_t requestId);
+
+    /**
+     * Writes the pending bytes of the queued responses. Once all of them are written and no request is sleeping, the client is closed,
+     * unless the connection is multiplexed or keep-alive, in which case the idle timer is started.
+     *
+     * @param[in] acceptor The acceptor that owns the reactor loop.
+     * @param[in] connection
+     * @return false if 'connection' was closed, true otherwise.
+     */
+    bool writeReactorClient(Acceptor& acceptor, Connection& connection);
+
+    /**
+     * Unregisters and closes 'connection', and watches the listener again if it was removed because the server was full.
+     *
+     * @param[in] acceptor The acceptor that owns the reactor loop.
+     * @param[in] connection
+     */
+    void closeReactorClient(Acceptor& acceptor, Connection& connection);
+
+    /**
+     * The method executed by each acceptor in 'ServerMode::COROUTINE' mode. It will be executed until a call to 'stop' is performed,
+     * which cancels every suspended coroutine.
+     *
+     * @param[in] acceptor
+     */
+    void runCoroutines(Acceptor& acceptor);
+
+    /**
+     * Spawns 'acceptCoroutineClients' in the scheduler of 'acceptor'. The scheduler quits once it finishes, unless it only paused
+     * because the acceptor is full.
+     *
+     * @param[in] acceptor
+     */
+    void startCoroutineAcceptor(Acceptor& acceptor);
+
+    /**
+     * Accepts connections and spawns 'serveCoroutineClient' for each one of them, until the acceptor is full or the scheduler is cancelled.
+     * Once the acceptor is full, it finishes, and the first client to finish starts it again.
+     *
+     * @param[in] acceptor
+     * @return true if it paused because the acceptor is full, false if it was cancelled or the accept call failed.
+     */
+    Task<bool> acceptCoroutineClients(Acceptor& acceptor);
+
+    /**
+     * Spawns 'serveCoroutineClient' for the accepted client 'socketClientDescriptor', which must be already counted as a client.
+     * Once it finishes, the next waiting client is started, or the accept loop is started again if it paused.
+     *
+     * @param[in] acceptor
+     * @param[in] socketClientDescriptor
+     */
+    void startCoroutineClient(Acceptor& acceptor, int socketClientDescriptor);
+
+    /**
+     * The coroutine equivalent to 'serveConnection': reads a message, sleeps, and writes the response, suspending instead of blocking.
+     * The requests of a connection are answered in order. A sleeping client only holds its coroutine frame, since the message
+     * buffer is released while it sleeps.
+     *
+     * @param[in] acceptor
+     * @param[in] socketClientDescriptor
+     * @return true if the client was served until the connection had to be closed, false if it failed or it was cancelled.
+     */
+    Task<bool> serveCoroutineClient(Acceptor& acceptor, int socketClientDescriptor);
+
+    /**
+     * The method executed by each acceptor in 'ServerMode::IO_URING' mode. It will be executed until a call to 'stop' is performed.
+     * A poll on the self pipe is submitted along with the rest of operations. Once it completes, every pending operation is
+     * cancelled with IORING_OP_ASYNC_CANCEL.
+     *
+     * @param[in] acceptor
+     */
+    void runUring(Acceptor& acceptor);
+
+    /**
+     * Submits a multishot accept on the listener of 'acceptor'.
+     */
+    void armUringAccept(Acceptor& acceptor);
+
+    /**
+     * Increases 'currentNumberClients_' and submits the read of the message with the sleeping time.
+     *
+     * @param[in] acceptor
+     * @param[in] socketClientDescriptor
+     */
+    void startUringClient(Acceptor& acceptor, int socketClientDescriptor);
+
+    /**
+     * Starts the sleeping time of the request at the beginning of the buffer of 'connection', along with the detection of the remote
+     * peer closing the connection. If the buffer does not contain a whole request yet, the read of the rest of it is submitted instead.
+     * The requests of a multiplexed connection all start at once, and the read of the next ones is submitted right away.
+     *
+     * @param[in] acceptor
+     * @param[in] connection
+     * @return true if the operations were submitted successfully, false if 'connection' has to be closed.
+     */
+    bool startUringRequest(Acceptor& acceptor, UringConnection& connection);
+
+    /**
+     * Starts the sleeping time of a request of a multiplexed connection in a 'UringRequest' of its own.
+     *
+     * @param[in] acceptor
+     * @param[in] connection
+     * @param[in] format
+     * @param[in] sleepingTime
+     * @param[in] requestId
+     * @return true if the timeout was submitted, false otherwise.
+     */
+    bool submitUringSleep(Acceptor& acceptor, UringConnection& connection, FrameFormat format, long sleepingTime, uint32_t requestId);
+
+    /**
+     * Queues the response of 'request' once its sleeping time expires, and releases the request.
+     *
+     * @param[in] acceptor
+     * @param[in] request
+     * @param[in] result The result of its IORING_OP_TIMEOUT operation.
+     */
+    void answerUringRequest(Acceptor& acceptor, UringRequest& request, int result);
+
+    /**
+     * Submits the write of the queued responses of a multiplexed connection, unless one is already pending.
+     *
+     * @param[in] acceptor
+     * @param[in] connection
+     * @return true if there was nothing to write or the write was submitted, false otherwise.
+     */
+    bool submitUringResponses(Acceptor& acceptor, UringConnection& connection);
+
+    /**
+     * Submits the keep-alive timeout of a multiplexed connection once it has no request sleeping nor response to write. Its read
+     * stays pending while the requests sleep, so the timeout is not linked to it and closes the connection by itself.
+     *
+     * @param[in] acceptor
+     * @param[in] connection
+     * @return true if the connection is busy, the timeout is already pending or it was submitted, false otherwise.
+     */
+    bool armUringIdleTimeOut(Acceptor& acceptor, UringConnection& connection);
+
+    /**
+     * Submits the read (URING_READ) or the write (URING_WRITE) of the pending bytes of the buffer of 'connection'.
+     *
+     * @param[in] acceptor
+     * @param[in] connection
+     * @param[in] operation
+     * @return true if the operation was submitted, false otherwise.
+     */
+    bool submitUringTransfer(Acceptor& acceptor, UringConnection& connection, uint64_t operation);
+
+    /**
+     * Submits the cancellation of the operation identified by 'userData'.
+     *
+     * @param[in] acceptor
+     * @param[in] userData
+     */
+    void submitUringCancel(Acceptor& acceptor, uint64_t userData);
+
+    /**
+     * Dispatches a completion of the io_uring instance.
+     *
+     * @param[in] acceptor
+     * @param[in] cqe
+     */
+    void handleUringCompletion(Acceptor& acceptor, const struct io_uring_cqe& cqe);
+
+    /**
+     * Advances the state machine of 'connection' with the result of one of its operations.
+     *
+     * @param[in] acceptor
+     * @param[in] connection
+     * @param[in] operation
+     * @param[in] result The result of the operation.
+     */
+    void handleUringClientCompletion(Acceptor& acceptor, UringConnection& connection, uint64_t operation, int result);
+
+    /**
+     * Cancels the pending operations of 'connection' and releases it once all of them complete.
+     *
+     * @param[in] acceptor
+     * @param[in] connection
+     */
+    void closeUringClient(Acceptor& acceptor, UringConnection& connection);
+
+    /**
+     * @return The buffer used by 'connection' to read or write.
+     */
+    char* getUringBuffer(Acceptor& acceptor, UringConnection& connection);
+
+    /**
+     * Gives back the registered buffer of 'connection', if any.
+     */
+    void releaseUringBuffer(Acceptor& acceptor, UringConnection& connection);
+
+    ServerOptions options_;
     size_t maxNumberClients_; //The maximum number of parallel clients allowed.
     size_t currentNumberClients_; //The current number of parallel connected clients.
-    int serverSocketDescriptor_; //The socket descriptor for this server.
-    bool isRunning_; //Whether the server thread is running.
+    ConcurrencyLimiter limiter_; //The current number of parallel clients allowed. Protected by 'mutex_'.
+    SourceLimiter sourceLimiter_; //The connections of each source address. Every accepted client is released from it before being closed.
+    TopClients topClients_; //The load of the source addresses with the highest one.
+    size_t numberRunningAcceptors_; //The number of accept loops still running.
+    size_t numberWaitingClients_; //The clients in the queues of all the acceptors.
+    size_t numberDroppedClients_; //The clients dropped by the queues of all the acceptors.
     bool quitSignal_; //Will be raised when 'stop' is called.
-    std::thread serverThread_; //The running thread
+    std::vector<std::unique_ptr<Acceptor> > acceptors_; //The listening sockets, each one with its own thread.
     mutable std::mutex mutex_; //To notify on 'clientsCV_'
     std::condition_variable clientsCV_; //Will block when 'currentNumberClients_ >= maxNumberClients_'
-    int pipeDescriptors_[2]; //The file descriptors involved in the 'Self pipe trick'
+    Wakeup wakeup_; //The file descriptor involved in the 'Self pipe trick'
+    std::unique_ptr<ThreadPool> workerPool_; //The threads that serve the clients in 'ServerMode::WORKER_POOL' mode.
 };
 
 }
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <vector>
+#include "source_limiter.h"
+
+namespace pipetrick
+{
+
+namespace
+{
+
+const size_t MIN_SWEEP_SIZE = 64;
+const size_t EVICTION_DIVISOR = 8; //A full table forgets an eighth of its addresses at once.
+
+}
+
+SourceLimiter::SourceLimiter(const SourceLimitOptions& options)
+: options_(options)
+, sweepSize_(MIN_SWEEP_SIZE)
+, numberRejections_(0)
+, numberDroppedSources_(0)
+{
+    options_.burst = std::max<size_t>(1, options_.burst);
+    options_.maxSources = std::max<size_t>(1, options_.maxSources);
+    sweepSize_ = std::min(sweepSize_, options_.maxSources);
+}
+
+bool SourceLimiter::isEnabled() const
+{
+    return options_.rate > 0 || options_.maxConnections > 0;
+}
+
+bool SourceLimiter::acquire(int connection, uint32_t address, const Clock::time_point& now)
+{
+    std::scoped_lock lock(mutex_);
+    if (sources_.size() >= sweepSize_)
+    {
+        sweep(now);
+    }
+
+    auto existingSource = sources_.find(address);
+    if (existingSource == sources_.end())
+    {
+        if (sources_.size() >= options_.maxSources)
+        {
+            numberDroppedSources_++;
+            return true;
+        }
+        existingSource = sources_.emplace(address, Source{static_cast<double>(options_.burst), now, 0, now}).first;
+    }
+
+    Source& source = existingSource->second;
+    source.lastSeen = now;
+    refill(source, now);
+    if ((options_.maxConnections > 0 && source.connections >= options_.maxConnections) || (options_.rate > 0 && source.tokens < 1))
+    {
+        numberRejections_++;
+        return false;
+    }
+
+    if (options_.rate > 0)
+    {
+        source.tokens--;
+    }
+    source.connections++;
+    connections_[connection] = address;
+    return true;
+}
+
+void SourceLimiter::release(int connection)
+{
+    std::scoped_lock lock(mutex_);
+    auto address = connections_.find(connection);
+    if (address == connections_.end())
+    {
+        return;
+    }
+
+    auto source = sources_.find(address->second);
+    if (source != sources_.end() && source->second.connections > 0)
+    {
+        source->second.connections--;
+    }
+    connections_.erase(address);
+}
+
+size_t SourceLimiter::getNumberOfSources() const
+{
+    std::scoped_lock lock(mutex_);
+    return sources_.size();
+}
+
+size_t SourceLimiter::getNumberOfRejections() const
+{
+    std::scoped_lock lock(mutex_);
+    return numberRejections_;
+}
+
+size_t SourceLimiter::getNumberOfDroppedSources() const
+{
+    std::scoped_lock lock(mutex_);
+    return numberDroppedSources_;
+}
+
+void SourceLimiter::refill(Source& source, const Clock::time_point& now) const
+{
+    if (options_.rate > 0)
+    {
+        double elapsed = std::chrono::duration<double>(now - source.lastRefill).count();
+        source.tokens = std::min(static_cast<double>(options_.burst), source.tokens + elapsed * options_.rate);
+    }
+    source.lastRefill = now;
+}
+
+void SourceLimiter::sweep(const Clock::time_point& now)
+{
+    for (auto source = sources_.begin(); source != sources_.end(); )
+    {
+        refill(source->second, now);
+        if (source->second.connections == 0 && source->second.tokens >= options_.burst)
+        {
+            source = sources_.erase(source);
+        }
+        else
+        {
+            ++source;
+        }
+    }
+
+    if (sources_.size() >= options_.maxSources)
+    {
+        std::vector<std::unordered_map<uint32_t, Source>::iterator> idleSources;
+        for (auto source = sources_.begin(); source != sources_.end(); ++source)
+        {
+            if (source->second.connections == 0)
+            {
+                idleSources.push_back(source);
+            }
+        }
+
+        size_t numberEvictions = std::min(idleSources.size(), sources_.size() - options_.maxSources + std::max<size_t>(1, options_.maxSources / EVICTION_DIVISOR));
+        std::nth_element(idleSources.begin(), idleSources.begin() + numberEvictions, idleSources.end(), [](const auto& first, const auto& second)
+        {
+            return first->second.lastSeen < second->second.lastSeen;
+        });
+        for (size_t i = 0; i < numberEvictions; i++)
+        {
+            sources_.erase(idleSources[i]);
+        }
+        numberDroppedSources_ += numberEvictions;
+    }
+    sweepSize_ = std::min(options_.maxSources, std::max(MIN_SWEEP_SIZE, 2 * sources_.size()));
+}
+
+}
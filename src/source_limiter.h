@@ -0,0 +1,123 @@
+#ifndef PT_SOURCE_LIMITER_H
+#define PT_SOURCE_LIMITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+namespace pipetrick
+{
+
+/**
+ * Optional settings of a 'SourceLimiter'. The default values do not limit anything.
+ */
+struct SourceLimitOptions
+{
+    double rate = 0; //The new connections per second allowed to each source address, refilled continuously. Zero means no rate limit.
+    size_t burst = 10; //The new connections a source address can open back to back before 'rate' applies.
+    size_t maxConnections = 0; //The maximum number of connections of each source address at the same time. Zero means no limit.
+    size_t maxSources = 65536; //The maximum number of source addresses in the table, which bounds its memory whatever the number of hosts.
+};
+
+/**
+ * Limits the connections of each source address with a token bucket for the new connections and a cap on the open connections.
+ * The addresses without open connections are forgotten once their bucket is full again, so the table only holds the active ones.
+ * If the active ones reach 'SourceLimitOptions::maxSources', the ones without open connections seen least recently are forgotten
+ * too, which refills their buckets. If all of them have open connections, the new addresses are allowed without being tracked.
+ * Thread safe.
+ */
+class SourceLimiter
+{
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @param[in] options
+     */
+    explicit SourceLimiter(const SourceLimitOptions& options = SourceLimitOptions());
+
+    SourceLimiter(const SourceLimiter&) = delete;
+    SourceLimiter& operator=(const SourceLimiter&) = delete;
+
+    /**
+     * @return true if 'SourceLimitOptions' limits something.
+     */
+    bool isEnabled() const;
+
+    /**
+     * Counts the new connection 'connection' of 'address' if it is within its limits.
+     *
+     * @param[in] connection The socket descriptor of the connection.
+     * @param[in] address The IPv4 address, in network byte order.
+     * @param[in] now
+     * @return true if the connection is allowed, and has to be released by 'release', false if 'address' is over one of its limits.
+     */
+    bool acquire(int connection, uint32_t address, const Clock::time_point& now);
+
+    /**
+     * Finishes a connection allowed by 'acquire'. Nothing happens if it was not allowed.
+     *
+     * @param[in] connection
+     */
+    void release(int connection);
+
+    /**
+     * @return The number of source addresses in the table.
+     */
+    size_t getNumberOfSources() const;
+
+    /**
+     * @return The number of connections refused by 'acquire'.
+     */
+    size_t getNumberOfRejections() const;
+
+    /**
+     * @return The number of source addresses forgotten or not tracked because the table was full.
+     */
+    size_t getNumberOfDroppedSources() const;
+
+private:
+
+    /**
+     * The state of one source address.
+     */
+    struct Source
+    {
+        double tokens; //The new connections allowed right now.
+        Clock::time_point lastRefill;
+        size_t connections; //The connections allowed and not released yet.
+        Clock::time_point lastSeen; //The last new connection of the address, allowed or not.
+    };
+
+    /**
+     * Adds the tokens earned by 'source' since its last refill.
+     *
+     * @param[in] source
+     * @param[in] now
+     */
+    void refill(Source& source, const Clock::time_point& now) const;
+
+    /**
+     * Forgets the addresses without connections whose bucket is full and, if the table is still full, the ones without connections
+     * seen least recently, down to a fraction of 'SourceLimitOptions::maxSources' so the next ones do not sweep again. The caller
+     * must hold 'mutex_'.
+     *
+     * @param[in] now
+     */
+    void sweep(const Clock::time_point& now);
+
+    SourceLimitOptions options_;
+    mutable std::mutex mutex_;
+    std::unordered_map<uint32_t, Source> sources_;
+    std::unordered_map<int, uint32_t> connections_; //The address of each connection allowed and not released yet.
+    size_t sweepSize_; //The size of 'sources_' that triggers the next sweep, so the sweeps are amortised.
+    size_t numberRejections_;
+    size_t numberDroppedSources_;
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "thread_pool.h"
+
+namespace pipetrick
+{
+
+ThreadPool::ThreadPool(size_t numThreads, size_t queueCapacity)
+: numThreads_(numThreads)
+, queueCapacity_(queueCapacity)
+, stopped_(true)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::start()
+{
+    std::scoped_lock lock(mutex_);
+    if (!stopped_)
+    {
+        return;
+    }
+
+    stopped_ = false;
+    for (size_t i = 0; i < numThreads_; i++)
+    {
+        workers_.emplace_back(&ThreadPool::runWorker, this);
+    }
+}
+
+bool ThreadPool::submit(Task task)
+{
+    std::scoped_lock lock(mutex_);
+    if (stopped_ || tasks_.size() >= queueCapacity_)
+    {
+        return false;
+    }
+
+    tasks_.push_back(std::move(task));
+    tasksCV_.notify_one();
+    return true;
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::scoped_lock lock(mutex_);
+        stopped_ = true;
+        tasksCV_.notify_all();
+    }
+
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        workers_[i].join();
+    }
+    workers_.clear();
+}
+
+size_t ThreadPool::getQueueSize() const
+{
+    std::scoped_lock lock(mutex_);
+    return tasks_.size();
+}
+
+void ThreadPool::runWorker()
+{
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            tasksCV_.wait(lock, [this]()
+            {
+                return stopped_ || !tasks_.empty();
+            });
+
+            if (tasks_.empty())
+            {
+                return;
+            }
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+}
@@ -0,0 +1,77 @@
+#ifndef PT_THREAD_POOL_H
+#define PT_THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+
+namespace pipetrick
+{
+
+/**
+ * A fixed set of pre-started threads that execute the tasks handed off through a bounded queue.
+ */
+class ThreadPool
+{
+public:
+
+    using Task = std::function<void()>;
+
+    /**
+     * Constructor.
+     *
+     * @param[in] numThreads The number of worker threads.
+     * @param[in] queueCapacity The maximum number of tasks waiting for a free worker.
+     */
+    ThreadPool(size_t numThreads, size_t queueCapacity);
+
+    /**
+     * Calls 'stop'.
+     */
+    ~ThreadPool();
+
+    /**
+     * Starts the worker threads.
+     */
+    void start();
+
+    /**
+     * Hands off 'task' to the workers. This call never blocks.
+     *
+     * @param[in] task
+     * @return true if the task was queued, false if the queue is full or the pool is stopped.
+     */
+    bool submit(Task task);
+
+    /**
+     * Waits for the queued tasks to be executed and joins the worker threads.
+     */
+    void stop();
+
+    /**
+     * @return The number of tasks waiting for a free worker.
+     */
+    size_t getQueueSize() const;
+
+private:
+
+    /**
+     * The method executed by each worker thread. It executes queued tasks until 'stop' is called and the queue is empty.
+     */
+    void runWorker();
+
+    size_t numThreads_;
+    size_t queueCapacity_;
+    bool stopped_; //Raised by 'stop'.
+    std::vector<std::thread> workers_;
+    std::deque<Task> tasks_; //The tasks waiting for a free worker.
+    mutable std::mutex mutex_;
+    std::condition_variable tasksCV_; //Notified when a task is queued or when 'stop' is called.
+};
+
+}
+
+#endif
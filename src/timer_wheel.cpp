@@ -0,0 +1,239 @@
+#include "timer_wheel.h"
+
+namespace pipetrick
+{
+
+const TimerWheel::TimerId TimerWheel::INVALID_TIMER = 0;
+const uint64_t TimerWheel::MAX_DELAY = (1ULL << 31) - 1;
+
+namespace
+{
+const unsigned WORD_BITS = 64;
+}
+
+TimerWheel::TimerWheel()
+: currentTick_(0)
+, size_(0)
+, freeList_(NONE)
+, slots_(LEVELS * SLOTS, NONE)
+, occupied_(LEVELS * SLOTS / WORD_BITS, 0)
+{
+}
+
+TimerWheel::TimerId TimerWheel::add(uint64_t expiration, Handler handler)
+{
+    if (expiration <= currentTick_)
+    {
+        expiration = currentTick_ + 1;
+    }
+    else if (expiration - currentTick_ > MAX_DELAY)
+    {
+        expiration = currentTick_ + MAX_DELAY;
+    }
+
+    uint32_t index = freeList_;
+    if (index == NONE)
+    {
+        index = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back(Node{0, 0, NONE, NONE, NONE, nullptr});
+    }
+    else
+    {
+        freeList_ = nodes_[index].next;
+    }
+
+    Node& node = nodes_[index];
+    node.expiration = expiration;
+    node.handler = std::move(handler);
+    insert(index);
+    size_++;
+
+    return (static_cast<uint64_t>(node.generation) << 32) | (index + 1);
+}
+
+bool TimerWheel::cancel(TimerId timerId)
+{
+    uint64_t position = timerId & 0xFFFFFFFF;
+    if (position == 0 || position > nodes_.size())
+    {
+        return false;
+    }
+
+    uint32_t index = static_cast<uint32_t>(position - 1);
+    Node& node = nodes_[index];
+    if (node.slot == NONE || node.generation != static_cast<uint32_t>(timerId >> 32))
+    {
+        return false;
+    }
+
+    unlink(index);
+    node.generation++;
+    node.handler = nullptr;
+    node.next = freeList_;
+    freeList_ = index;
+    size_--;
+    return true;
+}
+
+void TimerWheel::insert(uint32_t index)
+{
+    Node& node = nodes_[index];
+    unsigned level = 0;
+    while (level < LEVELS - 1 && (node.expiration >> (SLOT_BITS * (level + 1))) != (currentTick_ >> (SLOT_BITS * (level + 1))))
+    {
+        level++;
+    }
+
+    uint32_t slot = level * SLOTS + ((node.expiration >> (SLOT_BITS * level)) & (SLOTS - 1));
+    node.slot = slot;
+    node.previous = NONE;
+    node.next = slots_[slot];
+    if (node.next != NONE)
+    {
+        nodes_[node.next].previous = index;
+    }
+    slots_[slot] = index;
+    occupied_[slot / WORD_BITS] |= 1ULL << (slot % WORD_BITS);
+}
+
+void TimerWheel::unlink(uint32_t index)
+{
+    Node& node = nodes_[index];
+    if (node.previous != NONE)
+    {
+        nodes_[node.previous].next = node.next;
+    }
+    else
+    {
+        slots_[node.slot] = node.next;
+        if (node.next == NONE)
+        {
+            occupied_[node.slot / WORD_BITS] &= ~(1ULL << (node.slot % WORD_BITS));
+        }
+    }
+
+    if (node.next != NONE)
+    {
+        nodes_[node.next].previous = node.previous;
+    }
+    node.slot = NONE;
+}
+
+void TimerWheel::processCurrentTick()
+{
+    //Cascade from the highest level, so the timers moved down can be cascaded again in this same tick.
+    for (unsigned level = LEVELS - 1; level > 0; level--)
+    {
+        if (currentTick_ & ((1ULL << (SLOT_BITS * level)) - 1))
+        {
+            continue;
+        }
+
+        uint32_t slot = level * SLOTS + ((currentTick_ >> (SLOT_BITS * level)) & (SLOTS - 1));
+        while (slots_[slot] != NONE)
+        {
+            uint32_t index = slots_[slot];
+            unlink(index);
+            insert(index);
+        }
+    }
+
+    uint32_t slot = currentTick_ & (SLOTS - 1);
+    while (slots_[slot] != NONE)
+    {
+        uint32_t index = slots_[slot];
+        unlink(index);
+        if (nodes_[index].expiration > currentTick_)
+        {
+            insert(index);
+            continue;
+        }
+
+        //The handler may add or cancel timers, so the node is released before executing it.
+        Handler handler = std::move(nodes_[index].handler);
+        nodes_[index].handler = nullptr;
+        nodes_[index].generation++;
+        nodes_[index].next = freeList_;
+        freeList_ = index;
+        size_--;
+        handler();
+    }
+}
+
+void TimerWheel::advance(uint64_t now)
+{
+    while (currentTick_ < now)
+    {
+        uint64_t next = nextEventTick();
+        if (next > now)
+        {
+            currentTick_ = now;
+            return;
+        }
+
+        currentTick_ = next;
+        processCurrentTick();
+    }
+}
+
+uint32_t TimerWheel::nextSlot(unsigned level) const
+{
+    unsigned start = ((currentTick_ >> (SLOT_BITS * level)) + 1) & (SLOTS - 1);
+    for (unsigned scanned = 0; scanned < SLOTS + WORD_BITS;)
+    {
+        unsigned bit = (start + scanned) & (SLOTS - 1);
+        uint64_t word = occupied_[(level * SLOTS + bit) / WORD_BITS] >> (bit % WORD_BITS);
+        if (word)
+        {
+            return bit + __builtin_ctzll(word);
+        }
+        scanned += WORD_BITS - (bit % WORD_BITS);
+    }
+
+    return NONE;
+}
+
+uint64_t TimerWheel::nextEventTick() const
+{
+    uint64_t next = UINT64_MAX;
+    if (size_ == 0)
+    {
+        return next;
+    }
+
+    for (unsigned level = 0; level < LEVELS; level++)
+    {
+        uint32_t slot = nextSlot(level);
+        if (slot == NONE)
+        {
+            continue;
+        }
+
+        uint64_t levelTick = currentTick_ >> (SLOT_BITS * level);
+        uint64_t distance = (slot - levelTick) & (SLOTS - 1);
+        if (distance == 0)
+        {
+            distance = SLOTS;
+        }
+
+        uint64_t tick = (levelTick + distance) << (SLOT_BITS * level);
+        if (tick < next)
+        {
+            next = tick;
+        }
+    }
+
+    return next;
+}
+
+uint64_t TimerWheel::getCurrentTick() const
+{
+    return currentTick_;
+}
+
+size_t TimerWheel::size() const
+{
+    return size_;
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef PT_TIMER_WHEEL_H
+#define PT_TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+namespace pipetrick
+{
+
+/**
+ * Hierarchical timer wheel. Time is measured in ticks, and a timer is stored in the lowest level whose slots can tell it apart from
+ * the current tick. Timers of the higher levels are moved down (cascaded) when the current tick reaches their slot.
+ * Adding and cancelling a timer are O(1), and the memory of a pending timer does not depend on its delay.
+ */
+class TimerWheel
+{
+public:
+
+    using Handler = std::function<void()>;
+    using TimerId = uint64_t;
+
+    static const TimerId INVALID_TIMER;
+    static const uint64_t MAX_DELAY; //The maximum delay in ticks. Longer delays are truncated.
+
+    TimerWheel();
+
+    /**
+     * Schedules 'handler' to be executed when the wheel is advanced to the tick 'expiration'.
+     *
+     * @param[in] expiration The absolute tick of the expiration. If it is not later than the current tick, the timer expires in the next tick.
+     * @param[in] handler
+     * @return The identifier of the timer, to be used in 'cancel'.
+     */
+    TimerId add(uint64_t expiration, Handler handler);
+
+    /**
+     * Cancels a pending timer. Cancelling an expired or unknown timer has no effect.
+     *
+     * @param[in] timerId
+     * @return true if the timer was pending, false otherwise.
+     */
+    bool cancel(TimerId timerId);
+
+    /**
+     * Executes the handlers of all the timers that expire up to the tick 'now', and makes 'now' the current tick.
+     *
+     * @param[in] now
+     */
+    void advance(uint64_t now);
+
+    /**
+     * @return The earliest tick at which the wheel has work to do (either a timer expires or a higher level slot has to be cascaded),
+     *         or UINT64_MAX if there are no pending timers.
+     */
+    uint64_t nextEventTick() const;
+
+    /**
+     * @return The current tick.
+     */
+    uint64_t getCurrentTick() const;
+
+    /**
+     * @return The number of pending timers.
+     */
+    size_t size() const;
+
+private:
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr unsigned LEVELS = 4;
+    static constexpr unsigned SLOT_BITS = 8;
+    static constexpr unsigned SLOTS = 1 << SLOT_BITS;
+
+    struct Node
+    {
+        uint64_t expiration;
+        uint32_t generation; //Increased every time the node is released, so stale identifiers do not cancel a reused node.
+        uint32_t slot; //The index in 'slots_' of the list that contains this node, or NONE if the node is free.
+        uint32_t previous;
+        uint32_t next;
+        Handler handler;
+    };
+
+    /**
+     * Inserts the node 'index' in the slot that corresponds to its expiration.
+     */
+    void insert(uint32_t index);
+
+    /**
+     * Removes the node 'index' from the list of its slot.
+     */
+    void unlink(uint32_t index);
+
+    /**
+     * Moves the timers of the slots reached by 'currentTick_' to the lower levels and executes the expired ones.
+     */
+    void processCurrentTick();
+
+    /**
+     * @return The index of the first non empty slot of 'level' after the current one, in circular order, or NONE if the level is empty.
+     */
+    uint32_t nextSlot(unsigned level) const;
+
+    uint64_t currentTick_;
+    size_t size_;
+    uint32_t freeList_; //The first released node, linked through 'Node::next'.
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> slots_; //The first node of each slot, LEVELS * SLOTS entries.
+    std::vector<uint64_t> occupied_; //One bit per slot, set when the slot is not empty.
+};
+
+}
+
+#endif
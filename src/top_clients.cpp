@@ -0,0 +1,117 @@
+#include <algorithm>
+#include "top_clients.h"
+
+namespace pipetrick
+{
+
+TopClients::TopClients(const TopClientsOptions& options)
+: options_(options)
+{
+    clients_.reserve(options_.capacity);
+    indexes_.reserve(options_.capacity);
+}
+
+bool TopClients::isEnabled() const
+{
+    return options_.capacity > 0;
+}
+
+void TopClients::add(const ClientLoad& load)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    std::scoped_lock lock(mutex_);
+    auto index = indexes_.find(load.address);
+    if (index == indexes_.end())
+    {
+        uint64_t weight = getWeight(load);
+        if (clients_.size() < options_.capacity)
+        {
+            index = indexes_.emplace(load.address, clients_.size()).first;
+            clients_.push_back(ClientLoad{load.address});
+        }
+        else if (weight == 0)
+        {
+            //Nothing to rank it by, so it does not replace anyone.
+            return;
+        }
+        else
+        {
+            auto lowest = std::min_element(clients_.begin(), clients_.end(), [this](const ClientLoad& first, const ClientLoad& second)
+            {
+                return getWeight(first) < getWeight(second);
+            });
+            indexes_.erase(lowest->address);
+            index = indexes_.emplace(load.address, lowest - clients_.begin()).first;
+
+            uint64_t lowestWeight = getWeight(*lowest);
+            *lowest = ClientLoad{load.address};
+            lowest->error = lowestWeight;
+            setWeight(*lowest, lowestWeight);
+        }
+    }
+
+    ClientLoad& client = clients_[index->second];
+    client.requests += load.requests;
+    client.delay += load.delay;
+    client.bytes += load.bytes;
+    client.cpuTime += load.cpuTime;
+}
+
+std::vector<ClientLoad> TopClients::getTop(size_t count) const
+{
+    std::vector<ClientLoad> top;
+    {
+        std::scoped_lock lock(mutex_);
+        top = clients_;
+    }
+
+    count = std::min(count, top.size());
+    std::partial_sort(top.begin(), top.begin() + count, top.end(), [this](const ClientLoad& first, const ClientLoad& second)
+    {
+        return getWeight(first) > getWeight(second);
+    });
+    top.resize(count);
+    return top;
+}
+
+uint64_t TopClients::getWeight(const ClientLoad& load) const
+{
+    switch (options_.metric)
+    {
+        case LoadMetric::REQUESTS:
+            return load.requests;
+        case LoadMetric::BYTES:
+            return load.bytes;
+        case LoadMetric::CPU_TIME:
+            return static_cast<uint64_t>(std::max<long>(0, load.cpuTime.count()));
+        case LoadMetric::DELAY:
+        default:
+            return load.delay;
+    }
+}
+
+void TopClients::setWeight(ClientLoad& load, uint64_t weight) const
+{
+    switch (options_.metric)
+    {
+        case LoadMetric::REQUESTS:
+            load.requests = weight;
+            return;
+        case LoadMetric::BYTES:
+            load.bytes = weight;
+            return;
+        case LoadMetric::CPU_TIME:
+            load.cpuTime = std::chrono::microseconds(weight);
+            return;
+        case LoadMetric::DELAY:
+        default:
+            load.delay = weight;
+            return;
+    }
+}
+
+}
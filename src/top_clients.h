@@ -0,0 +1,109 @@
+#ifndef PT_TOP_CLIENTS_H
+#define PT_TOP_CLIENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace pipetrick
+{
+
+/**
+ * The load that ranks the clients in 'TopClients'.
+ */
+enum class LoadMetric
+{
+    REQUESTS,
+    DELAY, //The sleeping time requested, which is the time the client holds its slot.
+    BYTES,
+    CPU_TIME
+};
+
+/**
+ * Optional settings of a 'TopClients'. The default values do not track anything.
+ */
+struct TopClientsOptions
+{
+    size_t capacity = 0; //The number of source addresses tracked, which bounds the memory. Zero means no tracking.
+    LoadMetric metric = LoadMetric::DELAY; //The load that ranks the addresses and decides which one is replaced when the table is full.
+};
+
+/**
+ * The load of one source address.
+ */
+struct ClientLoad
+{
+    uint32_t address = 0; //The IPv4 address, in network byte order.
+    uint64_t requests = 0;
+    uint64_t delay = 0; //The sleeping time requested, in milliseconds.
+    uint64_t bytes = 0; //The bytes of the requests and the responses.
+    std::chrono::microseconds cpuTime = std::chrono::microseconds(0); //The CPU time of the server thread handling the client.
+    uint64_t error = 0; //The most the load of 'TopClientsOptions::metric' can be overestimated, in its own unit.
+};
+
+/**
+ * Finds the source addresses with the highest load with the space-saving algorithm, in a table of a fixed number of addresses,
+ * whatever the number of clients. The load of an address that is not in a full table replaces the address with the lowest load of
+ * 'TopClientsOptions::metric', and starts from that lowest load, which is kept as its error. So an address whose real load is above
+ * the lowest one of the table is never missing from it, and the load of each one is never underestimated. The other loads only count
+ * since the address entered the table.
+ * The replacement scans the table, which is small. Thread safe.
+ */
+class TopClients
+{
+public:
+
+    /**
+     * @param[in] options
+     */
+    explicit TopClients(const TopClientsOptions& options = TopClientsOptions());
+
+    TopClients(const TopClients&) = delete;
+    TopClients& operator=(const TopClients&) = delete;
+
+    /**
+     * @return true if 'TopClientsOptions::capacity' is not zero.
+     */
+    bool isEnabled() const;
+
+    /**
+     * Adds the load of 'load.address'. Its 'error' is ignored.
+     *
+     * @param[in] load
+     */
+    void add(const ClientLoad& load);
+
+    /**
+     * @param[in] count The maximum number of addresses returned.
+     * @return The addresses with the highest load of 'TopClientsOptions::metric', from the highest one.
+     */
+    std::vector<ClientLoad> getTop(size_t count) const;
+
+private:
+
+    /**
+     * @param[in] load
+     * @return The load of 'TopClientsOptions::metric'.
+     */
+    uint64_t getWeight(const ClientLoad& load) const;
+
+    /**
+     * Sets the load of 'TopClientsOptions::metric'.
+     *
+     * @param[out] load
+     * @param[in] weight
+     */
+    void setWeight(ClientLoad& load, uint64_t weight) const;
+
+    TopClientsOptions options_;
+    mutable std::mutex mutex_;
+    std::vector<ClientLoad> clients_; //At most 'TopClientsOptions::capacity'.
+    std::unordered_map<uint32_t, size_t> indexes_; //The position of each address in 'clients_'.
+};
+
+}
+
+#endif
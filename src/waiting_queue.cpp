@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cmath>
+#include "waiting_queue.h"
+
+namespace pipetrick
+{
+
+WaitingQueue::WaitingQueue(size_t capacity, const WaitingQueueOptions& options, Classifier classifier)
+: options_(options)
+, capacity_(std::max<size_t>(1, capacity))
+, classifier_(std::move(classifier))
+, dropping_(false)
+, count_(0)
+, numberDrops_(0)
+{
+}
+
+bool WaitingQueue::push(int socketDescriptor, const Clock::time_point& now)
+{
+    if (waiters_.size() >= capacity_)
+    {
+        numberDrops_++;
+        return false;
+    }
+
+    waiters_.push_back(Waiter{socketDescriptor, now, Priority::NORMAL, Clock::time_point::max(), !classifier_});
+    classify();
+    return true;
+}
+
+bool WaitingQueue::pop(int& socketDescriptor, Priority& priority, const Clock::time_point& now, std::vector<int>& dropped, Priority lowestPriority)
+{
+    drop(now, dropped);
+    auto next = waiters_.end();
+    for (auto waiter = waiters_.begin(); waiter != waiters_.end(); ++waiter)
+    {
+        if (waiter->priority <= lowestPriority && (next == waiters_.end() || isBefore(*waiter, *next)))
+        {
+            next = waiter;
+        }
+    }
+
+    if (next == waiters_.end())
+    {
+        return false;
+    }
+
+    socketDescriptor = next->socketDescriptor;
+    priority = next->priority;
+    waiters_.erase(next);
+    return true;
+}
+
+void WaitingQueue::drop(const Clock::time_point& now, std::vector<int>& dropped)
+{
+    classify();
+    for (auto waiter = waiters_.begin(); waiter != waiters_.end(); )
+    {
+        if (waiter->deadline <= now)
+        {
+            dropped.push_back(waiter->socketDescriptor);
+            waiter = waiters_.erase(waiter);
+            numberDrops_++;
+        }
+        else
+        {
+            ++waiter;
+        }
+    }
+
+    while (!waiters_.empty() && shouldDropOldest(now))
+    {
+        dropped.push_back(removeVictim());
+        numberDrops_++;
+    }
+
+    if (waiters_.empty())
+    {
+        //An empty queue is not a standing queue.
+        firstAboveTime_ = Clock::time_point();
+        dropping_ = false;
+    }
+}
+
+void WaitingQueue::clear(std::vector<int>& socketDescriptors)
+{
+    for (const Waiter& waiter : waiters_)
+    {
+        socketDescriptors.push_back(waiter.socketDescriptor);
+    }
+    waiters_.clear();
+}
+
+size_t WaitingQueue::getSize() const
+{
+    return waiters_.size();
+}
+
+size_t WaitingQueue::getNumberOfDrops() const
+{
+    return numberDrops_;
+}
+
+void WaitingQueue::classify()
+{
+    for (Waiter& waiter : waiters_)
+    {
+        std::chrono::milliseconds deadline(0);
+        if (!waiter.classified && classifier_(waiter.socketDescriptor, waiter.priority, deadline))
+        {
+            waiter.classified = true;
+            //The deadline counts from the arrival, since the time the request spent in flight is unknown.
+            waiter.deadline = deadline.count() > 0 ? waiter.enqueued + deadline : Clock::time_point::max();
+        }
+    }
+}
+
+bool WaitingQueue::isBefore(const Waiter& first, const Waiter& second)
+{
+    if (first.priority != second.priority)
+    {
+        return first.priority < second.priority;
+    }
+
+    if (first.deadline != second.deadline)
+    {
+        return first.deadline < second.deadline;
+    }
+    return first.enqueued < second.enqueued;
+}
+
+bool WaitingQueue::shouldDropOldest(const Clock::time_point& now)
+{
+    if (now - waiters_.front().enqueued < options_.target)
+    {
+        firstAboveTime_ = Clock::time_point();
+        dropping_ = false;
+        return false;
+    }
+
+    if (firstAboveTime_ == Clock::time_point())
+    {
+        firstAboveTime_ = now + options_.interval;
+        return false;
+    }
+
+    if (now < firstAboveTime_)
+    {
+        return false;
+    }
+
+    if (!dropping_)
+    {
+        //Dropping again soon after the last dropping state resumes its rate, instead of starting over.
+        dropping_ = true;
+        count_ = count_ > 2 && now - dropNext_ < 16 * options_.interval ? count_ - 2 : 1;
+        dropNext_ = now;
+    }
+    else if (now < dropNext_)
+    {
+        return false;
+    }
+    else
+    {
+        count_++;
+    }
+
+    //Relative to the scheduled drop, so a queue that was not served for a while catches up with several drops.
+    dropNext_ += std::chrono::duration_cast<Clock::duration>(options_.interval / std::sqrt(static_cast<double>(count_)));
+    return true;
+}
+
+int WaitingQueue::removeVictim()
+{
+    //'waiters_' is in arrival order, so the first one of the lowest class is the oldest of that class.
+    auto victim = waiters_.begin();
+    for (auto waiter = waiters_.begin(); waiter != waiters_.end(); ++waiter)
+    {
+        if (waiter->priority > victim->priority)
+        {
+            victim = waiter;
+        }
+    }
+
+    int socketDescriptor = victim->socketDescriptor;
+    waiters_.erase(victim);
+    return socketDescriptor;
+}
+
+}
@@ -0,0 +1,157 @@
+#ifndef PT_WAITING_QUEUE_H
+#define PT_WAITING_QUEUE_H
+
+#include <stddef.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "common.h"
+
+namespace pipetrick
+{
+
+/**
+ * Optional settings of a 'WaitingQueue'.
+ */
+struct WaitingQueueOptions
+{
+    size_t capacity = 0; //The maximum number of waiting clients. Zero means the maximum number of clients of the acceptor.
+    std::chrono::milliseconds target = std::chrono::milliseconds(5); //The time a client can wait without counting as a standing queue.
+    std::chrono::milliseconds interval = std::chrono::milliseconds(100); //How long the waiting time has to stay above 'target' before the oldest clients are dropped.
+};
+
+/**
+ * A queue of accepted clients waiting for a free slot. They are taken by priority class, and within a class by earliest deadline
+ * first, and then in arrival order. The clients whose deadline passed are dropped.
+ * The queue is managed like CoDel (Controlled Delay): once the time spent in the queue by the oldest client stays above a target for
+ * a whole interval, the oldest clients of the lowest class are dropped, each drop sooner than the previous one (the interval divided
+ * by the square root of the number of drops), until the waiting time goes below the target again.
+ * The operations scan the whole queue, which is at most as long as the clients of an acceptor. Not thread safe.
+ */
+class WaitingQueue
+{
+public:
+
+    using Clock = std::chrono::steady_clock;
+    using Priority = Common::Priority;
+
+    /**
+     * Reads the priority class and the deadline of the first request of a client, without consuming it.
+     *
+     * @param[in] socketDescriptor
+     * @param[out] priority
+     * @param[out] deadline The time the client is willing to wait for the answer. Zero means there is no deadline.
+     * @return true if the request was received, false if it has to be read again later.
+     */
+    using Classifier = std::function<bool(int socketDescriptor, Priority& priority, std::chrono::milliseconds& deadline)>;
+
+    /**
+     * @param[in] capacity The maximum number of waiting clients, at least one.
+     * @param[in] options
+     * @param[in] classifier Empty if all the clients have the same class and no deadline, so they are taken in arrival order.
+     */
+    WaitingQueue(size_t capacity, const WaitingQueueOptions& options = WaitingQueueOptions(), Classifier classifier = Classifier());
+
+    /**
+     * Adds a client at the end of the queue, unless it is full.
+     *
+     * @param[in] socketDescriptor
+     * @param[in] now
+     * @return true if the client was queued, false if the queue is full, which counts as a drop.
+     */
+    bool push(int socketDescriptor, const Clock::time_point& now);
+
+    /**
+     * Takes the first client, in the order of the queue, that is not dropped.
+     *
+     * @param[out] socketDescriptor
+     * @param[out] priority The class of the client taken.
+     * @param[in] now
+     * @param[out] dropped The clients dropped on the way are appended. The caller has to close them.
+     * @param[in] lowestPriority The lowest class that can be taken.
+     * @return true if a client was taken, false if there is none of the classes allowed.
+     */
+    bool pop(int& socketDescriptor, Priority& priority, const Clock::time_point& now, std::vector<int>& dropped, Priority lowestPriority = Priority::BULK);
+
+    /**
+     * Drops the clients whose deadline passed and the ones that the control law drops by now, without taking any, so a queue that is not
+     * served still sheds its standing clients.
+     *
+     * @param[in] now
+     * @param[out] dropped The clients dropped are appended. The caller has to close them.
+     */
+    void drop(const Clock::time_point& now, std::vector<int>& dropped);
+
+    /**
+     * Takes all the clients, without counting them as drops.
+     *
+     * @param[out] socketDescriptors
+     */
+    void clear(std::vector<int>& socketDescriptors);
+
+    /**
+     * @return The number of waiting clients.
+     */
+    size_t getSize() const;
+
+    /**
+     * @return The number of clients dropped, either by the control law, because their deadline passed or because the queue was full.
+     */
+    size_t getNumberOfDrops() const;
+
+private:
+
+    /**
+     * A waiting client.
+     */
+    struct Waiter
+    {
+        int socketDescriptor;
+        Clock::time_point enqueued;
+        Priority priority;
+        Clock::time_point deadline; //The maximum time point if the client has no deadline.
+        bool classified; //Whether its first request was already received, so 'priority' and 'deadline' are known.
+    };
+
+    /**
+     * Reads the class and the deadline of the waiters that were not classified yet.
+     */
+    void classify();
+
+    /**
+     * @param[in] first
+     * @param[in] second
+     * @return true if 'first' has to be taken before 'second'.
+     */
+    static bool isBefore(const Waiter& first, const Waiter& second);
+
+    /**
+     * Updates the state of the control law with the oldest client.
+     *
+     * @param[in] now
+     * @return true if a client has to be dropped.
+     */
+    bool shouldDropOldest(const Clock::time_point& now);
+
+    /**
+     * Removes the oldest client of the lowest class, which is the one dropped by the control law.
+     *
+     * @return The client removed.
+     */
+    int removeVictim();
+
+    WaitingQueueOptions options_;
+    size_t capacity_;
+    Classifier classifier_;
+    std::deque<Waiter> waiters_; //In arrival order.
+    Clock::time_point firstAboveTime_; //When the waiting time will have been above the target for a whole interval, or zero if it is below the target.
+    Clock::time_point dropNext_; //When the next client is dropped while dropping.
+    bool dropping_; //Whether the waiting time stayed above the target for a whole interval.
+    size_t count_; //The number of drops since the queue started dropping, which shortens the time between drops.
+    size_t numberDrops_;
+};
+
+}
+
+#endif
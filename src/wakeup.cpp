@@ -0,0 +1,250 @@
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+#include "wakeup.h"
+#include "common.h"
+#include "log.h"
+
+namespace pipetrick
+{
+
+namespace
+{
+
+std::mutex signalsMutex;
+std::vector<bool> usedSignals; //One entry per real time signal, from SIGRTMIN.
+
+/**
+ * Handler of the real time signals delivered to a thread that does not block them. The notification is lost, but the
+ * default action (terminating the process) is avoided.
+ */
+void ignoreSignal(int)
+{
+}
+
+/**
+ * @return A real time signal not used by any other instance, or 0 if all of them are in use.
+ */
+int allocateSignal()
+{
+    std::scoped_lock lock(signalsMutex);
+    usedSignals.resize(SIGRTMAX - SIGRTMIN + 1, false);
+    for (size_t i = 0; i < usedSignals.size(); i++)
+    {
+        if (!usedSignals[i])
+        {
+            usedSignals[i] = true;
+            return SIGRTMIN + i;
+        }
+    }
+    return 0;
+}
+
+void freeSignal(int signalNumber)
+{
+    std::scoped_lock lock(signalsMutex);
+    usedSignals[signalNumber - SIGRTMIN] = false;
+}
+
+}
+
+Wakeup::Wakeup()
+: type_(WakeupType::PIPE)
+, signalNumber_(0)
+{
+    descriptors_[0] = -1;
+    descriptors_[1] = -1;
+}
+
+Wakeup::~Wakeup()
+{
+    release();
+}
+
+bool Wakeup::init(WakeupType type, const std::string& prefix)
+{
+    release();
+    type_ = type;
+    prefix_ = prefix;
+
+    switch (type_)
+    {
+        case WakeupType::PIPE:
+            if (pipe2(descriptors_, O_NONBLOCK | O_CLOEXEC) == -1)
+            {
+                int errorNumber = errno;
+                Log::logError(prefix_ + "Wakeup::init - Could not create the pipe file descriptors", errorNumber);
+                descriptors_[0] = -1;
+                descriptors_[1] = -1;
+                return false;
+            }
+            return true;
+        case WakeupType::EVENTFD:
+            descriptors_[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (descriptors_[0] == -1)
+            {
+                int errorNumber = errno;
+                Log::logError(prefix_ + "Wakeup::init - Could not create the eventfd file descriptor", errorNumber);
+                return false;
+            }
+            descriptors_[1] = descriptors_[0];
+            return true;
+        case WakeupType::SIGNALFD:
+        {
+            //Each instance needs its own signal. Otherwise, notifying one of them would wake up all the others.
+            signalNumber_ = allocateSignal();
+            if (signalNumber_ == 0)
+            {
+                Log::logError(prefix_ + "Wakeup::init - There are no free real time signals.");
+                return false;
+            }
+
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = ignoreSignal;
+            sigemptyset(&action.sa_mask);
+            sigaction(signalNumber_, &action, nullptr);
+
+            //All the real time signals are blocked at once, so the threads created afterwards by this thread do not receive the
+            //signals of instances initialised later on.
+            blockSignals();
+
+            sigset_t mask;
+            sigemptyset(&mask);
+            sigaddset(&mask, signalNumber_);
+            descriptors_[0] = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+            if (descriptors_[0] == -1)
+            {
+                int errorNumber = errno;
+                Log::logError(prefix_ + "Wakeup::init - Could not create the signalfd file descriptor", errorNumber);
+                release();
+                return false;
+            }
+            descriptors_[1] = descriptors_[0];
+            consume(); //A signal sent to a previous owner of the same number might still be pending.
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Wakeup::release()
+{
+    if (descriptors_[0] != -1)
+    {
+        close(descriptors_[0]);
+    }
+
+    if (descriptors_[1] != -1 && descriptors_[1] != descriptors_[0])
+    {
+        close(descriptors_[1]);
+    }
+    descriptors_[0] = -1;
+    descriptors_[1] = -1;
+
+    if (signalNumber_ != 0)
+    {
+        freeSignal(signalNumber_);
+        signalNumber_ = 0;
+    }
+}
+
+int Wakeup::getDescriptor() const
+{
+    return descriptors_[0];
+}
+
+bool Wakeup::notify()
+{
+    int result = 0;
+    switch (type_)
+    {
+        case WakeupType::PIPE:
+            result = write(descriptors_[1], "0", 1);
+            break;
+        case WakeupType::EVENTFD:
+        {
+            uint64_t value = 1;
+            result = write(descriptors_[1], &value, sizeof(value));
+            break;
+        }
+        case WakeupType::SIGNALFD:
+            result = kill(getpid(), signalNumber_);
+            break;
+    }
+
+    if (result == -1)
+    {
+        int errorNumber = errno;
+        if (errorNumber == EAGAIN)
+        {
+            return true; //The pipe is full or the counter is saturated, so the descriptor is already readable.
+        }
+        Log::logError(prefix_ + "Wakeup::notify - Could not notify", errorNumber);
+        return false;
+    }
+
+    return true;
+}
+
+void Wakeup::consume()
+{
+    switch (type_)
+    {
+        case WakeupType::PIPE:
+            Common::consumePipe(descriptors_[0], prefix_);
+            break;
+        case WakeupType::EVENTFD:
+        {
+            //Reading the counter resets it to zero, no matter how many notifications were performed.
+            uint64_t value;
+            if (read(descriptors_[0], &value, sizeof(value)) == -1 && errno != EAGAIN)
+            {
+                int errorNumber = errno;
+                Log::logError(prefix_ + "Wakeup::consume - Error reading the eventfd counter", errorNumber);
+            }
+            break;
+        }
+        case WakeupType::SIGNALFD:
+        {
+            //Real time signals are queued, so there might be one per notification.
+            const size_t MAX_SIGNALS = 16;
+            struct signalfd_siginfo signals[MAX_SIGNALS];
+            while (read(descriptors_[0], signals, sizeof(signals)) > 0)
+            {
+            }
+
+            if (errno != EAGAIN)
+            {
+                int errorNumber = errno;
+                Log::logError(prefix_ + "Wakeup::consume - Error reading the pending signals", errorNumber);
+            }
+            break;
+        }
+    }
+}
+
+int Wakeup::getNumberOfDescriptors(WakeupType type)
+{
+    return type == WakeupType::PIPE ? 2 : 1;
+}
+
+void Wakeup::blockSignals()
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int signalNumber = SIGRTMIN; signalNumber <= SIGRTMAX; signalNumber++)
+    {
+        sigaddset(&mask, signalNumber);
+    }
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+}
+
+}
@@ -0,0 +1,91 @@
+#ifndef PT_WAKEUP_H
+#define PT_WAKEUP_H
+
+#include <string>
+
+namespace pipetrick
+{
+
+/**
+ * The kernel objects that can implement the 'Self pipe trick'.
+ */
+enum class WakeupType
+{
+    PIPE, //A non blocking pipe. Two file descriptors, and one byte written per notification.
+    EVENTFD, //An eventfd counter. One file descriptor, and all the notifications are consumed with a single read.
+    SIGNALFD //A real time signal sent to the process and read through a signalfd. One file descriptor, and one real time signal per instance.
+};
+
+/**
+ * A file descriptor that becomes readable when 'notify' is called, and stays readable until 'consume' is called.
+ * It can be watched by select, epoll or io_uring polls from any number of threads.
+ */
+class Wakeup
+{
+public:
+
+    Wakeup();
+
+    /**
+     * Calls 'release'.
+     */
+    ~Wakeup();
+
+    Wakeup(const Wakeup&) = delete;
+    Wakeup& operator=(const Wakeup&) = delete;
+
+    /**
+     * Creates the file descriptors of 'type', releasing the previous ones, if any.
+     * In SIGNALFD, all the real time signals are blocked in the calling thread, so the threads that might receive them have to be
+     * created afterwards by this thread (or block them on their own). Initialisation fails when there are no free real time signals.
+     *
+     * @param[in] type
+     * @param[in] prefix
+     * @return true if the file descriptors were created successfully, false otherwise.
+     */
+    bool init(WakeupType type, const std::string& prefix = "");
+
+    /**
+     * Closes the file descriptors and gives back the real time signal, if any.
+     */
+    void release();
+
+    /**
+     * @return The file descriptor to watch for read operations, or -1 if 'init' was not called or failed.
+     */
+    int getDescriptor() const;
+
+    /**
+     * Makes the descriptor readable.
+     *
+     * @return true if the notification was performed successfully, false otherwise.
+     */
+    bool notify();
+
+    /**
+     * Consumes all the pending notifications, so the descriptor is not readable anymore.
+     */
+    void consume();
+
+    /**
+     * @return The number of file descriptors used by 'type'.
+     */
+    static int getNumberOfDescriptors(WakeupType type);
+
+    /**
+     * Blocks all the real time signals in the calling thread, so the signals of SIGNALFD instances are only received through their
+     * descriptors. Threads that watch the descriptors of other threads' instances must call it.
+     */
+    static void blockSignals();
+
+private:
+
+    WakeupType type_;
+    int descriptors_[2]; //The read and write ends. Both are the same descriptor for EVENTFD and SIGNALFD.
+    int signalNumber_; //The real time signal in SIGNALFD, or 0.
+    std::string prefix_;
+};
+
+}
+
+#endif
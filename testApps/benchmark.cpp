@@ -0,0 +1,691 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <poll.h>
+#include <sys/resource.h>
+#include <netinet/tcp.h>
+#include "server.h"
+#include "client.h"
+#include "log.h"
+#include "wakeup.h"
+
+using namespace pipetrick;
+
+namespace
+{
+
+/**
+ * Sends 'requestsPerThread' requests without delay from each one of 'numThreads' threads, one connection per request unless
+ * 'clientOptions' enables keep-alive.
+ *
+ * @param[in] numThreads
+ * @param[in] requestsPerThread
+ * @param[in] port The port of the server.
+ * @param[in] clientOptions The options of the client of each thread.
+ * @return The number of successful requests per second.
+ */
+double measureRequestsPerSecond(size_t numThreads, size_t requestsPerThread, int port = DEFAULT_PORT, const ClientOptions& clientOptions = ClientOptions())
+{
+    std::atomic<size_t> successfulRequests(0);
+    std::vector<std::thread> threads;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numThreads; i++)
+    {
+        threads.emplace_back([&successfulRequests, requestsPerThread, port, &clientOptions]()
+        {
+            Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+            for (size_t j = 0; j < requestsPerThread; j++)
+            {
+                std::chrono::milliseconds serverDelay(0);
+                if (client.sendDelayToServer(serverDelay, Client::DEFAULT_IP, port))
+                {
+                    successfulRequests++;
+                }
+            }
+        });
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+
+    std::chrono::duration<double> elapsedTime = std::chrono::steady_clock::now() - begin;
+    return successfulRequests / elapsedTime.count();
+}
+
+/**
+ * Compares the connections per second of the detached thread per client against the pool of workers.
+ */
+void benchmarkWorkerPool()
+{
+    const size_t MAX_NUMBER_CLIENTS = 64;
+    const size_t NUM_WORKERS = 8;
+    const size_t NUM_CLIENT_THREADS = 8;
+    const size_t REQUESTS_PER_THREAD = 1000;
+
+    const std::pair<const char*, ServerMode> MODES[] =
+    {
+        {"thread per client", ServerMode::THREAD_PER_CLIENT},
+        {"worker pool", ServerMode::WORKER_POOL}
+    };
+
+    std::cout << "Connections per second (" << NUM_CLIENT_THREADS << " client threads, " << REQUESTS_PER_THREAD << " requests each)" << std::endl;
+    for (const auto& mode : MODES)
+    {
+        ServerOptions options;
+        options.mode = mode.second;
+        options.numWorkers = NUM_WORKERS;
+
+        Server server(MAX_NUMBER_CLIENTS, options);
+        if (!server.start())
+        {
+            continue;
+        }
+        double rate = measureRequestsPerSecond(NUM_CLIENT_THREADS, REQUESTS_PER_THREAD);
+        server.stop();
+        std::cout << "  " << std::left << std::setw(20) << mode.first << std::fixed << std::setprecision(0) << rate << std::endl;
+    }
+}
+
+/**
+ * Shows how the connections per second scale with the number of SO_REUSEPORT acceptors.
+ */
+void benchmarkAcceptors()
+{
+    const size_t MAX_NUMBER_CLIENTS = 64;
+    const size_t NUM_CLIENT_THREADS = 16;
+    const size_t REQUESTS_PER_THREAD = 500;
+    const size_t NUM_ACCEPTORS[] = {1, 2, 4, 8};
+
+    std::cout << "Connections per second by number of acceptors (" << NUM_CLIENT_THREADS << " client threads, " << REQUESTS_PER_THREAD << " requests each, "
+              << std::thread::hardware_concurrency() << " cores)" << std::endl;
+    for (size_t numAcceptors : NUM_ACCEPTORS)
+    {
+        ServerOptions options;
+        options.numAcceptors = numAcceptors;
+
+        Server server(MAX_NUMBER_CLIENTS, options);
+        if (!server.start())
+        {
+            continue;
+        }
+        double rate = measureRequestsPerSecond(NUM_CLIENT_THREADS, REQUESTS_PER_THREAD);
+        server.stop();
+        std::cout << "  " << std::left << std::setw(20) << numAcceptors << std::fixed << std::setprecision(0) << rate << std::endl;
+    }
+}
+
+/**
+ * Measures the time between a call to 'Wakeup::notify' and the return of a thread blocked in a poll call on the wakeup descriptor,
+ * for each implementation of the 'Self pipe trick'.
+ */
+void benchmarkWakeup()
+{
+    const size_t NUM_WAKEUPS = 20000;
+    const std::pair<const char*, WakeupType> TYPES[] =
+    {
+        {"pipe", WakeupType::PIPE},
+        {"eventfd", WakeupType::EVENTFD},
+        {"signalfd", WakeupType::SIGNALFD}
+    };
+
+    std::cout << "Wake to return latency in microseconds (" << NUM_WAKEUPS << " wakeups)" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "type" << std::setw(6) << "fds" << std::setw(10) << "mean" << std::setw(10) << "p50" << "p99" << std::endl;
+    for (const auto& type : TYPES)
+    {
+        Wakeup wakeup;
+        if (!wakeup.init(type.second))
+        {
+            continue;
+        }
+
+        //The waiter publishes the time it returned from poll, and the notifier waits for it before the next notification.
+        std::atomic<int64_t> returnTime(-1);
+        std::atomic<bool> quit(false);
+        std::thread waiter([&wakeup, &returnTime, &quit]()
+        {
+            struct pollfd descriptor;
+            descriptor.fd = wakeup.getDescriptor();
+            descriptor.events = POLLIN;
+            while (!quit)
+            {
+                if (poll(&descriptor, 1, -1) == 1)
+                {
+                    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                    wakeup.consume();
+                    returnTime = now;
+                }
+            }
+        });
+
+        std::vector<double> latencies;
+        latencies.reserve(NUM_WAKEUPS);
+        for (size_t i = 0; i < NUM_WAKEUPS; i++)
+        {
+            returnTime = -1;
+            int64_t notifyTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            wakeup.notify();
+            while (returnTime == -1)
+            {
+                std::this_thread::yield();
+            }
+            latencies.push_back((returnTime - notifyTime) / 1000.0);
+        }
+
+        quit = true;
+        wakeup.notify();
+        waiter.join();
+
+        double mean = 0;
+        for (double latency : latencies)
+        {
+            mean += latency;
+        }
+        mean /= latencies.size();
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "  " << std::left << std::setw(20) << type.first << std::setw(6) << Wakeup::getNumberOfDescriptors(type.second) << std::fixed << std::setprecision(1)
+                  << std::setw(10) << mean << std::setw(10) << latencies[latencies.size() / 2] << latencies[latencies.size() * 99 / 100] << std::endl;
+    }
+}
+
+/**
+ * Compares the requests per second of one connection per request against keep-alive connections, in every server mode.
+ */
+void benchmarkKeepAlive()
+{
+    const size_t MAX_NUMBER_CLIENTS = 64;
+    const size_t NUM_CLIENT_THREADS = 8;
+    const size_t REQUESTS_PER_THREAD = 2000;
+
+    const std::pair<const char*, ServerMode> MODES[] =
+    {
+        {"thread per client", ServerMode::THREAD_PER_CLIENT},
+        {"reactor", ServerMode::REACTOR},
+        {"io_uring", ServerMode::IO_URING},
+        {"coroutine", ServerMode::COROUTINE}
+    };
+
+    std::cout << "Requests per second (" << NUM_CLIENT_THREADS << " client threads, " << REQUESTS_PER_THREAD << " requests each)" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "mode" << std::setw(16) << "new connection" << "keep-alive" << std::endl;
+    for (const auto& mode : MODES)
+    {
+        ServerOptions options;
+        options.mode = mode.second;
+        options.keepAliveTimeOut = std::chrono::milliseconds(1000);
+
+        Server server(MAX_NUMBER_CLIENTS, options);
+        if (!server.start())
+        {
+            continue;
+        }
+        ClientOptions clientOptions;
+        double newConnectionRate = measureRequestsPerSecond(NUM_CLIENT_THREADS, REQUESTS_PER_THREAD, DEFAULT_PORT, clientOptions);
+        clientOptions.keepAlive = true;
+        double keepAliveRate = measureRequestsPerSecond(NUM_CLIENT_THREADS, REQUESTS_PER_THREAD, DEFAULT_PORT, clientOptions);
+        server.stop();
+        std::cout << "  " << std::left << std::setw(20) << mode.first << std::fixed << std::setprecision(0) << std::setw(16) << newConnectionRate << keepAliveRate << std::endl;
+    }
+}
+
+/**
+ * Compares the requests per second of one thread waiting for each response on a keep-alive connection against the same thread
+ * pipelining batches of requests on a multiplexed connection, in every server mode.
+ */
+void benchmarkPipelining()
+{
+    const size_t MAX_NUMBER_CLIENTS = 4;
+    const size_t NUM_REQUESTS = 20000;
+    const size_t BATCH_SIZE = 64;
+
+    const std::pair<const char*, ServerMode> MODES[] =
+    {
+        {"thread per client", ServerMode::THREAD_PER_CLIENT},
+        {"reactor", ServerMode::REACTOR},
+        {"io_uring", ServerMode::IO_URING},
+        {"coroutine", ServerMode::COROUTINE}
+    };
+
+    std::cout << "Requests per second (1 client thread, " << NUM_REQUESTS << " requests, batches of " << BATCH_SIZE << ")" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "mode" << std::setw(16) << "keep-alive" << "pipelined" << std::endl;
+    for (const auto& mode : MODES)
+    {
+        ServerOptions options;
+        options.mode = mode.second;
+        options.keepAliveTimeOut = std::chrono::milliseconds(1000);
+
+        Server server(MAX_NUMBER_CLIENTS, options);
+        if (!server.start())
+        {
+            continue;
+        }
+        ClientOptions clientOptions;
+        clientOptions.keepAlive = true;
+        double keepAliveRate = measureRequestsPerSecond(1, NUM_REQUESTS, DEFAULT_PORT, clientOptions);
+
+        Client client;
+        size_t successfulRequests = 0;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < NUM_REQUESTS / BATCH_SIZE; i++)
+        {
+            std::vector<std::chrono::milliseconds> serverDelays(BATCH_SIZE, std::chrono::milliseconds(0));
+            if (client.sendDelaysToServer(serverDelays))
+            {
+                successfulRequests += BATCH_SIZE;
+            }
+        }
+        std::chrono::duration<double> elapsedTime = std::chrono::steady_clock::now() - begin;
+        server.stop();
+        std::cout << "  " << std::left << std::setw(20) << mode.first << std::fixed << std::setprecision(0) << std::setw(16) << keepAliveRate
+                  << successfulRequests / elapsedTime.count() << std::endl;
+    }
+}
+
+/**
+ * Compares the requests per second of text messages against binary messages on keep-alive connections, in every server mode.
+ */
+void benchmarkFraming()
+{
+    const size_t MAX_NUMBER_CLIENTS = 64;
+    const size_t NUM_CLIENT_THREADS = 8;
+    const size_t REQUESTS_PER_THREAD = 5000;
+
+    const std::pair<const char*, ServerMode> MODES[] =
+    {
+        {"thread per client", ServerMode::THREAD_PER_CLIENT},
+        {"reactor", ServerMode::REACTOR},
+        {"io_uring", ServerMode::IO_URING},
+        {"coroutine", ServerMode::COROUTINE}
+    };
+
+    char buffer[BUFFER_SIZE];
+    std::cout << "Bytes per message: text " << Common::encodeFrame(buffer, Common::FrameFormat::TEXT, 0, 1) << ", binary "
+              << Common::encodeFrame(buffer, Common::FrameFormat::BINARY, 0, 1) << " to " << MAX_BINARY_FRAME_SIZE << std::endl;
+    std::cout << "Requests per second (" << NUM_CLIENT_THREADS << " keep-alive client threads, " << REQUESTS_PER_THREAD << " requests each)" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "mode" << std::setw(16) << "text" << "binary" << std::endl;
+    for (const auto& mode : MODES)
+    {
+        ServerOptions options;
+        options.mode = mode.second;
+        options.keepAliveTimeOut = std::chrono::milliseconds(1000);
+
+        Server server(MAX_NUMBER_CLIENTS, options);
+        if (!server.start())
+        {
+            continue;
+        }
+        ClientOptions clientOptions;
+        clientOptions.keepAlive = true;
+        double textRate = measureRequestsPerSecond(NUM_CLIENT_THREADS, REQUESTS_PER_THREAD, DEFAULT_PORT, clientOptions);
+        clientOptions.frameFormat = Common::FrameFormat::BINARY;
+        double binaryRate = measureRequestsPerSecond(NUM_CLIENT_THREADS, REQUESTS_PER_THREAD, DEFAULT_PORT, clientOptions);
+        server.stop();
+        std::cout << "  " << std::left << std::setw(20) << mode.first << std::fixed << std::setprecision(0) << std::setw(16) << textRate << binaryRate << std::endl;
+    }
+}
+
+/**
+ * Compares the requests per second of one thread sending asynchronous requests against blocking client threads, when the
+ * server delays each request.
+ */
+void benchmarkAsync()
+{
+    const size_t IN_FLIGHT = 64;
+    const size_t NUM_REQUESTS = 2048;
+    const std::chrono::milliseconds SERVER_DELAY(5);
+
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+    Server server(2 * IN_FLIGHT, options);
+    if (!server.start())
+    {
+        return;
+    }
+
+    std::cout << "Requests per second (" << NUM_REQUESTS << " requests, server delay of " << SERVER_DELAY.count() << " ms)" << std::endl;
+    for (size_t numThreads : {size_t(1), IN_FLIGHT})
+    {
+        std::atomic<size_t> successfulRequests(0);
+        std::vector<std::thread> threads;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numThreads; i++)
+        {
+            threads.emplace_back([&successfulRequests, numThreads, SERVER_DELAY]()
+            {
+                Client client;
+                for (size_t j = 0; j < NUM_REQUESTS / numThreads; j++)
+                {
+                    std::chrono::milliseconds serverDelay(SERVER_DELAY);
+                    if (client.sendDelayToServer(serverDelay))
+                    {
+                        successfulRequests++;
+                    }
+                }
+            });
+        }
+
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            threads[i].join();
+        }
+        std::chrono::duration<double> elapsedTime = std::chrono::steady_clock::now() - begin;
+        std::cout << "  " << std::left << std::setw(40) << std::to_string(numThreads) + " blocking thread(s)" << std::fixed
+                  << std::setprecision(0) << successfulRequests / elapsedTime.count() << std::endl;
+    }
+
+    Client client;
+    size_t successfulRequests = 0;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < NUM_REQUESTS / IN_FLIGHT; i++)
+    {
+        std::vector<std::future<AsyncResponse> > responses;
+        for (size_t j = 0; j < IN_FLIGHT; j++)
+        {
+            responses.push_back(client.sendDelayToServerAsync(SERVER_DELAY));
+        }
+
+        for (std::future<AsyncResponse>& response : responses)
+        {
+            successfulRequests += response.get().success ? 1 : 0;
+        }
+    }
+    std::chrono::duration<double> elapsedTime = std::chrono::steady_clock::now() - begin;
+    std::cout << "  " << std::left << std::setw(40) << "1 thread, " + std::to_string(IN_FLIGHT) + " asynchronous in flight" << std::fixed
+              << std::setprecision(0) << successfulRequests / elapsedTime.count() << std::endl;
+    server.stop();
+}
+
+/**
+ * Measures the memory held by each client sleeping in a coroutine server, against the stack of a thread per client.
+ */
+void benchmarkCoroutine()
+{
+    const size_t NUM_SLEEPING_CLIENTS = 1000;
+
+    ServerOptions options;
+    options.mode = ServerMode::COROUTINE;
+    Server server(NUM_SLEEPING_CLIENTS, options);
+    if (!server.start())
+    {
+        return;
+    }
+
+    //The frames of the client coroutines are counted too, so they are taken out of the count.
+    Client client;
+    std::atomic<size_t> finishedRequests(0);
+    size_t framesBefore = FramePool::getNumberOfFrames();
+    for (size_t i = 0; i < NUM_SLEEPING_CLIENTS; i++)
+    {
+        client.sendDelayToServerAsync(std::chrono::milliseconds(60 * 1000), [&finishedRequests](const AsyncResponse&)
+        {
+            finishedRequests++;
+        });
+    }
+
+    for (size_t i = 0; i < 500 && server.getNumberOfClients() < NUM_SLEEPING_CLIENTS; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    size_t frames = FramePool::getNumberOfFrames() - framesBefore;
+
+    struct rlimit stackLimit;
+    getrlimit(RLIMIT_STACK, &stackLimit);
+    std::cout << "Sleeping clients: " << server.getNumberOfClients() << ", coroutine frames: " << frames << " (server and client)" << std::endl;
+    std::cout << "  largest coroutine frame: " << FramePool::getMaximumFrameSize() << " bytes" << std::endl;
+    std::cout << "  stack of a thread per client: " << stackLimit.rlim_cur << " bytes reserved" << std::endl;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    server.stop();
+    client.stop();
+    std::chrono::duration<double, std::milli> elapsedTime = std::chrono::steady_clock::now() - begin;
+    std::cout << "  cancelling all of them: " << std::fixed << std::setprecision(1) << elapsedTime.count() << " ms" << std::endl;
+}
+
+/**
+ * @return The number of entries of the directory 'path' of procfs.
+ */
+size_t countProcEntries(const char* path)
+{
+    return std::distance(std::filesystem::directory_iterator(path), std::filesystem::directory_iterator());
+}
+
+/**
+ * Compares the file descriptors and threads used by many clients with one request in flight each: blocking calls of clients with
+ * their own wakeup, asynchronous calls of clients with their own scheduler thread, and asynchronous calls of clients sharing a reactor.
+ */
+void benchmarkSharedReactor()
+{
+    const size_t NUM_CLIENTS = 200;
+    const std::chrono::milliseconds SERVER_DELAY(300);
+
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+    Server server(NUM_CLIENTS, options);
+    if (!server.start())
+    {
+        return;
+    }
+
+    std::cout << NUM_CLIENTS << " clients with one request of " << SERVER_DELAY.count() << " ms in flight each (sockets included)" << std::endl;
+    std::cout << "  " << std::left << std::setw(32) << "clients" << std::setw(16) << "descriptors" << std::setw(10) << "threads" << "elapsed ms" << std::endl;
+    for (const char* kind : {"blocking, own wakeup", "asynchronous, own thread", "asynchronous, shared reactor"})
+    {
+        bool shared = std::string(kind).find("shared") != std::string::npos;
+        bool blocking = std::string(kind).find("blocking") != std::string::npos;
+        ClientReactor reactor;
+        reactor.start();
+        ClientOptions clientOptions;
+        clientOptions.reactor = shared ? &reactor : nullptr;
+
+        size_t descriptorsBefore = countProcEntries("/proc/self/fd");
+        size_t threadsBefore = countProcEntries("/proc/self/task");
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        std::vector<std::unique_ptr<Client> > clients;
+        std::vector<std::thread> threads;
+        std::vector<std::future<AsyncResponse> > responses;
+        for (size_t i = 0; i < NUM_CLIENTS; i++)
+        {
+            clients.emplace_back(new Client(Client::DEFAULT_TIMEOUT, clientOptions));
+            Client* client = clients.back().get();
+            if (blocking)
+            {
+                threads.emplace_back([client, SERVER_DELAY]()
+                {
+                    std::chrono::milliseconds serverDelay(SERVER_DELAY);
+                    client->sendDelayToServer(serverDelay);
+                });
+            }
+            else
+            {
+                responses.push_back(client->sendDelayToServerAsync(SERVER_DELAY));
+            }
+        }
+
+        std::this_thread::sleep_for(SERVER_DELAY / 2);
+        size_t descriptors = countProcEntries("/proc/self/fd") - descriptorsBefore;
+        size_t threadsUsed = countProcEntries("/proc/self/task") - threadsBefore;
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (std::future<AsyncResponse>& response : responses)
+        {
+            response.get();
+        }
+        std::chrono::duration<double, std::milli> elapsedTime = std::chrono::steady_clock::now() - begin;
+        clients.clear();
+
+        //The threads of the shared reactor were started before counting.
+        std::cout << "  " << std::left << std::setw(32) << kind << std::setw(16) << descriptors << std::setw(10) << threadsUsed
+                  << std::fixed << std::setprecision(0) << elapsedTime.count() << std::endl;
+    }
+    std::cout << "  the shared reactor itself: " << ClientReactor(1).getNumberOfDescriptors() << " descriptors and 1 thread" << std::endl;
+    server.stop();
+}
+
+/**
+ * Compares the requests per second of many threads sharing one multiplexed connection, with and without batching windows.
+ */
+void benchmarkBatching()
+{
+    const size_t NUM_CLIENT_THREADS = 16;
+    const size_t REQUESTS_PER_THREAD = 2000;
+    const long WINDOWS[] = {0, 20, 50, 200};
+
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+    Server server(4, options);
+    if (!server.start())
+    {
+        return;
+    }
+
+    std::cout << "Requests per second (" << NUM_CLIENT_THREADS << " threads on one multiplexed binary connection, " << REQUESTS_PER_THREAD << " requests each)" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "window (us)" << "requests per second" << std::endl;
+    for (long window : WINDOWS)
+    {
+        ClientOptions clientOptions;
+        clientOptions.multiplex = true;
+        clientOptions.frameFormat = Common::FrameFormat::BINARY;
+        clientOptions.batching.window = std::chrono::microseconds(window);
+        clientOptions.batching.maxRequests = NUM_CLIENT_THREADS;
+        Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+        std::atomic<size_t> successfulRequests(0);
+        std::vector<std::thread> threads;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < NUM_CLIENT_THREADS; i++)
+        {
+            threads.emplace_back([&client, &successfulRequests, REQUESTS_PER_THREAD]()
+            {
+                for (size_t j = 0; j < REQUESTS_PER_THREAD; j++)
+                {
+                    std::chrono::milliseconds serverDelay(0);
+                    if (client.sendDelayToServer(serverDelay))
+                    {
+                        successfulRequests++;
+                    }
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        std::chrono::duration<double> elapsedTime = std::chrono::steady_clock::now() - begin;
+        std::cout << "  " << std::left << std::setw(20) << window << std::fixed << std::setprecision(0) << successfulRequests / elapsedTime.count() << std::endl;
+    }
+    server.stop();
+}
+
+/**
+ * @param[in] port
+ * @return Whether a new connection to the server at 'port' with TCP Fast Open carries its first message in the SYN.
+ */
+bool isSynDataAccepted(int port)
+{
+    int socketDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+    int fastOpen = 1;
+    setsockopt(socketDescriptor, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &fastOpen, sizeof(fastOpen));
+    struct sockaddr_in serverAddress;
+    serverAddress.sin_addr.s_addr = inet_addr(Client::DEFAULT_IP);
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_port = htons(port);
+
+    char message[BUFFER_SIZE];
+    size_t messageSize = Common::encodeFrame(message, Common::FrameFormat::BINARY, 0);
+    struct tcp_info info;
+    socklen_t infoSize = sizeof(info);
+    bool synData = connect(socketDescriptor, (struct sockaddr*) &serverAddress, sizeof(serverAddress)) == 0
+                   && Common::writeFrame(socketDescriptor, message, messageSize, "Benchmark:") && Common::readFrame(socketDescriptor, message, "Benchmark:")
+                   && getsockopt(socketDescriptor, IPPROTO_TCP, TCP_INFO, &info, &infoSize) == 0 && (info.tcpi_options & TCPI_OPT_SYN_DATA);
+    close(socketDescriptor);
+    return synData;
+}
+
+/**
+ * Compares the requests per second of one connection per request with and without TCP Fast Open, which saves the round trip of the
+ * handshake once the client has a cookie of the server.
+ */
+void benchmarkFastOpen()
+{
+    const size_t NUM_CLIENT_THREADS = 4;
+    const size_t REQUESTS_PER_THREAD = 2000;
+    const int PORT = DEFAULT_PORT + 1;
+
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+    options.fastOpen = true;
+    Server server(64, options);
+    if (!server.start(PORT))
+    {
+        return;
+    }
+
+    //The first connection only gets the cookie.
+    isSynDataAccepted(PORT);
+    std::string sysctl;
+    std::ifstream("/proc/sys/net/ipv4/tcp_fastopen") >> sysctl;
+    std::cout << "net.ipv4.tcp_fastopen = " << sysctl << " (3 enables client and server), message in the SYN: " << (isSynDataAccepted(PORT) ? "yes" : "no") << std::endl;
+    std::cout << "Requests per second (" << NUM_CLIENT_THREADS << " client threads, " << REQUESTS_PER_THREAD << " requests each, one connection per request)" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "handshake" << "requests per second" << std::endl;
+    for (bool fastOpen : {false, true})
+    {
+        ClientOptions clientOptions;
+        clientOptions.fastOpen = fastOpen;
+        clientOptions.frameFormat = Common::FrameFormat::BINARY;
+        double rate = measureRequestsPerSecond(NUM_CLIENT_THREADS, REQUESTS_PER_THREAD, PORT, clientOptions);
+        std::cout << "  " << std::left << std::setw(20) << (fastOpen ? "TCP Fast Open" : "regular") << std::fixed << std::setprecision(0) << rate << std::endl;
+    }
+    server.stop();
+}
+
+struct Benchmark
+{
+    const char* name;
+    void (*run)();
+};
+
+const Benchmark BENCHMARKS[] =
+{
+    {"workerPool", benchmarkWorkerPool},
+    {"acceptors", benchmarkAcceptors},
+    {"wakeup", benchmarkWakeup},
+    {"keepAlive", benchmarkKeepAlive},
+    {"pipelining", benchmarkPipelining},
+    {"framing", benchmarkFraming},
+    {"async", benchmarkAsync},
+    {"coroutine", benchmarkCoroutine},
+    {"sharedReactor", benchmarkSharedReactor},
+    {"batching", benchmarkBatching},
+    {"fastOpen", benchmarkFastOpen}
+};
+
+}
+
+/**
+ * Runs the benchmark whose name is passed as the first argument, or all of them if there are no arguments.
+ */
+int main(int argc, char **argv)
+{
+    Log::setVerbose(false);
+    for (const Benchmark& benchmark : BENCHMARKS)
+    {
+        if (argc < 2 || benchmark.name == std::string(argv[1]))
+        {
+            benchmark.run();
+        }
+    }
+    return 0;
+}
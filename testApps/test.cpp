@@ -1,6 +1,11 @@
+#include <atomic>
 #include <chrono>
 #include <thread>
+#include <filesystem>
 #include <pthread.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 #include <valgrind/memcheck.h>
 #include "test.h"
 
@@ -283,6 +288,2175 @@ TEST_F(PipeTrickTest, WhenAClientTellsTheServerToSleepForAVeryLongTimeAndTheClie
     server.stop();
 }
 
+TEST_F(PipeTrickTest, WhenAddingSomeClientsWithDifferentSleepingTimesToAReactorServer_ThenTheServerReturnsTheCorrectIncreasedSleepingTimeForEachClient)
+{
+    const size_t MAX_NUMBER_CLIENTS = 30;
+    const size_t START_DELAY_MS = 200;
+    const size_t MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_FINISH = 100;
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+
+    std::vector<ClientInfo* > clients;
+
+    //Create clients
+    for(size_t i = 0; i < MAX_NUMBER_CLIENTS; i++)
+    {
+        Client* client = new Client();
+        std::thread* clientThread = new std::thread([client, START_DELAY_MS, i]()
+        {
+            std::chrono::milliseconds serverDelay(START_DELAY_MS + i);
+            EXPECT_TRUE(client->sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), (START_DELAY_MS + i + 1));
+        });
+
+        ClientInfo* clientInfo = new ClientInfo(clientThread, client);
+        clients.push_back(clientInfo);
+    }
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->clientThread->join();
+        delete clients[i]->clientThread;
+        delete clients[i]->client;
+        delete clients[i];
+    }
+
+    //The reactor closes each connection after writing its response, so a client can return before its connection is released.
+    for(size_t i = 0; i < MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_FINISH && server.getNumberOfClients() > 0; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(server.getNumberOfClients(), 0);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenConnectingALotOfClientsWithAHighTimeOutToAFullReactorServerAndStoppingOnlyTheServer_ThenTheQuitProcessIsFast)
+{
+    const size_t MAX_NUMBER_CLIENTS = 200;
+    const uint64_t SERVER_DELAY = 900 * 1000;
+    const std::chrono::microseconds TIMEOUT = std::chrono::microseconds(900 * 1000 * 1000);
+    const size_t MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT = 300;
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+    std::vector<ClientInfo* > clients;
+
+    //Create more clients than the server can attend, so the reactor has to stop watching the listener.
+    for(size_t i = 0; i < MAX_NUMBER_CLIENTS + 2; i++)
+    {
+        Client* client = new Client(TIMEOUT);
+        std::thread* clientThread = new std::thread([client, SERVER_DELAY]()
+        {
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_FALSE(client->sendDelayToServer(serverDelay));
+        });
+
+        ClientInfo* clientInfo = new ClientInfo(clientThread, client);
+        clients.push_back(clientInfo);
+    }
+
+    //Wait for all the clients to connect
+    for(size_t i = 0; i < MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT && server.getNumberOfClients() < MAX_NUMBER_CLIENTS; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(server.getNumberOfClients(), MAX_NUMBER_CLIENTS);
+
+    uint64_t MAX_ELAPSED_TIME = 60; //The maximum elapsed time before and after stopping all clients and server, in milliseconds.
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 10000;
+    }
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    server.stop();
+
+    //The two clients that were never accepted are still waiting in the listen backlog.
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->client->stop();
+    }
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->clientThread->join();
+        delete clients[i]->clientThread;
+        delete clients[i]->client;
+        delete clients[i];
+    }
+
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+}
+
+TEST_F(PipeTrickTest, WhenAClientTellsAReactorServerToSleepForAVeryLongTimeAndTheClientIsStopped_ThenTheServerStopsTheSleep)
+{
+    size_t const MAX_NUMBER_CLIENTS = 1;
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+
+    Client c1;
+    std::thread threadFirstClient = std::thread([&c1]()
+    {
+        std::chrono::milliseconds serverDelay(90 * 1000);
+        EXPECT_FALSE(c1.sendDelayToServer(serverDelay));
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
+    EXPECT_EQ(server.getNumberOfClients(), MAX_NUMBER_CLIENTS);
+    c1.stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
+    EXPECT_EQ(server.getNumberOfClients(), 0);
+    threadFirstClient.join();
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenAddingMoreClientsThanWorkersToAWorkerPoolServer_ThenTheServerReturnsTheCorrectIncreasedSleepingTimeForEachClient)
+{
+    const size_t MAX_NUMBER_CLIENTS = 30;
+    const size_t NUM_WORKERS = 4;
+    const size_t START_DELAY_MS = 20;
+    ServerOptions options;
+    options.mode = ServerMode::WORKER_POOL;
+    options.numWorkers = NUM_WORKERS;
+
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+
+    std::vector<ClientInfo* > clients;
+
+    //Create clients. Only 'NUM_WORKERS' of them are served at the same time, the rest wait in the queue of the pool.
+    for(size_t i = 0; i < MAX_NUMBER_CLIENTS; i++)
+    {
+        Client* client = new Client();
+        std::thread* clientThread = new std::thread([client, START_DELAY_MS, i]()
+        {
+            std::chrono::milliseconds serverDelay(START_DELAY_MS + i);
+            EXPECT_TRUE(client->sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), (START_DELAY_MS + i + 1));
+        });
+
+        ClientInfo* clientInfo = new ClientInfo(clientThread, client);
+        clients.push_back(clientInfo);
+    }
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->clientThread->join();
+        delete clients[i]->clientThread;
+        delete clients[i]->client;
+        delete clients[i];
+    }
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenStoppingAWorkerPoolServerWithQueuedClients_ThenTheQuitProcessIsFast)
+{
+    const size_t MAX_NUMBER_CLIENTS = 20;
+    const size_t NUM_WORKERS = 2;
+    const uint64_t SERVER_DELAY = 900 * 1000;
+    const size_t MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT = 300;
+    ServerOptions options;
+    options.mode = ServerMode::WORKER_POOL;
+    options.numWorkers = NUM_WORKERS;
+
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+    std::vector<ClientInfo* > clients;
+
+    for(size_t i = 0; i < MAX_NUMBER_CLIENTS; i++)
+    {
+        Client* client = new Client();
+        std::thread* clientThread = new std::thread([client, SERVER_DELAY]()
+        {
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_FALSE(client->sendDelayToServer(serverDelay));
+        });
+
+        ClientInfo* clientInfo = new ClientInfo(clientThread, client);
+        clients.push_back(clientInfo);
+    }
+
+    for(size_t i = 0; i < MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT && server.getNumberOfClients() < MAX_NUMBER_CLIENTS; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(server.getNumberOfClients(), MAX_NUMBER_CLIENTS);
+
+    uint64_t MAX_ELAPSED_TIME = 60; //The maximum elapsed time before and after stopping the server, in milliseconds.
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 10000;
+    }
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    server.stop();
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->clientThread->join();
+        delete clients[i]->clientThread;
+        delete clients[i]->client;
+        delete clients[i];
+    }
+
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+}
+
+TEST_F(PipeTrickTest, WhenAdvancingATimerWheel_ThenEachTimerExpiresAtItsTickAndCancelledTimersNeverExpire)
+{
+    //Delays that are stored in each one of the levels of the wheel.
+    const uint64_t DELAYS[] = {5, 255, 256, 300, 70000, 70001, 20000000};
+    const uint64_t CANCELLED_DELAY = 65536;
+    TimerWheel wheel;
+    std::vector<std::pair<uint64_t, uint64_t> > expirations; //The expected tick and the tick when the timer expired.
+
+    for (uint64_t delay : DELAYS)
+    {
+        wheel.add(delay, [&wheel, &expirations, delay]()
+        {
+            expirations.push_back(std::make_pair(delay, wheel.getCurrentTick()));
+        });
+    }
+    TimerWheel::TimerId cancelledTimer = wheel.add(CANCELLED_DELAY, [&expirations, CANCELLED_DELAY]()
+    {
+        expirations.push_back(std::make_pair(CANCELLED_DELAY, 0));
+    });
+    EXPECT_EQ(wheel.size(), 8);
+    EXPECT_TRUE(wheel.cancel(cancelledTimer));
+    EXPECT_FALSE(wheel.cancel(cancelledTimer));
+
+    //Advance in irregular steps, so the wheel has to cascade and jump over empty ticks.
+    for (uint64_t now = 0; now <= 20000000; now += 997)
+    {
+        wheel.advance(now);
+    }
+    wheel.advance(20000000);
+
+    ASSERT_EQ(expirations.size(), 7);
+    for (size_t i = 0; i < expirations.size(); i++)
+    {
+        EXPECT_EQ(expirations[i].first, DELAYS[i]);
+        EXPECT_EQ(expirations[i].second, DELAYS[i]);
+    }
+    EXPECT_EQ(wheel.size(), 0);
+    EXPECT_EQ(wheel.nextEventTick(), UINT64_MAX);
+}
+
+TEST_F(PipeTrickTest, WhenAddingSomeClientsWithDifferentSleepingTimesToAnIoUringServer_ThenTheServerReturnsTheCorrectIncreasedSleepingTimeForEachClient)
+{
+    const size_t MAX_NUMBER_CLIENTS = 30;
+    const size_t START_DELAY_MS = 200;
+    ServerOptions options;
+    options.mode = ServerMode::IO_URING;
+    ClientOptions clientOptions;
+    clientOptions.engine = ClientEngine::IO_URING;
+
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+
+    std::vector<ClientInfo* > clients;
+
+    //Create clients. Half of them use the io_uring engine too.
+    for(size_t i = 0; i < MAX_NUMBER_CLIENTS; i++)
+    {
+        Client* client = (i % 2) ? new Client(Client::DEFAULT_TIMEOUT, clientOptions) : new Client();
+        std::thread* clientThread = new std::thread([client, START_DELAY_MS, i]()
+        {
+            std::chrono::milliseconds serverDelay(START_DELAY_MS + i);
+            EXPECT_TRUE(client->sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), (START_DELAY_MS + i + 1));
+        });
+
+        ClientInfo* clientInfo = new ClientInfo(clientThread, client);
+        clients.push_back(clientInfo);
+    }
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->clientThread->join();
+        delete clients[i]->clientThread;
+        delete clients[i]->client;
+        delete clients[i];
+    }
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenConnectingALotOfClientsWithAHighTimeOutToAFullIoUringServerAndStoppingOnlyTheServer_ThenTheQuitProcessIsFast)
+{
+    const size_t MAX_NUMBER_CLIENTS = 200;
+    const uint64_t SERVER_DELAY = 900 * 1000;
+    const std::chrono::microseconds TIMEOUT = std::chrono::microseconds(900 * 1000 * 1000);
+    const size_t MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT = 300;
+    ServerOptions options;
+    options.mode = ServerMode::IO_URING;
+
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+    std::vector<ClientInfo* > clients;
+
+    for(size_t i = 0; i < MAX_NUMBER_CLIENTS + 2; i++)
+    {
+        Client* client = new Client(TIMEOUT);
+        std::thread* clientThread = new std::thread([client, SERVER_DELAY]()
+        {
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_FALSE(client->sendDelayToServer(serverDelay));
+        });
+
+        ClientInfo* clientInfo = new ClientInfo(clientThread, client);
+        clients.push_back(clientInfo);
+    }
+
+    for(size_t i = 0; i < MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT && server.getNumberOfClients() < MAX_NUMBER_CLIENTS; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(server.getNumberOfClients(), MAX_NUMBER_CLIENTS);
+
+    uint64_t MAX_ELAPSED_TIME = 60; //The maximum elapsed time before and after stopping all clients and server, in milliseconds.
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 10000;
+    }
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    server.stop();
+
+    //The clients accepted after the server became full are closed by 'stop' without being served.
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->client->stop();
+    }
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->clientThread->join();
+        delete clients[i]->clientThread;
+        delete clients[i]->client;
+        delete clients[i];
+    }
+
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+}
+
+TEST_F(PipeTrickTest, WhenAnIoUringClientConnectsToTwoDifferentServersAndClientIsStopped_ThenTheQuitProcessIsFast)
+{
+    const uint64_t LONG_DELAY = 90000;
+    const int SECOND_SERVER_PORT = 8081;
+    size_t const MAX_NUMBER_CLIENTS = 1;
+    uint64_t MAX_ELAPSED_TIME = 60; //The maximum elapsed time before and after stopping client and server, in milliseconds.
+
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 9000;
+    }
+
+    ServerOptions options;
+    options.mode = ServerMode::IO_URING;
+    Server server(MAX_NUMBER_CLIENTS, options);
+    Server server2(MAX_NUMBER_CLIENTS);
+    server.start();
+    server2.start(SECOND_SERVER_PORT);
+
+    ClientOptions clientOptions;
+    clientOptions.engine = ClientEngine::IO_URING;
+    Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+    std::thread threadFirstConnection([&client, LONG_DELAY](){
+        std::chrono::milliseconds serverDelay(LONG_DELAY);
+        EXPECT_FALSE(client.sendDelayToServer(serverDelay));
+    });
+
+    std::thread threadSecondConnection([&client, SECOND_SERVER_PORT, LONG_DELAY](){
+        std::chrono::milliseconds serverDelay(LONG_DELAY + 1);
+        EXPECT_FALSE(client.sendDelayToServer(serverDelay, "127.0.0.1", SECOND_SERVER_PORT));
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_EQ(server.getNumberOfClients(), MAX_NUMBER_CLIENTS);
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    client.stop();
+    threadSecondConnection.join();
+    threadFirstConnection.join();
+    server.stop();
+    server2.stop();
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+}
+
+TEST_F(PipeTrickTest, WhenSendingANegativeDelayToAnIoUringServer_ThenItIsAnsweredRightAwayWithTheDelayIncreasedByOne)
+{
+    const long NEGATIVE_DELAY = -5;
+    uint64_t MAX_ELAPSED_TIME = 60; //In milliseconds.
+
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 9000;
+    }
+
+    ServerOptions options;
+    options.mode = ServerMode::IO_URING;
+    Server server(1, options);
+    EXPECT_TRUE(server.start());
+    Client client;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    std::chrono::milliseconds serverDelay(NEGATIVE_DELAY);
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_EQ(serverDelay.count(), NEGATIVE_DELAY + 1);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenAddingSomeClientsWithDifferentSleepingTimesToAServerWithSeveralAcceptors_ThenTheServerReturnsTheCorrectIncreasedSleepingTimeForEachClient)
+{
+    const size_t MAX_NUMBER_CLIENTS = 30;
+    const size_t NUM_ACCEPTORS = 4;
+    const size_t START_DELAY_MS = 20;
+    ServerOptions options;
+    options.numAcceptors = NUM_ACCEPTORS;
+
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+
+    std::vector<ClientInfo* > clients;
+
+    for(size_t i = 0; i < MAX_NUMBER_CLIENTS; i++)
+    {
+        Client* client = new Client();
+        std::thread* clientThread = new std::thread([client, START_DELAY_MS, i]()
+        {
+            std::chrono::milliseconds serverDelay(START_DELAY_MS + i);
+            EXPECT_TRUE(client->sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), (START_DELAY_MS + i + 1));
+        });
+
+        ClientInfo* clientInfo = new ClientInfo(clientThread, client);
+        clients.push_back(clientInfo);
+    }
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->clientThread->join();
+        delete clients[i]->clientThread;
+        delete clients[i]->client;
+        delete clients[i];
+    }
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenConnectingMoreClientsThanTheMaximumToAServerWithSeveralAcceptors_ThenTheMaximumIsNotExceededAndTheQuitProcessIsFast)
+{
+    const size_t MAX_NUMBER_CLIENTS = 8;
+    const size_t NUM_ACCEPTORS = 4;
+    const size_t NUM_CLIENTS = 60;
+    const uint64_t SERVER_DELAY = 900 * 1000;
+    const std::chrono::microseconds TIMEOUT = std::chrono::microseconds(900 * 1000 * 1000);
+    const size_t MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT = 300;
+    ServerOptions options;
+    options.numAcceptors = NUM_ACCEPTORS;
+
+    Server server(MAX_NUMBER_CLIENTS, options);
+    server.start();
+    std::vector<ClientInfo* > clients;
+
+    //The kernel spreads the clients among the acceptors, and each acceptor only attends its share of the maximum number of clients.
+    for(size_t i = 0; i < NUM_CLIENTS; i++)
+    {
+        Client* client = new Client(TIMEOUT);
+        std::thread* clientThread = new std::thread([client, SERVER_DELAY]()
+        {
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_FALSE(client->sendDelayToServer(serverDelay));
+        });
+
+        ClientInfo* clientInfo = new ClientInfo(clientThread, client);
+        clients.push_back(clientInfo);
+    }
+
+    for(size_t i = 0; i < MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT && server.getNumberOfClients() < MAX_NUMBER_CLIENTS; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(server.getNumberOfClients(), MAX_NUMBER_CLIENTS);
+
+    uint64_t MAX_ELAPSED_TIME = 60; //The maximum elapsed time before and after stopping all clients and server, in milliseconds.
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 10000;
+    }
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    server.stop();
+
+    //The clients that were never accepted are still waiting in the listen backlogs.
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->client->stop();
+    }
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+        clients[i]->clientThread->join();
+        delete clients[i]->clientThread;
+        delete clients[i]->client;
+        delete clients[i];
+    }
+
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+}
+
+TEST_F(PipeTrickTest, WhenAClientWithEachWakeupTypeIsStoppedAndThenReused_ThenTheQuitProcessIsFastAndTheNextDelayIsServed)
+{
+    const uint64_t LONG_DELAY = 90000;
+    const uint64_t SHORT_DELAY = 10;
+    size_t const MAX_NUMBER_CLIENTS = 1;
+    uint64_t MAX_ELAPSED_TIME = 60; //The maximum elapsed time before and after stopping client and server, in milliseconds.
+
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 9000;
+    }
+
+    for (WakeupType wakeup : {WakeupType::PIPE, WakeupType::EVENTFD, WakeupType::SIGNALFD})
+    {
+        ServerOptions serverOptions;
+        serverOptions.wakeup = wakeup;
+        ClientOptions clientOptions;
+        clientOptions.wakeup = wakeup;
+
+        Server server(MAX_NUMBER_CLIENTS, serverOptions);
+        EXPECT_TRUE(server.start());
+        Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+        std::thread clientThread([&client, LONG_DELAY](){
+            std::chrono::milliseconds serverDelay(LONG_DELAY);
+            EXPECT_FALSE(client.sendDelayToServer(serverDelay));
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        client.stop();
+        clientThread.join();
+        std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+        EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+
+        //The notification was consumed by 'stop', so the client is not woken up again.
+        std::chrono::milliseconds serverDelay(SHORT_DELAY);
+        EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        EXPECT_EQ(serverDelay.count(), SHORT_DELAY + 1);
+
+        begin = std::chrono::steady_clock::now();
+        server.stop();
+        elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+        EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+    }
+}
+
+TEST_F(PipeTrickTest, WhenSendingSeveralDelaysThroughAKeepAliveClient_ThenOneConnectionServesAllOfThemUntilItIsIdleForTooLong)
+{
+    const size_t NUM_REQUESTS = 20;
+    const uint64_t SHORT_DELAY = 2;
+    const std::chrono::milliseconds KEEP_ALIVE_TIMEOUT(200);
+    size_t const MAX_NUMBER_CLIENTS = 1;
+
+    const std::pair<ServerMode, ClientEngine> MODES[] =
+    {
+        {ServerMode::THREAD_PER_CLIENT, ClientEngine::SELECT},
+        {ServerMode::REACTOR, ClientEngine::SELECT},
+        {ServerMode::IO_URING, ClientEngine::IO_URING},
+        {ServerMode::COROUTINE, ClientEngine::SELECT}
+    };
+
+    for (const auto& mode : MODES)
+    {
+        ServerOptions serverOptions;
+        serverOptions.mode = mode.first;
+        serverOptions.keepAliveTimeOut = KEEP_ALIVE_TIMEOUT;
+        ClientOptions clientOptions;
+        clientOptions.engine = mode.second;
+        clientOptions.keepAlive = true;
+
+        Server server(MAX_NUMBER_CLIENTS, serverOptions);
+        EXPECT_TRUE(server.start());
+        Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+        //The server only attends one client at a time, so every request after the first one would time out if it needed a new connection.
+        for (size_t i = 0; i < NUM_REQUESTS; i++)
+        {
+            std::chrono::milliseconds serverDelay(SHORT_DELAY + i);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), SHORT_DELAY + i + 1);
+            EXPECT_EQ(server.getNumberOfClients(), 1);
+        }
+
+        //Once the connection is idle for too long, the server closes it and the client has to connect again.
+        std::this_thread::sleep_for(KEEP_ALIVE_TIMEOUT * 2);
+        EXPECT_EQ(server.getNumberOfClients(), 0);
+        std::chrono::milliseconds serverDelay(SHORT_DELAY);
+        EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        EXPECT_EQ(serverDelay.count(), SHORT_DELAY + 1);
+
+        server.stop();
+    }
+}
+
+TEST_F(PipeTrickTest, WhenAKeepAliveClientSendsDelaysToAServerWithoutKeepAlive_ThenEveryDelayIsServedOnANewConnection)
+{
+    const size_t NUM_REQUESTS = 10;
+    const uint64_t SHORT_DELAY = 2;
+    size_t const MAX_NUMBER_CLIENTS = 1;
+
+    ClientOptions clientOptions;
+    clientOptions.keepAlive = true;
+
+    Server server(MAX_NUMBER_CLIENTS);
+    server.start();
+    Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+    for (size_t i = 0; i < NUM_REQUESTS; i++)
+    {
+        std::chrono::milliseconds serverDelay(SHORT_DELAY + i);
+        EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        EXPECT_EQ(serverDelay.count(), SHORT_DELAY + i + 1);
+    }
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenARequestWithoutSleepingTimeIsAnsweredByTheReactor_ThenTheConnectionIsClosedWithoutWaitingForThePeer)
+{
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+    Server server(2, options);
+    EXPECT_TRUE(server.start());
+
+    //A raw socket, which is kept open after the response, unlike the ones of 'Client'.
+    int socketDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr(Client::DEFAULT_IP);
+    address.sin_port = htons(DEFAULT_PORT);
+    ASSERT_EQ(connect(socketDescriptor, (struct sockaddr*) &address, sizeof(address)), 0);
+
+    char buffer[BUFFER_SIZE];
+    memset(buffer, 0, BUFFER_SIZE);
+    strcpy(buffer, "0");
+    EXPECT_TRUE(Common::writeMessage(socketDescriptor, buffer));
+    EXPECT_TRUE(Common::readMessage(socketDescriptor, buffer));
+    EXPECT_EQ(atoi(buffer), 1);
+
+    //The server closes its end, so the read returns the end of file instead of timing out.
+    struct timeval timeOut = {1, 0};
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeOut, sizeof(timeOut));
+    ssize_t bytes;
+    do
+    {
+        bytes = read(socketDescriptor, buffer, BUFFER_SIZE);
+    } while (bytes == -1 && errno == EINTR);
+    EXPECT_EQ(bytes, 0);
+    EXPECT_EQ(server.getNumberOfClients(), 0u);
+
+    close(socketDescriptor);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenAKeepAliveClientSendsPartOfItsNextMessageToTheUringServer_ThenTheConnectionStillTimesOut)
+{
+    ServerOptions options;
+    options.mode = ServerMode::IO_URING;
+    options.keepAliveTimeOut = std::chrono::milliseconds(100);
+    Server server(2, options);
+    EXPECT_TRUE(server.start());
+
+    int socketDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr(Client::DEFAULT_IP);
+    address.sin_port = htons(DEFAULT_PORT);
+    ASSERT_EQ(connect(socketDescriptor, (struct sockaddr*) &address, sizeof(address)), 0);
+
+    //A whole message and, once it is answered, the first bytes of the next one, which never arrives.
+    char buffer[BUFFER_SIZE];
+    memset(buffer, 0, BUFFER_SIZE);
+    strcpy(buffer, "1");
+    EXPECT_TRUE(Common::writeMessage(socketDescriptor, buffer));
+    EXPECT_TRUE(Common::readMessage(socketDescriptor, buffer));
+    EXPECT_EQ(write(socketDescriptor, buffer, 2), 2);
+
+    struct timeval timeOut = {2, 0};
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeOut, sizeof(timeOut));
+    ssize_t bytes;
+    do
+    {
+        bytes = read(socketDescriptor, buffer, BUFFER_SIZE);
+    } while (bytes == -1 && errno == EINTR);
+    EXPECT_EQ(bytes, 0);
+    EXPECT_EQ(server.getNumberOfClients(), 0u);
+
+    close(socketDescriptor);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenPipeliningDelaysOnAMultiplexedConnection_ThenShortDelaysAreAnsweredBeforeLongOnes)
+{
+    const uint64_t LONG_DELAY = 600;
+    const uint64_t SHORT_DELAY = 10;
+    size_t const MAX_NUMBER_CLIENTS = 1;
+    uint64_t MAX_SHORT_ELAPSED_TIME = 300; //Well below 'LONG_DELAY', in milliseconds.
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_SHORT_ELAPSED_TIME = 3000;
+    }
+
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::REACTOR, ServerMode::IO_URING})
+    {
+        ServerOptions serverOptions;
+        serverOptions.mode = mode;
+        ClientOptions clientOptions;
+        clientOptions.multiplex = true;
+
+        Server server(MAX_NUMBER_CLIENTS, serverOptions);
+        EXPECT_TRUE(server.start());
+        Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+        //Both requests share the only connection the server attends, so the short one would time out if it needed another connection.
+        std::thread longRequest([&client, LONG_DELAY]()
+        {
+            std::chrono::milliseconds serverDelay(LONG_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), LONG_DELAY + 1);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        std::chrono::milliseconds serverDelay(SHORT_DELAY);
+        EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        EXPECT_EQ(serverDelay.count(), SHORT_DELAY + 1);
+        std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+        EXPECT_LT(elapsedTime.count(), MAX_SHORT_ELAPSED_TIME);
+        EXPECT_EQ(server.getNumberOfClients(), 1);
+        longRequest.join();
+
+        //The requests of one call sleep at the same time, so they take as long as the longest one.
+        std::vector<std::chrono::milliseconds> serverDelays = {std::chrono::milliseconds(200), std::chrono::milliseconds(SHORT_DELAY), std::chrono::milliseconds(150)};
+        begin = std::chrono::steady_clock::now();
+        EXPECT_TRUE(client.sendDelaysToServer(serverDelays));
+        elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+        EXPECT_EQ(serverDelays[0].count(), 201);
+        EXPECT_EQ(serverDelays[1].count(), SHORT_DELAY + 1);
+        EXPECT_EQ(serverDelays[2].count(), 151);
+        EXPECT_LT(elapsedTime.count(), 200 + MAX_SHORT_ELAPSED_TIME);
+
+        server.stop();
+    }
+}
+
+TEST_F(PipeTrickTest, WhenPipeliningDelaysToAnIoUringServer_ThenEveryDelayIsAnsweredOnOneConnection)
+{
+    const size_t NUM_REQUESTS = 20;
+    const uint64_t SHORT_DELAY = 2;
+    size_t const MAX_NUMBER_CLIENTS = 1;
+    const std::chrono::milliseconds KEEP_ALIVE_TIME_OUT(100);
+
+    ServerOptions serverOptions;
+    serverOptions.mode = ServerMode::IO_URING;
+    serverOptions.keepAliveTimeOut = KEEP_ALIVE_TIME_OUT;
+    Server server(MAX_NUMBER_CLIENTS, serverOptions);
+    EXPECT_TRUE(server.start());
+    Client client;
+
+    //The delays decrease, so each request expires before the ones read earlier.
+    std::vector<std::chrono::milliseconds> serverDelays;
+    for (size_t i = 0; i < NUM_REQUESTS; i++)
+    {
+        serverDelays.push_back(std::chrono::milliseconds(SHORT_DELAY + NUM_REQUESTS - i));
+    }
+    EXPECT_TRUE(client.sendDelaysToServer(serverDelays));
+    for (size_t i = 0; i < NUM_REQUESTS; i++)
+    {
+        EXPECT_EQ(serverDelays[i].count(), SHORT_DELAY + NUM_REQUESTS - i + 1);
+    }
+    EXPECT_EQ(server.getNumberOfClients(), 1);
+
+    //Once every request is answered, the multiplexed connection is closed after being idle for too long.
+    std::this_thread::sleep_for(KEEP_ALIVE_TIME_OUT * 3);
+    EXPECT_EQ(server.getNumberOfClients(), 0);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenAMultiplexedClientIsStoppedWhileWaiting_ThenTheQuitProcessIsFastAndTheConnectionIsReused)
+{
+    size_t const MAX_NUMBER_CLIENTS = 1;
+    ClientOptions clientOptions;
+    clientOptions.multiplex = true;
+    uint64_t MAX_ELAPSED_TIME = 100;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    Server server(MAX_NUMBER_CLIENTS);
+    server.start();
+    Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+    std::thread waitingRequest([&client]()
+    {
+        std::chrono::milliseconds serverDelay(90 * 1000);
+        EXPECT_FALSE(client.sendDelayToServer(serverDelay));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    client.stop();
+    waitingRequest.join();
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+
+    //The abandoned request keeps sleeping in the server, but the connection still serves the next ones.
+    std::chrono::milliseconds serverDelay(2);
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    EXPECT_EQ(serverDelay.count(), 3);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenEncodingBinaryMessages_ThenTheyAreDecodedBackAndAreMuchSmallerThanTextMessages)
+{
+    const std::pair<long, uint32_t> MESSAGES[] =
+    {
+        {0, NO_REQUEST_ID}, {1, 1}, {-1, 2}, {127, 128}, {-65, 300}, {90 * 1000 * 1000, UINT32_MAX}, {INT64_MIN, 7}, {INT64_MAX, 8}
+    };
+
+    for (const auto& message : MESSAGES)
+    {
+        char buffer[BUFFER_SIZE];
+        size_t size = Common::encodeFrame(buffer, Common::FrameFormat::BINARY, message.first, message.second);
+        EXPECT_LE(size, MAX_BINARY_FRAME_SIZE);
+        EXPECT_TRUE(Common::getFrameFormat(buffer) == Common::FrameFormat::BINARY);
+        EXPECT_EQ(Common::getFrameSize(buffer, 1), 0);
+        EXPECT_EQ(Common::getFrameSize(buffer, size), size);
+
+        long delay;
+        uint32_t requestId;
+        EXPECT_TRUE(Common::decodeFrame(buffer, delay, requestId));
+        EXPECT_EQ(delay, message.first);
+        EXPECT_EQ(requestId, message.second);
+    }
+
+    char buffer[BUFFER_SIZE];
+    EXPECT_EQ(Common::encodeFrame(buffer, Common::FrameFormat::TEXT, 5, 3), BUFFER_SIZE);
+    EXPECT_TRUE(Common::getFrameFormat(buffer) == Common::FrameFormat::TEXT);
+    EXPECT_EQ(Common::getFrameSize(buffer, 1), BUFFER_SIZE);
+}
+
+TEST_F(PipeTrickTest, WhenSendingBinaryAndTextMessagesToEveryServerMode_ThenEachResponseHasTheFormatOfItsRequest)
+{
+    const size_t NUM_REQUESTS = 10;
+    const uint64_t SHORT_DELAY = 2;
+    size_t const MAX_NUMBER_CLIENTS = 4;
+
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::REACTOR, ServerMode::IO_URING, ServerMode::COROUTINE})
+    {
+        ServerOptions serverOptions;
+        serverOptions.mode = mode;
+        serverOptions.keepAliveTimeOut = std::chrono::milliseconds(1000);
+        Server server(MAX_NUMBER_CLIENTS, serverOptions);
+        EXPECT_TRUE(server.start());
+
+        for (ClientEngine engine : {ClientEngine::SELECT, ClientEngine::IO_URING})
+        {
+            for (bool keepAlive : {false, true})
+            {
+                ClientOptions clientOptions;
+                clientOptions.engine = engine;
+                clientOptions.keepAlive = keepAlive;
+                clientOptions.frameFormat = Common::FrameFormat::BINARY;
+                Client binaryClient(Client::DEFAULT_TIMEOUT, clientOptions);
+                clientOptions.frameFormat = Common::FrameFormat::TEXT;
+                Client textClient(Client::DEFAULT_TIMEOUT, clientOptions);
+
+                for (size_t i = 0; i < NUM_REQUESTS; i++)
+                {
+                    std::chrono::milliseconds serverDelay(SHORT_DELAY + i);
+                    EXPECT_TRUE(binaryClient.sendDelayToServer(serverDelay));
+                    EXPECT_EQ(serverDelay.count(), SHORT_DELAY + i + 1);
+                    serverDelay = std::chrono::milliseconds(SHORT_DELAY + i);
+                    EXPECT_TRUE(textClient.sendDelayToServer(serverDelay));
+                    EXPECT_EQ(serverDelay.count(), SHORT_DELAY + i + 1);
+                }
+            }
+        }
+
+        //Many binary messages arrive in a single read.
+        ClientOptions clientOptions;
+        clientOptions.frameFormat = Common::FrameFormat::BINARY;
+        Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+        std::vector<std::chrono::milliseconds> serverDelays;
+        for (size_t i = 0; i < NUM_REQUESTS * 10; i++)
+        {
+            serverDelays.push_back(std::chrono::milliseconds(i % 5));
+        }
+        EXPECT_TRUE(client.sendDelaysToServer(serverDelays));
+        for (size_t i = 0; i < serverDelays.size(); i++)
+        {
+            EXPECT_EQ(serverDelays[i].count(), static_cast<long>(i % 5) + 1);
+        }
+        server.stop();
+    }
+}
+
+TEST_F(PipeTrickTest, WhenSendingMoreConcurrentDelaysThanTheMaximumConnectionsOfThePool_ThenTheServerNeverSeesMoreConnectionsAndStopCancelsTheWaitingOnes)
+{
+    const size_t NUM_THREADS = 6;
+    const uint64_t SERVER_DELAY = 60;
+    size_t const MAX_NUMBER_CLIENTS = 20;
+    ClientOptions clientOptions;
+    clientOptions.keepAlive = true;
+    clientOptions.pool.maxTotal = 2;
+
+    ServerOptions serverOptions;
+    serverOptions.keepAliveTimeOut = std::chrono::milliseconds(1000);
+    Server server(MAX_NUMBER_CLIENTS, serverOptions);
+    server.start();
+    Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+    std::atomic<bool> finished(false);
+    size_t maxConnectedClients = 0;
+    std::thread monitor([&]()
+    {
+        while (!finished)
+        {
+            maxConnectedClients = std::max(maxConnectedClients, server.getNumberOfClients());
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < NUM_THREADS; i++)
+    {
+        threads.emplace_back([&client, SERVER_DELAY]()
+        {
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), SERVER_DELAY + 1);
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    finished = true;
+    monitor.join();
+    EXPECT_LE(maxConnectedClients, clientOptions.pool.maxTotal);
+    EXPECT_EQ(server.getNumberOfClients(), clientOptions.pool.maxTotal);
+
+    //Both connections are busy, so the other requests wait for the pool until 'stop' is called.
+    threads.clear();
+    for (size_t i = 0; i < NUM_THREADS; i++)
+    {
+        threads.emplace_back([&client]()
+        {
+            std::chrono::milliseconds serverDelay(90 * 1000);
+            EXPECT_FALSE(client.sendDelayToServer(serverDelay));
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
+
+    uint64_t MAX_ELAPSED_TIME = 100;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    client.stop();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+
+    std::chrono::milliseconds serverDelay(2);
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenConnectionsAreCheckedInToAPool_ThenTheExtraIdleOnesAndTheExpiredOnesAreClosed)
+{
+    const size_t NUM_THREADS = 4;
+    const uint64_t SERVER_DELAY = 60;
+    size_t const MAX_NUMBER_CLIENTS = 20;
+    ClientOptions clientOptions;
+    clientOptions.keepAlive = true;
+    clientOptions.pool.maxIdle = 1;
+    clientOptions.pool.maxIdleTime = std::chrono::milliseconds(100);
+
+    ServerOptions serverOptions;
+    serverOptions.keepAliveTimeOut = std::chrono::milliseconds(5000);
+    Server server(MAX_NUMBER_CLIENTS, serverOptions);
+    server.start();
+    Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < NUM_THREADS; i++)
+    {
+        threads.emplace_back([&client, SERVER_DELAY]()
+        {
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    //Only one of the connections is kept.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(server.getNumberOfClients(), 1);
+
+    //The idle connection expires, so the next request is served on a new one.
+    std::this_thread::sleep_for(clientOptions.pool.maxIdleTime * 2);
+    std::chrono::milliseconds serverDelay(2);
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(server.getNumberOfClients(), 1);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenSendingManyAsynchronousDelaysFromOneThread_ThenAllOfThemAreInFlightAtOnceAndAnsweredCorrectly)
+{
+    const size_t NUMBER_OF_REQUESTS = 200;
+    const long SERVER_DELAY = 300;
+    uint64_t MAX_ELAPSED_TIME = 2 * SERVER_DELAY; //Much less than 'NUMBER_OF_REQUESTS' sequential delays.
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 9000;
+    }
+
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+    Server server(NUMBER_OF_REQUESTS, options);
+    server.start();
+    Client client;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    std::vector<std::future<AsyncResponse> > responses;
+    for (size_t i = 0; i < NUMBER_OF_REQUESTS; i++)
+    {
+        responses.push_back(client.sendDelayToServerAsync(std::chrono::milliseconds(SERVER_DELAY + i)));
+    }
+
+    for (size_t i = 0; i < NUMBER_OF_REQUESTS; i++)
+    {
+        AsyncResponse response = responses[i].get();
+        EXPECT_TRUE(response.success);
+        EXPECT_EQ(response.serverDelay.count(), static_cast<long>(SERVER_DELAY + i + 1));
+    }
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+
+    //The callback flavour can chain the next request from the event loop thread.
+    std::promise<AsyncResponse> chainedResponse;
+    client.sendDelayToServerAsync(std::chrono::milliseconds(1), [&client, &chainedResponse](const AsyncResponse& response)
+    {
+        EXPECT_TRUE(response.success);
+        client.sendDelayToServerAsync(response.serverDelay, [&chainedResponse](const AsyncResponse& chained)
+        {
+            chainedResponse.set_value(chained);
+        });
+    });
+    AsyncResponse response = chainedResponse.get_future().get();
+    EXPECT_TRUE(response.success);
+    EXPECT_EQ(response.serverDelay.count(), 3);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenStoppingAClientWithManyAsynchronousDelaysInFlight_ThenAllOfThemFailFastAndTheClientIsReused)
+{
+    const size_t NUMBER_OF_REQUESTS = 100;
+    uint64_t MAX_ELAPSED_TIME = 100;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    ServerOptions options;
+    options.mode = ServerMode::REACTOR;
+    Server server(NUMBER_OF_REQUESTS, options);
+    server.start();
+    Client client;
+
+    std::atomic<size_t> failedRequests(0);
+    for (size_t i = 0; i < NUMBER_OF_REQUESTS; i++)
+    {
+        client.sendDelayToServerAsync(std::chrono::milliseconds(90 * 1000), [&failedRequests](const AsyncResponse& response)
+        {
+            EXPECT_FALSE(response.success);
+            failedRequests++;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    client.stop();
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+    EXPECT_EQ(failedRequests, NUMBER_OF_REQUESTS);
+
+    AsyncResponse response = client.sendDelayToServerAsync(std::chrono::milliseconds(2)).get();
+    EXPECT_TRUE(response.success);
+    EXPECT_EQ(response.serverDelay.count(), 3);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenManyClientsSleepInACoroutineServer_ThenEachOneOnlyHoldsASmallFrameAndTheQuitProcessIsFast)
+{
+    const size_t MAX_NUMBER_CLIENTS = 200;
+    const size_t MAX_FRAME_SIZE = 1024; //A suspended request must not hold a message buffer, let alone a thread stack.
+    const size_t MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT = 300;
+    uint64_t MAX_ELAPSED_TIME = 100;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    ServerOptions options;
+    options.mode = ServerMode::COROUTINE;
+    Server server(MAX_NUMBER_CLIENTS, options);
+    EXPECT_TRUE(server.start());
+    Client client;
+
+    std::atomic<size_t> failedRequests(0);
+    for (size_t i = 0; i < MAX_NUMBER_CLIENTS; i++)
+    {
+        client.sendDelayToServerAsync(std::chrono::milliseconds(90 * 1000), [&failedRequests](const AsyncResponse& response)
+        {
+            EXPECT_FALSE(response.success);
+            failedRequests++;
+        });
+    }
+
+    for(size_t i = 0; i < MAX_NUMBER_OF_TRIES_TO_WAIT_FOR_ALL_CLIENTS_TO_CONNECT && server.getNumberOfClients() < MAX_NUMBER_CLIENTS; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(server.getNumberOfClients(), MAX_NUMBER_CLIENTS);
+
+    //One coroutine per client in the server, and one per request in the client.
+    EXPECT_GE(FramePool::getNumberOfFrames(), 2 * MAX_NUMBER_CLIENTS);
+    EXPECT_LT(FramePool::getMaximumFrameSize(), MAX_FRAME_SIZE);
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    server.stop();
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+    EXPECT_EQ(server.getNumberOfClients(), 0);
+
+    client.stop();
+    EXPECT_EQ(failedRequests, MAX_NUMBER_CLIENTS);
+}
+
+namespace
+{
+
+/**
+ * @return The number of entries of the directory 'path' of procfs.
+ */
+size_t countProcEntries(const char* path)
+{
+    return std::distance(std::filesystem::directory_iterator(path), std::filesystem::directory_iterator());
+}
+
+}
+
+TEST_F(PipeTrickTest, WhenManyClientsShareOneReactor_ThenTheyOwnNoDescriptorsNorThreadsAndAllTheirRequestsAreAnswered)
+{
+    const size_t NUMBER_OF_CLIENTS = 100;
+    const long SHORT_DELAY = 50;
+
+    ServerOptions serverOptions;
+    serverOptions.mode = ServerMode::REACTOR;
+    Server server(2 * NUMBER_OF_CLIENTS, serverOptions);
+    EXPECT_TRUE(server.start());
+    ClientReactor reactor(2);
+    EXPECT_TRUE(reactor.start());
+
+    size_t descriptorsBefore = countProcEntries("/proc/self/fd");
+    size_t threadsBefore = countProcEntries("/proc/self/task");
+    ClientOptions clientOptions;
+    clientOptions.reactor = &reactor;
+    std::vector<std::unique_ptr<Client> > clients;
+    for (size_t i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+        clients.emplace_back(new Client(Client::DEFAULT_TIMEOUT, clientOptions));
+    }
+    EXPECT_LE(countProcEntries("/proc/self/fd"), descriptorsBefore);
+
+    std::vector<std::future<AsyncResponse> > responses;
+    for (size_t i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+        responses.push_back(clients[i]->sendDelayToServerAsync(std::chrono::milliseconds(SHORT_DELAY + i)));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(SHORT_DELAY / 2));
+    EXPECT_LE(countProcEntries("/proc/self/task"), threadsBefore);
+
+    for (size_t i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+        AsyncResponse response = responses[i].get();
+        EXPECT_TRUE(response.success);
+        EXPECT_EQ(response.serverDelay.count(), static_cast<long>(SHORT_DELAY + i + 1));
+    }
+
+    //The blocking calls wait for the reactor as well.
+    std::chrono::milliseconds serverDelay(2);
+    EXPECT_TRUE(clients[0]->sendDelayToServer(serverDelay));
+    EXPECT_EQ(serverDelay.count(), 3);
+    std::vector<std::chrono::milliseconds> serverDelays = {std::chrono::milliseconds(5), std::chrono::milliseconds(1)};
+    EXPECT_TRUE(clients[1]->sendDelaysToServer(serverDelays));
+    EXPECT_EQ(serverDelays[0].count(), 6);
+    EXPECT_EQ(serverDelays[1].count(), 2);
+
+    clients.clear();
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenStoppingOneClientOfASharedReactor_ThenOnlyItsRequestsAreCancelled)
+{
+    const size_t NUMBER_OF_REQUESTS = 10;
+    const long SHORT_DELAY = 300;
+    uint64_t MAX_ELAPSED_TIME = 100;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    ServerOptions serverOptions;
+    serverOptions.mode = ServerMode::REACTOR;
+    Server server(2 * NUMBER_OF_REQUESTS, serverOptions);
+    EXPECT_TRUE(server.start());
+    ClientOptions clientOptions;
+    clientOptions.reactor = &ClientReactor::getShared();
+    Client stoppedClient(Client::DEFAULT_TIMEOUT, clientOptions);
+    Client runningClient(Client::DEFAULT_TIMEOUT, clientOptions);
+
+    std::vector<std::future<AsyncResponse> > stoppedResponses;
+    std::vector<std::future<AsyncResponse> > runningResponses;
+    for (size_t i = 0; i < NUMBER_OF_REQUESTS; i++)
+    {
+        stoppedResponses.push_back(stoppedClient.sendDelayToServerAsync(std::chrono::milliseconds(90 * 1000)));
+        runningResponses.push_back(runningClient.sendDelayToServerAsync(std::chrono::milliseconds(SHORT_DELAY)));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    stoppedClient.stop();
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+
+    for (size_t i = 0; i < NUMBER_OF_REQUESTS; i++)
+    {
+        EXPECT_FALSE(stoppedResponses[i].get().success);
+        AsyncResponse response = runningResponses[i].get();
+        EXPECT_TRUE(response.success);
+        EXPECT_EQ(response.serverDelay.count(), SHORT_DELAY + 1);
+    }
+
+    std::chrono::milliseconds serverDelay(2);
+    EXPECT_TRUE(stoppedClient.sendDelayToServer(serverDelay));
+    EXPECT_EQ(serverDelay.count(), 3);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenFanningOutADelayToSeveralServers_ThenItCompletesOnTheQuorumAndTheStragglersAreCancelled)
+{
+    const long SERVER_DELAY = 50;
+    const int FIRST_PORT = DEFAULT_PORT + 10;
+    uint64_t MAX_ELAPSED_TIME = 4 * SERVER_DELAY;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    Server firstServer(2);
+    Server secondServer(2);
+    EXPECT_TRUE(firstServer.start(FIRST_PORT));
+    EXPECT_TRUE(secondServer.start(FIRST_PORT + 1));
+
+    //A listener that never accepts: the connection succeeds, but the request is never answered.
+    int blackHole = socket(AF_INET, SOCK_STREAM, 0);
+    int reuseAddress = 1;
+    setsockopt(blackHole, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+    struct sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr(Client::DEFAULT_IP);
+    address.sin_port = htons(FIRST_PORT + 2);
+    EXPECT_EQ(bind(blackHole, (struct sockaddr*) &address, sizeof(address)), 0);
+    EXPECT_EQ(listen(blackHole, 8), 0);
+
+    std::vector<Endpoint> endpoints = {{Client::DEFAULT_IP, FIRST_PORT}, {Client::DEFAULT_IP, FIRST_PORT + 2}, {Client::DEFAULT_IP, FIRST_PORT + 1}};
+    Client client;
+    std::vector<AsyncResponse> responses;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    EXPECT_TRUE(client.sendDelayToServers(std::chrono::milliseconds(SERVER_DELAY), endpoints, 2, responses));
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+    ASSERT_EQ(responses.size(), endpoints.size());
+    EXPECT_TRUE(responses[0].success);
+    EXPECT_EQ(responses[0].serverDelay.count(), SERVER_DELAY + 1);
+    EXPECT_FALSE(responses[1].success);
+    EXPECT_TRUE(responses[2].success);
+    EXPECT_EQ(responses[2].serverDelay.count(), SERVER_DELAY + 1);
+
+    //The black hole never answers, so the whole quorum is only given up by 'stop'.
+    std::thread stopper([&client]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(90));
+        client.stop();
+    });
+    begin = std::chrono::steady_clock::now();
+    EXPECT_FALSE(client.sendDelayToServers(std::chrono::milliseconds(SERVER_DELAY), endpoints, endpoints.size(), responses));
+    elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    stopper.join();
+    EXPECT_LT(elapsedTime.count(), 90 + MAX_ELAPSED_TIME);
+    EXPECT_TRUE(responses[0].success);
+    EXPECT_FALSE(responses[1].success);
+    EXPECT_TRUE(responses[2].success);
+
+    close(blackHole);
+    firstServer.stop();
+    secondServer.stop();
+}
+
+TEST_F(PipeTrickTest, WhenTheFirstServerIsSlowerThanTheHedgingDelay_ThenTheRequestIsHedgedAndTheFirstResponseWins)
+{
+    const long SERVER_DELAY = 10;
+    const int FIRST_PORT = DEFAULT_PORT + 20;
+    const size_t NUMBER_OF_REQUESTS = 30;
+    uint64_t MAX_ELAPSED_TIME = 200;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    Server server(2);
+    EXPECT_TRUE(server.start(FIRST_PORT));
+
+    //A listener that never accepts, as the slowest possible server.
+    int blackHole = socket(AF_INET, SOCK_STREAM, 0);
+    int reuseAddress = 1;
+    setsockopt(blackHole, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+    struct sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr(Client::DEFAULT_IP);
+    address.sin_port = htons(FIRST_PORT + 1);
+    EXPECT_EQ(bind(blackHole, (struct sockaddr*) &address, sizeof(address)), 0);
+    EXPECT_EQ(listen(blackHole, 64), 0);
+
+    ClientOptions options;
+    options.hedging.endpoint = {Client::DEFAULT_IP, FIRST_PORT};
+    options.hedging.initialDelay = std::chrono::milliseconds(20);
+    Client hedgedClient(Client::DEFAULT_TIMEOUT, options);
+    std::chrono::milliseconds serverDelay(SERVER_DELAY);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    EXPECT_TRUE(hedgedClient.sendDelayToServer(serverDelay, Client::DEFAULT_IP, FIRST_PORT + 1));
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+    EXPECT_GE(elapsedTime.count(), SERVER_DELAY + options.hedging.initialDelay.count());
+    EXPECT_EQ(serverDelay.count(), SERVER_DELAY + 1);
+
+    //The first server answers before the hedging delay, taken from the recorded latencies once there are enough of them.
+    options.hedging.endpoint = {Client::DEFAULT_IP, FIRST_PORT + 1};
+    Client client(Client::DEFAULT_TIMEOUT, options);
+    for (size_t i = 0; i < NUMBER_OF_REQUESTS; i++)
+    {
+        serverDelay = std::chrono::milliseconds(1);
+        EXPECT_TRUE(client.sendDelayToServer(serverDelay, Client::DEFAULT_IP, FIRST_PORT));
+        EXPECT_EQ(serverDelay.count(), 2);
+    }
+
+    close(blackHole);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenAClientIsBuiltFromSeveralServers_ThenItsRequestsAreSpreadAmongThemAndTheFailingOnesAreEjected)
+{
+    const size_t NUMBER_OF_SERVERS = 3;
+    const size_t REQUESTS_PER_SERVER = 2;
+    const long SERVER_DELAY = 300;
+    const int FIRST_PORT = DEFAULT_PORT + 30;
+    const std::vector<BalancingPolicy> POLICIES = {BalancingPolicy::ROUND_ROBIN, BalancingPolicy::LEAST_OUTSTANDING, BalancingPolicy::POWER_OF_TWO_EWMA};
+
+    std::vector<std::unique_ptr<Server> > servers;
+    std::vector<Endpoint> endpoints;
+    for (size_t i = 0; i < NUMBER_OF_SERVERS; i++)
+    {
+        servers.emplace_back(new Server(2 * REQUESTS_PER_SERVER));
+        EXPECT_TRUE(servers.back()->start(FIRST_PORT + i));
+        endpoints.push_back({Client::DEFAULT_IP, static_cast<int>(FIRST_PORT + i)});
+    }
+
+    //Requests in flight at once are spread evenly.
+    for (BalancingPolicy policy : {BalancingPolicy::ROUND_ROBIN, BalancingPolicy::LEAST_OUTSTANDING})
+    {
+        ClientOptions options;
+        options.balancing.policy = policy;
+        Client client(endpoints, Client::DEFAULT_TIMEOUT, options);
+        std::vector<std::future<AsyncResponse> > responses;
+        for (size_t i = 0; i < NUMBER_OF_SERVERS * REQUESTS_PER_SERVER; i++)
+        {
+            responses.push_back(client.sendDelayToServerAsync(std::chrono::milliseconds(SERVER_DELAY)));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(SERVER_DELAY / 2));
+        for (size_t i = 0; i < NUMBER_OF_SERVERS; i++)
+        {
+            EXPECT_EQ(servers[i]->getNumberOfClients(), REQUESTS_PER_SERVER);
+        }
+        for (std::future<AsyncResponse>& response : responses)
+        {
+            EXPECT_TRUE(response.get().success);
+        }
+    }
+
+    //A server that refuses the connections is ejected after 'maxFailures' failed requests.
+    endpoints.push_back({Client::DEFAULT_IP, static_cast<int>(FIRST_PORT + NUMBER_OF_SERVERS)});
+    for (BalancingPolicy policy : POLICIES)
+    {
+        ClientOptions options;
+        options.balancing.policy = policy;
+        options.balancing.maxFailures = 1;
+        Client client(endpoints, Client::DEFAULT_TIMEOUT, options);
+        size_t failures = 0;
+        for (size_t i = 0; i < 4 * endpoints.size(); i++)
+        {
+            std::chrono::milliseconds serverDelay(1);
+            failures += client.sendDelayToServer(serverDelay) ? 0 : 1;
+        }
+        EXPECT_LE(failures, options.balancing.maxFailures);
+    }
+
+    for (std::unique_ptr<Server>& server : servers)
+    {
+        server->stop();
+    }
+}
+
+TEST_F(PipeTrickTest, WhenManyThreadsSendTheSameDelayToACoalescingClient_ThenTheyShareOneRequestAndStopCancelsAllOfThem)
+{
+    const size_t NUM_THREADS = 20;
+    const long SERVER_DELAY = 300;
+    uint64_t MAX_ELAPSED_TIME = 100;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    Server server(NUM_THREADS);
+    server.start();
+    ClientOptions options;
+    options.coalesce = true;
+    Client client(Client::DEFAULT_TIMEOUT, options);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < NUM_THREADS; i++)
+    {
+        threads.emplace_back([&client, SERVER_DELAY]()
+        {
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), SERVER_DELAY + 1);
+        });
+    }
+
+    //A different delay is not shared.
+    std::chrono::milliseconds otherDelay(SERVER_DELAY / 3);
+    EXPECT_TRUE(client.sendDelayToServer(otherDelay));
+    EXPECT_EQ(otherDelay.count(), SERVER_DELAY / 3 + 1);
+    EXPECT_EQ(server.getNumberOfClients(), 1);
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    threads.clear();
+    for (size_t i = 0; i < NUM_THREADS; i++)
+    {
+        threads.emplace_back([&client]()
+        {
+            std::chrono::milliseconds serverDelay(90 * 1000);
+            EXPECT_FALSE(client.sendDelayToServer(serverDelay));
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
+    EXPECT_EQ(server.getNumberOfClients(), 1);
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    client.stop();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+
+    std::chrono::milliseconds serverDelay(2);
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenBatchingTheRequestsOfAMultiplexedConnection_ThenAFullBatchIsWrittenAtOnceAndEachRequestIsAnswered)
+{
+    const size_t NUM_THREADS = 8;
+    const std::chrono::microseconds WINDOW(300 * 1000);
+    uint64_t MAX_ELAPSED_TIME = 150; //Less than the window, since the batch is written once it is full.
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    ServerOptions serverOptions;
+    serverOptions.mode = ServerMode::REACTOR;
+    Server server(2, serverOptions);
+    server.start();
+    ClientOptions options;
+    options.multiplex = true;
+    options.frameFormat = Common::FrameFormat::BINARY;
+    options.batching.window = WINDOW;
+    options.batching.maxRequests = NUM_THREADS;
+    Client client(Client::DEFAULT_TIMEOUT, options);
+
+    //The first request waits for the whole window, since no other request joins its batch. It also opens the connection.
+    std::chrono::milliseconds serverDelay(1);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_GE(elapsedTime, std::chrono::duration_cast<std::chrono::milliseconds>(WINDOW));
+    EXPECT_EQ(serverDelay.count(), 2);
+
+    std::vector<std::thread> threads;
+    begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < NUM_THREADS; i++)
+    {
+        threads.emplace_back([&client, i]()
+        {
+            std::chrono::milliseconds threadDelay(i);
+            EXPECT_TRUE(client.sendDelayToServer(threadDelay));
+            EXPECT_EQ(threadDelay.count(), static_cast<long>(i + 1));
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenClientAndServerUseTcpFastOpen_ThenTheRequestsAreAnsweredWithOrWithoutACookie)
+{
+    const size_t NUMBER_OF_REQUESTS = 5;
+
+    ServerOptions serverOptions;
+    serverOptions.fastOpen = true;
+    serverOptions.fastOpenQueueLength = 16;
+    Server server(2, serverOptions);
+    EXPECT_TRUE(server.start());
+
+    //The first connection gets the cookie, if the kernel allows it, and the next ones send the delay in the SYN.
+    ClientOptions clientOptions;
+    clientOptions.fastOpen = true;
+    for (Common::FrameFormat format : {Common::FrameFormat::TEXT, Common::FrameFormat::BINARY})
+    {
+        clientOptions.frameFormat = format;
+        Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+        for (size_t i = 0; i < NUMBER_OF_REQUESTS; i++)
+        {
+            std::chrono::milliseconds serverDelay(i);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), static_cast<long>(i + 1));
+        }
+    }
+
+    //The io_uring engine refuses TCP Fast Open, and its requests are still answered after the regular handshake.
+    clientOptions.engine = ClientEngine::IO_URING;
+    Client uringClient(Client::DEFAULT_TIMEOUT, clientOptions);
+    std::chrono::milliseconds serverDelay(1);
+    EXPECT_TRUE(uringClient.sendDelayToServer(serverDelay));
+    EXPECT_EQ(serverDelay.count(), 2);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenAServerIsFull_ThenItRejectsTheNewClientsRightAwayOrLeavesThemInTheBacklogDependingOnItsAdmissionPolicy)
+{
+    const long SERVER_DELAY = 300;
+    const std::chrono::milliseconds RETRY_AFTER(250);
+    uint64_t MAX_ELAPSED_TIME = 100;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::WORKER_POOL, ServerMode::REACTOR, ServerMode::COROUTINE})
+    {
+        ServerOptions options;
+        options.mode = mode;
+        options.admission = AdmissionPolicy::REJECT;
+        options.retryAfter = RETRY_AFTER;
+        Server server(1, options);
+        EXPECT_TRUE(server.start());
+
+        std::thread busyClient([SERVER_DELAY]()
+        {
+            Client client;
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        Client client;
+        std::chrono::milliseconds serverDelay(1);
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        EXPECT_FALSE(client.sendDelayToServer(serverDelay));
+        std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+        EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+        EXPECT_EQ(client.getRetryAfter(), RETRY_AFTER);
+        EXPECT_FALSE(client.sendDelayToServerAsync(serverDelay).get().success);
+
+        //The io_uring engine and the multiplexed connections report the busy answer as well.
+        ClientOptions uringOptions;
+        uringOptions.engine = ClientEngine::IO_URING;
+        ClientOptions muxOptions;
+        muxOptions.multiplex = true;
+        for (const ClientOptions& clientOptions : {uringOptions, muxOptions})
+        {
+            Client otherClient(Client::DEFAULT_TIMEOUT, clientOptions);
+            begin = std::chrono::steady_clock::now();
+            EXPECT_FALSE(otherClient.sendDelayToServer(serverDelay));
+            elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+            EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+            EXPECT_EQ(otherClient.getRetryAfter(), RETRY_AFTER);
+        }
+
+        busyClient.join();
+        EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        server.stop();
+    }
+
+    //The client waits in the backlog, and it is served once the first client finishes.
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::REACTOR, ServerMode::COROUTINE})
+    {
+        ServerOptions options;
+        options.mode = mode;
+        options.admission = AdmissionPolicy::PAUSE;
+        Server server(1, options);
+        EXPECT_TRUE(server.start());
+        std::thread busyClient([SERVER_DELAY]()
+        {
+            Client client;
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        Client client;
+        std::chrono::milliseconds serverDelay(1);
+        EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        EXPECT_EQ(serverDelay.count(), 2);
+        busyClient.join();
+        server.stop();
+    }
+}
+
+TEST_F(PipeTrickTest, WhenTheResponsesAreLate_ThenTheConcurrencyLimitDecreasesAndItRecoversOnceTheyAreTimelyAgain)
+{
+    const size_t MAX_LIMIT = 100;
+    const std::chrono::microseconds LATE(50000);
+    const std::chrono::microseconds TIMELY(0);
+
+    for (LimitAlgorithm algorithm : {LimitAlgorithm::AIMD, LimitAlgorithm::GRADIENT})
+    {
+        ConcurrencyLimitOptions options;
+        options.algorithm = algorithm;
+        options.minLimit = 10;
+        ConcurrencyLimiter limiter(MAX_LIMIT, options);
+        EXPECT_EQ(limiter.getLimit(), MAX_LIMIT);
+
+        for (size_t i = 0; i < 10 * MAX_LIMIT; i++)
+        {
+            limiter.onSample(LATE, limiter.getLimit());
+        }
+        EXPECT_EQ(limiter.getLimit(), options.minLimit);
+
+        //The limit does not grow while most of it is not used.
+        for (size_t i = 0; i < 10 * MAX_LIMIT; i++)
+        {
+            limiter.onSample(TIMELY, 1);
+        }
+        EXPECT_EQ(limiter.getLimit(), options.minLimit);
+
+        size_t samples = 0;
+        while (limiter.getLimit() < MAX_LIMIT && samples < 100 * MAX_LIMIT)
+        {
+            limiter.onSample(TIMELY, limiter.getLimit());
+            samples++;
+        }
+        EXPECT_EQ(limiter.getLimit(), MAX_LIMIT);
+    }
+
+    //The late responses of the requests admitted before a decrease do not decrease the limit again.
+    ConcurrencyLimitOptions options;
+    options.algorithm = LimitAlgorithm::AIMD;
+    options.backoffRatio = 0.5;
+    ConcurrencyLimiter limiter(MAX_LIMIT, options);
+    limiter.onSample(LATE, MAX_LIMIT);
+    EXPECT_EQ(limiter.getLimit(), MAX_LIMIT / 2);
+    for (size_t i = 0; i < MAX_LIMIT / 2 - 1; i++)
+    {
+        limiter.onSample(LATE, MAX_LIMIT);
+    }
+    EXPECT_EQ(limiter.getLimit(), MAX_LIMIT / 2);
+    limiter.onSample(LATE, MAX_LIMIT);
+    EXPECT_EQ(limiter.getLimit(), MAX_LIMIT / 4);
+
+    //A server whose responses are timely keeps its maximum number of clients.
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::REACTOR, ServerMode::COROUTINE, ServerMode::IO_URING})
+    {
+        ServerOptions serverOptions;
+        serverOptions.mode = mode;
+        serverOptions.concurrencyLimit.algorithm = LimitAlgorithm::AIMD;
+        serverOptions.concurrencyLimit.latencyTolerance = std::chrono::milliseconds(500);
+        Server server(4, serverOptions);
+        EXPECT_EQ(server.getConcurrencyLimit(), 4u);
+        EXPECT_TRUE(server.start());
+        for (long i = 0; i < 5; i++)
+        {
+            Client client;
+            std::chrono::milliseconds serverDelay(i);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+            EXPECT_EQ(serverDelay.count(), i + 1);
+        }
+        EXPECT_EQ(server.getConcurrencyLimit(), 4u);
+        server.stop();
+    }
+}
+
+TEST_F(PipeTrickTest, WhenClientsWaitInTheQueueForTooLong_ThenTheOldestOnesAreDroppedAndTheRestAreServed)
+{
+    const long SERVER_DELAY = 400;
+    const std::chrono::milliseconds RETRY_AFTER(250);
+    const size_t NUM_WAITING_CLIENTS = 8;
+
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::WORKER_POOL, ServerMode::REACTOR, ServerMode::COROUTINE})
+    {
+        ServerOptions options;
+        options.mode = mode;
+        options.admission = AdmissionPolicy::QUEUE;
+        options.retryAfter = RETRY_AFTER;
+        options.waitingQueue.capacity = NUM_WAITING_CLIENTS;
+        options.waitingQueue.target = std::chrono::milliseconds(10);
+        options.waitingQueue.interval = std::chrono::milliseconds(200);
+        Server server(1, options);
+        EXPECT_TRUE(server.start());
+
+        std::thread busyClient([SERVER_DELAY]()
+        {
+            Client client;
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::atomic<size_t> served(0);
+        std::atomic<size_t> dropped(0);
+        std::vector<std::thread> waitingClients;
+        size_t maxNumberWaitingClients = 0;
+        for (size_t i = 0; i < NUM_WAITING_CLIENTS; i++)
+        {
+            waitingClients.emplace_back([&served, &dropped, RETRY_AFTER]()
+            {
+                Client client;
+                std::chrono::milliseconds serverDelay(1);
+                if (client.sendDelayToServer(serverDelay))
+                {
+                    EXPECT_EQ(serverDelay.count(), 2);
+                    served++;
+                }
+                else
+                {
+                    EXPECT_EQ(client.getRetryAfter(), RETRY_AFTER);
+                    dropped++;
+                }
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+            maxNumberWaitingClients = std::max(maxNumberWaitingClients, server.getNumberOfWaitingClients());
+        }
+
+        for (std::thread& waitingClient : waitingClients)
+        {
+            waitingClient.join();
+        }
+        busyClient.join();
+
+        EXPECT_GT(maxNumberWaitingClients, 0u);
+        EXPECT_GT(dropped.load(), 0u);
+        EXPECT_GT(served.load(), 0u);
+        EXPECT_EQ(served + dropped, NUM_WAITING_CLIENTS);
+        EXPECT_EQ(server.getNumberOfDroppedClients(), dropped.load());
+        EXPECT_EQ(server.getNumberOfWaitingClients(), 0u);
+        server.stop();
+    }
+}
+
+TEST_F(PipeTrickTest, WhenMessagesCarryAPriorityAndADeadline_ThenTheyAreDecodedBackAndTheMessagesWithoutThemDoNotChange)
+{
+    for (Common::FrameFormat format : {Common::FrameFormat::BINARY, Common::FrameFormat::TEXT})
+    {
+        for (Common::Priority priority : {Common::Priority::INTERACTIVE, Common::Priority::NORMAL, Common::Priority::BULK})
+        {
+            for (long deadline : {0L, 1L, 90L * 1000})
+            {
+                char buffer[BUFFER_SIZE];
+                size_t size = Common::encodeFrame(buffer, format, 300, 7, priority, std::chrono::milliseconds(deadline));
+                EXPECT_EQ(Common::getFrameSize(buffer, size), size);
+                EXPECT_LE(size, format == Common::FrameFormat::BINARY ? MAX_BINARY_FRAME_SIZE : BUFFER_SIZE);
+
+                long delay;
+                uint32_t requestId;
+                Common::Priority decodedPriority;
+                std::chrono::milliseconds decodedDeadline;
+                EXPECT_TRUE(Common::decodeFrame(buffer, delay, requestId, decodedPriority, decodedDeadline));
+                EXPECT_EQ(delay, 300);
+                EXPECT_EQ(requestId, 7u);
+                EXPECT_TRUE(decodedPriority == priority);
+                EXPECT_EQ(decodedDeadline.count(), deadline);
+            }
+        }
+
+        char buffer[BUFFER_SIZE];
+        char legacyBuffer[BUFFER_SIZE];
+        size_t size = Common::encodeFrame(buffer, format, 300, 7, Common::Priority::NORMAL, std::chrono::milliseconds(0));
+        EXPECT_EQ(Common::encodeFrame(legacyBuffer, format, 300, 7), size);
+        EXPECT_EQ(memcmp(buffer, legacyBuffer, size), 0);
+    }
+}
+
+TEST_F(PipeTrickTest, WhenClientsOfSeveralPrioritiesWait_ThenTheyAreServedByClassAndEarliestDeadlineAndBulkClientsKeepSlotsFree)
+{
+    const long SERVER_DELAY = 400;
+    uint64_t MAX_ELAPSED_TIME = 200;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    struct Request
+    {
+        Common::Priority priority;
+        long deadline;
+    };
+    //In arrival order. The third one is dropped because of its deadline, and the rest are served in the reverse order.
+    const Request REQUESTS[] = {{Common::Priority::BULK, 0}, {Common::Priority::NORMAL, 5000}, {Common::Priority::NORMAL, 100}, {Common::Priority::NORMAL, 2000}, {Common::Priority::INTERACTIVE, 0}};
+    const int EXPECTED_ORDER[] = {3, 2, -1, 1, 0};
+
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::WORKER_POOL, ServerMode::REACTOR, ServerMode::COROUTINE})
+    {
+        ServerOptions options;
+        options.mode = mode;
+        options.admission = AdmissionPolicy::QUEUE;
+        options.waitingQueue.capacity = 8;
+        options.waitingQueue.target = std::chrono::milliseconds(10 * 1000); //No drops by the control law.
+        Server server(1, options);
+        EXPECT_TRUE(server.start());
+
+        std::thread busyClient([SERVER_DELAY]()
+        {
+            Client client;
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::atomic<int> served(0);
+        std::vector<std::thread> waitingClients;
+        for (size_t i = 0; i < sizeof(REQUESTS) / sizeof(REQUESTS[0]); i++)
+        {
+            waitingClients.emplace_back([&served, &REQUESTS, &EXPECTED_ORDER, i]()
+            {
+                ClientOptions clientOptions;
+                clientOptions.priority = REQUESTS[i].priority;
+                clientOptions.deadline = std::chrono::milliseconds(REQUESTS[i].deadline);
+                clientOptions.frameFormat = i % 2 ? Common::FrameFormat::BINARY : Common::FrameFormat::TEXT;
+                Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+                std::chrono::milliseconds serverDelay(10);
+                bool success = client.sendDelayToServer(serverDelay);
+                EXPECT_EQ(success, EXPECTED_ORDER[i] != -1);
+                if (success)
+                {
+                    EXPECT_EQ(served++, EXPECTED_ORDER[i]);
+                }
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+
+        for (std::thread& waitingClient : waitingClients)
+        {
+            waitingClient.join();
+        }
+        busyClient.join();
+        EXPECT_EQ(server.getNumberOfDroppedClients(), 1u);
+        server.stop();
+    }
+
+    //The bulk clients can only hold half of the slots, so an interactive client does not wait behind them. They arrive while the
+    //server is full, so their class is known once a slot frees, whenever their requests were accepted.
+    const long BUSY_DELAY = 150;
+    ServerOptions options;
+    options.admission = AdmissionPolicy::QUEUE;
+    options.bulkShare = 0.5;
+    options.waitingQueue.capacity = 8;
+    options.waitingQueue.target = std::chrono::milliseconds(10 * 1000);
+    Server server(2, options);
+    EXPECT_TRUE(server.start());
+
+    std::vector<std::thread> busyClients;
+    for (int i = 0; i < 2; i++)
+    {
+        busyClients.emplace_back([BUSY_DELAY]()
+        {
+            Client client;
+            std::chrono::milliseconds serverDelay(BUSY_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    std::vector<std::thread> bulkClients;
+    for (int i = 0; i < 3; i++)
+    {
+        bulkClients.emplace_back([SERVER_DELAY]()
+        {
+            ClientOptions clientOptions;
+            clientOptions.priority = Common::Priority::BULK;
+            Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (std::thread& busyClient : busyClients)
+    {
+        busyClient.join();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(server.getNumberOfClients(), 1u);
+    EXPECT_EQ(server.getNumberOfWaitingClients(), 2u);
+
+    ClientOptions clientOptions;
+    clientOptions.priority = Common::Priority::INTERACTIVE;
+    Client client(Client::DEFAULT_TIMEOUT, clientOptions);
+    std::chrono::milliseconds serverDelay(1);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+    EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+
+    for (std::thread& bulkClient : bulkClients)
+    {
+        bulkClient.join();
+    }
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenOneHostOpensTooManyConnections_ThenItIsRejectedAtAcceptWithoutTakingTheSlotsOfTheOthers)
+{
+    const long SERVER_DELAY = 300;
+    const std::chrono::milliseconds RETRY_AFTER(250);
+    uint64_t MAX_ELAPSED_TIME = 100;
+    if (RUNNING_ON_VALGRIND)
+    {
+        MAX_ELAPSED_TIME = 3000;
+    }
+
+    //The addresses without connections and with a full bucket are forgotten, so the table does not grow with every address seen.
+    SourceLimitOptions limitOptions;
+    limitOptions.maxConnections = 2;
+    SourceLimiter limiter(limitOptions);
+    SourceLimiter::Clock::time_point now = SourceLimiter::Clock::now();
+    EXPECT_TRUE(limiter.acquire(1, 1, now));
+    EXPECT_TRUE(limiter.acquire(2, 1, now));
+    EXPECT_FALSE(limiter.acquire(3, 1, now));
+    limiter.release(3);
+    limiter.release(2);
+    EXPECT_TRUE(limiter.acquire(3, 1, now));
+    for (int i = 0; i < 1000; i++)
+    {
+        EXPECT_TRUE(limiter.acquire(10 + i, 2 + i, now));
+        limiter.release(10 + i);
+    }
+    EXPECT_LT(limiter.getNumberOfSources(), 200u);
+    EXPECT_EQ(limiter.getNumberOfRejections(), 1u);
+    EXPECT_EQ(limiter.getNumberOfDroppedSources(), 0u);
+
+    //The table never exceeds its maximum, even with unfilled buckets: the addresses seen least recently are forgotten first, and the
+    //ones with open connections are kept.
+    const size_t MAX_SOURCES = 100;
+    limitOptions.rate = 1;
+    limitOptions.burst = 2;
+    limitOptions.maxSources = MAX_SOURCES;
+    SourceLimiter cappedLimiter(limitOptions);
+    EXPECT_TRUE(cappedLimiter.acquire(1, 1, now));
+    for (int i = 0; i < 1000; i++)
+    {
+        EXPECT_TRUE(cappedLimiter.acquire(10 + i, 2 + i, now + std::chrono::milliseconds(i)));
+        cappedLimiter.release(10 + i);
+        EXPECT_LE(cappedLimiter.getNumberOfSources(), MAX_SOURCES);
+    }
+    EXPECT_GE(cappedLimiter.getNumberOfDroppedSources(), 1000u - MAX_SOURCES);
+    now += std::chrono::milliseconds(1000);
+    EXPECT_TRUE(cappedLimiter.acquire(2, 1, now));
+    EXPECT_FALSE(cappedLimiter.acquire(3, 1, now)); //Its open connection kept it in the table, so its limit still applies.
+
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::WORKER_POOL, ServerMode::REACTOR, ServerMode::COROUTINE, ServerMode::IO_URING})
+    {
+        ServerOptions options;
+        options.mode = mode;
+        options.retryAfter = RETRY_AFTER;
+        options.sourceLimit.maxConnections = 1;
+        Server server(4, options);
+        EXPECT_TRUE(server.start());
+
+        std::thread busyClient([SERVER_DELAY]()
+        {
+            Client client;
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        //The server has free slots, but this host already holds its only connection.
+        Client client;
+        std::chrono::milliseconds serverDelay(1);
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        EXPECT_FALSE(client.sendDelayToServer(serverDelay));
+        std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - begin);
+        EXPECT_LT(elapsedTime.count(), MAX_ELAPSED_TIME);
+        EXPECT_EQ(client.getRetryAfter(), RETRY_AFTER);
+        EXPECT_EQ(server.getNumberOfThrottledClients(), 1u);
+        EXPECT_EQ(server.getNumberOfClients(), 1u);
+
+        busyClient.join();
+        EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        server.stop();
+    }
+
+    //The token bucket lets a burst of new connections through, and then only its rate.
+    ServerOptions options;
+    options.sourceLimit.rate = 1;
+    options.sourceLimit.burst = 2;
+    Server server(4, options);
+    EXPECT_TRUE(server.start());
+    Client client;
+    std::chrono::milliseconds serverDelay(1);
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    serverDelay = std::chrono::milliseconds(1);
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    serverDelay = std::chrono::milliseconds(1);
+    EXPECT_FALSE(client.sendDelayToServer(serverDelay));
+    EXPECT_EQ(server.getNumberOfThrottledClients(), 1u);
+    server.stop();
+}
+
+TEST_F(PipeTrickTest, WhenManyClientsLoadTheServer_ThenTheTopClientsAreTrackedInAFixedNumberOfCounters)
+{
+    //The space-saving replacement: the new address inherits the lowest load, which is kept as its error.
+    TopClientsOptions topOptions;
+    topOptions.capacity = 2;
+    TopClients topClients(topOptions);
+    topClients.add(ClientLoad{1, 1, 100});
+    topClients.add(ClientLoad{2, 1, 50});
+    topClients.add(ClientLoad{3, 1, 10});
+    topClients.add(ClientLoad{4, 0, 0, 20}); //Nothing to rank it by, so it is not tracked.
+    std::vector<ClientLoad> top = topClients.getTop(10);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].address, 1u);
+    EXPECT_EQ(top[0].delay, 100u);
+    EXPECT_EQ(top[0].error, 0u);
+    EXPECT_EQ(top[1].address, 3u);
+    EXPECT_EQ(top[1].delay, 60u);
+    EXPECT_EQ(top[1].error, 50u);
+    EXPECT_EQ(top[1].requests, 1u);
+
+    //A heavy address stays in the table, whatever the number of light ones.
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        topClients.add(ClientLoad{10 + i, 1, 1});
+        if (i % 100 == 0)
+        {
+            topClients.add(ClientLoad{1, 1, 100});
+        }
+    }
+    top = topClients.getTop(10);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].address, 1u);
+    EXPECT_EQ(top[0].delay, 100u + 100 * 100);
+    EXPECT_EQ(top[0].requests, 101u);
+
+    const long SERVER_DELAY = 20;
+    const int NUMBER_OF_REQUESTS = 3;
+    for (ServerMode mode : {ServerMode::THREAD_PER_CLIENT, ServerMode::WORKER_POOL, ServerMode::REACTOR, ServerMode::COROUTINE, ServerMode::IO_URING})
+    {
+        ServerOptions options;
+        options.mode = mode;
+        options.topClients.capacity = 4;
+        Server server(2, options);
+        EXPECT_TRUE(server.start());
+
+        Client client;
+        for (int i = 0; i < NUMBER_OF_REQUESTS; i++)
+        {
+            std::chrono::milliseconds serverDelay(SERVER_DELAY);
+            EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+        }
+
+        top = server.getTopClients(10);
+        ASSERT_EQ(top.size(), 1u);
+        EXPECT_EQ(top[0].address, inet_addr(Client::DEFAULT_IP));
+        EXPECT_EQ(top[0].requests, static_cast<uint64_t>(NUMBER_OF_REQUESTS));
+        EXPECT_EQ(top[0].delay, static_cast<uint64_t>(NUMBER_OF_REQUESTS * SERVER_DELAY));
+        EXPECT_GT(top[0].bytes, 0u);
+        EXPECT_EQ(top[0].error, 0u);
+        server.stop();
+    }
+
+    //Without tracking, nothing is returned.
+    Server server(2);
+    EXPECT_TRUE(server.start());
+    Client client;
+    std::chrono::milliseconds serverDelay(1);
+    EXPECT_TRUE(client.sendDelayToServer(serverDelay));
+    EXPECT_TRUE(server.getTopClients(10).empty());
+    server.stop();
+}
+
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
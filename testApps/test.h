@@ -5,6 +5,7 @@
 #include "valgrind_check.h"
 #include "server.h"
 #include "client.h"
+#include "timer_wheel.h"
 
 using namespace pipetrick;
 